@@ -0,0 +1,721 @@
+#include <QJsonDocument>
+#include <QScopedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QtTest>
+
+#include "qudunit.h"
+#include "qudconcurrentunitsystem.h"
+#include "qudconversionmatrix.h"
+#include "qudrecordconverter.h"
+#include "qudsharedunittable.h"
+#include "qudunitbuilder.h"
+#include "qudunittable.h"
+
+Q_DECLARE_METATYPE(UdUnit::FormatForm)
+Q_DECLARE_METATYPE(UdUnit::FormatOption)
+
+/*
+ * Benchmarks of the hot paths of the library.
+ *
+ * Unless an output is specified with -o, results are printed on the standard
+ * output and written in CSV format to bench_udunits2.csv, so that they can be
+ * collected and compared over time. Any other QTest logger can be selected
+ * with the usual options, eg. "-o results.xml,xml".
+ */
+class UdUnits2Benchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    UdUnits2Benchmark();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void loadDatabase();
+    void loadTable();
+    void attachAndLoadSharedTable();
+    void unitByName_data();
+    void unitByName();
+    void tableUnitByName_data();
+    void tableUnitByName();
+    void identifierLookup_data();
+    void identifierLookup();
+    void identifierInsertion_data();
+    void identifierInsertion();
+    void unitBySymbol_data();
+    void unitBySymbol();
+    void unitFromString_data();
+    void unitFromString();
+    void unitFromStringCorpus();
+    void copyUnit();
+    void compareUnit_data();
+    void compareUnit();
+    void format_data();
+    void format();
+    void createConverter_data();
+    void createConverter();
+    void convertScalar_data();
+    void convertScalar();
+    void convertBatch_data();
+    void convertBatch();
+    void convertAndReduce_data();
+    void convertAndReduce();
+    void buildUnit_data();
+    void buildUnit();
+    void toggleUnit_data();
+    void toggleUnit();
+    void autoPrefix_data();
+    void autoPrefix();
+    void convertRecords_data();
+    void convertRecords();
+    void serializeUnit_data();
+    void serializeUnit();
+    void serializeConverter();
+    void concurrentSnapshot();
+    void concurrentRefresh();
+
+private:
+    UdUnitSystem *m_system;
+};
+
+namespace {
+
+// Unit specifications as found in NetCDF/CF files and configuration files.
+const char *const s_corpus[] = {
+    "m", "km", "s", "ms", "h", "kg", "K", "degC", "degF", "Pa", "hPa", "mbar",
+    "W", "mW", "W m-2", "W/m^2", "m/s", "m s-1", "km/h", "knot", "kg m-3",
+    "kg/m3", "mol/mol", "1", "percent", "lux", "J/kg", "m2 s-1", "N", "kN.m",
+    "degrees_north", "degrees_east", "rad", "sr", "Hz", "MHz", "V", "mV", "A",
+    "ohm", "lg(re 1 mW)", "s @ 1970-01-01", "days since 2000-01-01 00:00:00",
+    "hours since 1900-01-01", "kg m-2 s-1", "mm/day", "m3/s", "g/kg", "1e-3",
+    "Pa s-1"
+};
+
+void addConversions()
+{
+    QTest::addColumn<QString>("from");
+    QTest::addColumn<QString>("to");
+    QTest::newRow("identity")    << QString("m")           << QString("m");
+    QTest::newRow("scale")       << QString("km")          << QString("m");
+    QTest::newRow("offset")      << QString("K")           << QString("degC");
+    QTest::newRow("affine")      << QString("degF")        << QString("degC");
+    QTest::newRow("timestamp")   << QString("h @ 1970-01-01") << QString("s @ 2000-01-01");
+    QTest::newRow("exponential") << QString("lg(re 1 mW)") << QString("W");
+    QTest::newRow("logarithmic") << QString("W")           << QString("lg(re 1 mW)");
+}
+
+void addIdentifierCounts()
+{
+    QTest::addColumn<int>("count");
+    QTest::newRow("1k")   << 1000;
+    QTest::newRow("10k")  << 10000;
+    QTest::newRow("100k") << 100000;
+    QTest::newRow("1M")   << 1000000;
+}
+
+QByteArray aliasName(int index)
+{
+    return "alias_" + QByteArray::number(index);
+}
+
+// An empty unit-system with a base unit and \a count aliases of it
+UdUnitSystem *aliasSystem(int count)
+{
+    UdUnitSystem *system = new UdUnitSystem;
+    const UdUnit meter = system->addBaseUnit("meter", "m");
+    for (int i = 0; i < count; ++i)
+        system->addUnit(meter, QString::fromLatin1(aliasName(i)), QString());
+    return system;
+}
+
+// count weather records of 4 quantities, in the units of 2 kinds of stations
+QJsonArray weatherRecords(int count)
+{
+    QJsonArray records;
+    for (int i = 0; i < count; ++i) {
+        const bool metric = i % 2 == 0;
+        QJsonObject air;
+        air.insert("temperature", QJsonObject{ { "value", 280.0 + i % 30 },
+                                               { "unit", metric ? "K" : "degF" } });
+        air.insert("pressure", QJsonObject{ { "value", metric ? 101325.0 : 29.9 },
+                                            { "unit", metric ? "Pa" : "inch_Hg" } });
+        QJsonObject record;
+        record.insert("station", QString("station %1").arg(i % 100));
+        record.insert("air", air);
+        record.insert("wind", QJsonObject{ { "value", 0.5 * (i % 40) },
+                                           { "unit", metric ? "m/s" : "knot" } });
+        record.insert("rain", QJsonObject{ { "value", 0.1 * (i % 10) },
+                                           { "unit", metric ? "mm/h" : "inch/h" } });
+        records.append(record);
+    }
+    return records;
+}
+
+const QVariantMap s_weatherSchema = {
+    { "air.temperature", "degC" }, { "air.pressure", "hPa" }, { "wind", "km/h" }, { "rain", "mm/h" }
+};
+
+}
+
+UdUnits2Benchmark::UdUnits2Benchmark():
+    m_system(nullptr)
+{
+}
+
+void UdUnits2Benchmark::initTestCase()
+{
+    ut_set_error_message_handler(ut_ignore);
+    m_system = UdUnitSystem::loadDatabase();
+    QVERIFY(m_system->isValid());
+}
+
+void UdUnits2Benchmark::cleanupTestCase()
+{
+    delete m_system;
+}
+
+void UdUnits2Benchmark::loadDatabase()
+{
+    QBENCHMARK {
+        delete UdUnitSystem::loadDatabase();
+    }
+}
+
+void UdUnits2Benchmark::loadTable()
+{
+    const UdUnitTable table = UdUnitTable::fromDatabase();
+    QVERIFY(table.isValid());
+    QBENCHMARK {
+        delete UdUnitSystem::loadTable(table);
+    }
+}
+
+// Attaching to a shared table and loading a unit-system from it, which is
+// what a worker process pays at startup, attaching alone is only a mapping
+void UdUnits2Benchmark::attachAndLoadSharedTable()
+{
+    const QString key = QString("bench_udunits2_%1").arg(QCoreApplication::applicationPid());
+    UdSharedUnitTable published;
+    QVERIFY(published.create(key, UdUnitTable::fromDatabase()));
+    QBENCHMARK {
+        UdSharedUnitTable shared;
+        QVERIFY(shared.attach(key));
+        delete UdUnitSystem::loadTable(shared.table());
+    }
+}
+
+void UdUnits2Benchmark::unitByName_data()
+{
+    QTest::addColumn<QString>("name");
+    QTest::newRow("base")    << QString("meter");
+    QTest::newRow("derived") << QString("watt");
+    QTest::newRow("plural")  << QString("kilograms");
+    QTest::newRow("unknown") << QString("foobarbaz");
+}
+
+void UdUnits2Benchmark::unitByName()
+{
+    QFETCH(QString, name);
+    QBENCHMARK {
+        m_system->unitByName(name);
+    }
+}
+
+void UdUnits2Benchmark::tableUnitByName_data()
+{
+    unitByName_data();
+}
+
+void UdUnits2Benchmark::tableUnitByName()
+{
+    QFETCH(QString, name);
+    QScopedPointer<UdUnitSystem> system(UdUnitSystem::loadTable(UdUnitTable::fromDatabase()));
+    QVERIFY(system->isValid());
+    QBENCHMARK {
+        system->unitByName(name);
+    }
+}
+
+// 1024 lookups of identifiers spread over the whole system, which should
+// take the same time whatever its size
+void UdUnits2Benchmark::identifierLookup_data()
+{
+    addIdentifierCounts();
+}
+
+void UdUnits2Benchmark::identifierLookup()
+{
+    QFETCH(int, count);
+    QScopedPointer<UdUnitSystem> system(aliasSystem(count));
+    QVector<QByteArray> names;
+    for (int i = 0; i < 1024; ++i)
+        names.append(aliasName(int((quint64(i) * 7919u * count / 1024) % quint64(count))));
+    for (const QByteArray &name: names)
+        QVERIFY(system->unitByName(name).isValid());
+    QBENCHMARK {
+        for (const QByteArray &name: names)
+            system->unitByName(name);
+    }
+}
+
+// 1024 registrations in a system already holding count identifiers
+void UdUnits2Benchmark::identifierInsertion_data()
+{
+    addIdentifierCounts();
+}
+
+void UdUnits2Benchmark::identifierInsertion()
+{
+    QFETCH(int, count);
+    QScopedPointer<UdUnitSystem> system(aliasSystem(count));
+    const UdUnit meter = system->unitBySymbol("m");
+    QStringList names;
+    for (int i = 0; i < 1024; ++i)
+        names.append(QString::fromLatin1(aliasName(count + i)));
+    QBENCHMARK_ONCE {
+        for (const QString &name: names)
+            system->addUnit(meter, name, QString());
+    }
+}
+
+void UdUnits2Benchmark::unitBySymbol_data()
+{
+    QTest::addColumn<QString>("symbol");
+    QTest::newRow("base")     << QString("m");
+    QTest::newRow("derived")  << QString("Pa");
+    QTest::newRow("prefixed") << QString("kW");
+    QTest::newRow("unknown")  << QString("fbb");
+}
+
+void UdUnits2Benchmark::unitBySymbol()
+{
+    QFETCH(QString, symbol);
+    QBENCHMARK {
+        m_system->unitBySymbol(symbol);
+    }
+}
+
+void UdUnits2Benchmark::unitFromString_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::newRow("symbol")     << QString("m");
+    QTest::newRow("product")    << QString("kg m-2 s-1");
+    QTest::newRow("quotient")   << QString("W/m^2");
+    QTest::newRow("scaled")     << QString("1e-3 kg/kg");
+    QTest::newRow("timestamp")  << QString("days since 2000-01-01 00:00:00");
+    QTest::newRow("logarithm")  << QString("lg(re 1 mW)");
+}
+
+void UdUnits2Benchmark::unitFromString()
+{
+    QFETCH(QString, text);
+    QBENCHMARK {
+        m_system->unitFromString(text);
+    }
+}
+
+void UdUnits2Benchmark::unitFromStringCorpus()
+{
+    QStringList corpus;
+    for (const char *text: s_corpus)
+        corpus.append(QString::fromUtf8(text));
+    foreach (const QString &text, corpus)
+        QVERIFY2(m_system->unitFromString(text).isValid(), qPrintable(text));
+    QBENCHMARK {
+        foreach (const QString &text, corpus)
+            m_system->unitFromString(text);
+    }
+}
+
+void UdUnits2Benchmark::copyUnit()
+{
+    const UdUnit unit = m_system->unitFromString("kg m-2 s-1");
+    QBENCHMARK {
+        UdUnit copy(unit);
+        Q_UNUSED(copy);
+    }
+}
+
+void UdUnits2Benchmark::compareUnit_data()
+{
+    QTest::addColumn<QString>("lhs");
+    QTest::addColumn<QString>("rhs");
+    QTest::newRow("equal")     << QString("N")  << QString("kg m s-2");
+    QTest::newRow("different") << QString("W")  << QString("J");
+}
+
+void UdUnits2Benchmark::compareUnit()
+{
+    QFETCH(QString, lhs);
+    QFETCH(QString, rhs);
+    const UdUnit lhsUnit = m_system->unitFromString(lhs);
+    const UdUnit rhsUnit = m_system->unitFromString(rhs);
+    bool result = false;
+    QBENCHMARK {
+        result ^= lhsUnit == rhsUnit;
+    }
+    Q_UNUSED(result);
+}
+
+void UdUnits2Benchmark::format_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<UdUnit::FormatForm>("form");
+    QTest::addColumn<UdUnit::FormatOption>("option");
+    QTest::newRow("short symbol")      << QString("W/m^2") << UdUnit::ShortForm      << UdUnit::UseUnitSymbol;
+    QTest::newRow("short name")        << QString("W/m^2") << UdUnit::ShortForm      << UdUnit::UseUnitName;
+    QTest::newRow("definition symbol") << QString("W/m^2") << UdUnit::DefinitionForm << UdUnit::UseUnitSymbol;
+    QTest::newRow("definition name")   << QString("W/m^2") << UdUnit::DefinitionForm << UdUnit::UseUnitName;
+}
+
+void UdUnits2Benchmark::format()
+{
+    QFETCH(QString, text);
+    QFETCH(UdUnit::FormatForm, form);
+    QFETCH(UdUnit::FormatOption, option);
+    const UdUnit unit = m_system->unitFromString(text);
+    QBENCHMARK {
+        unit.format(form, option);
+    }
+}
+
+void UdUnits2Benchmark::createConverter_data()
+{
+    addConversions();
+}
+
+void UdUnits2Benchmark::createConverter()
+{
+    QFETCH(QString, from);
+    QFETCH(QString, to);
+    const UdUnit fromUnit = m_system->unitFromString(from);
+    const UdUnit toUnit = m_system->unitFromString(to);
+    QVERIFY(UdUnitConverter(fromUnit, toUnit).isValid());
+    QBENCHMARK {
+        UdUnitConverter converter(fromUnit, toUnit);
+        Q_UNUSED(converter);
+    }
+}
+
+void UdUnits2Benchmark::convertScalar_data()
+{
+    addConversions();
+}
+
+void UdUnits2Benchmark::convertScalar()
+{
+    QFETCH(QString, from);
+    QFETCH(QString, to);
+    UdUnitConverter converter(m_system->unitFromString(from), m_system->unitFromString(to));
+    QVERIFY(converter.isValid());
+    qreal result = 0.0;
+    QBENCHMARK {
+        result += converter.convert(1.0);
+    }
+    Q_UNUSED(result);
+}
+
+void UdUnits2Benchmark::convertBatch_data()
+{
+    QTest::addColumn<QString>("from");
+    QTest::addColumn<QString>("to");
+    QTest::addColumn<int>("size");
+    const int sizes[] = { 16, 1024, 65536, 1 << 20 };
+    for (int size: sizes) {
+        QTest::newRow(qPrintable(QString("affine %1").arg(size)))
+                << QString("degF") << QString("degC") << size;
+        QTest::newRow(qPrintable(QString("logarithmic %1").arg(size)))
+                << QString("W") << QString("lg(re 1 mW)") << size;
+    }
+}
+
+void UdUnits2Benchmark::convertBatch()
+{
+    QFETCH(QString, from);
+    QFETCH(QString, to);
+    QFETCH(int, size);
+    const UdUnitConverter converter(m_system->unitFromString(from), m_system->unitFromString(to));
+    QVERIFY(converter.isValid());
+    QVector<qreal> values(size);
+    for (int i = 0; i < size; ++i)
+        values[i] = 1.0 + i % 1000;
+    QVector<qreal> results(size);
+    QBENCHMARK {
+        converter.convert(values.constData(), results.data(), size);
+    }
+}
+
+void UdUnits2Benchmark::convertAndReduce_data()
+{
+    QTest::addColumn<QString>("from");
+    QTest::addColumn<QString>("to");
+    QTest::addColumn<bool>("fused");
+    QTest::newRow("affine materialized")      << QString("degF") << QString("degC") << false;
+    QTest::newRow("affine fused")             << QString("degF") << QString("degC") << true;
+    QTest::newRow("logarithmic materialized") << QString("W") << QString("lg(re 1 mW)") << false;
+    QTest::newRow("logarithmic fused")        << QString("W") << QString("lg(re 1 mW)") << true;
+}
+
+void UdUnits2Benchmark::convertAndReduce()
+{
+    QFETCH(QString, from);
+    QFETCH(QString, to);
+    QFETCH(bool, fused);
+    const UdUnitConverter converter(m_system->unitFromString(from), m_system->unitFromString(to));
+    QVERIFY(converter.isValid());
+    const int size = 1 << 20;
+    QVector<qreal> values(size);
+    for (int i = 0; i < size; ++i)
+        values[i] = 1.0 + i % 1000;
+    qreal result = 0.0;
+    if (fused) {
+        QBENCHMARK {
+            result += converter.mean(values.constData(), size);
+            result += converter.maximum(values.constData(), size);
+        }
+    } else {
+        QBENCHMARK {
+            QVector<qreal> converted(size);
+            converter.convert(values.constData(), converted.data(), size);
+            qreal sum = 0.0;
+            qreal highest = converted.first();
+            foreach (qreal value, converted) {
+                sum += value;
+                highest = qMax(highest, value);
+            }
+            result += sum / size + highest;
+        }
+    }
+    Q_UNUSED(result);
+}
+
+void UdUnits2Benchmark::buildUnit_data()
+{
+    QTest::addColumn<bool>("lazy");
+    QTest::newRow("eager") << false;
+    QTest::newRow("lazy")  << true;
+}
+
+void UdUnits2Benchmark::buildUnit()
+{
+    QFETCH(bool, lazy);
+    const UdUnit kg = m_system->unitBySymbol("kg");
+    const UdUnit m = m_system->unitBySymbol("m");
+    const UdUnit s = m_system->unitBySymbol("s");
+    const UdUnit kilonewton = m_system->unitFromString("kN");
+    if (lazy) {
+        QVERIFY((UdUnitBuilder(kg) * m / UdUnitBuilder(s).raisedBy(2) * 1000.0).toUnit() == kilonewton);
+        QBENCHMARK {
+            UdUnit unit = (UdUnitBuilder(kg) * m / UdUnitBuilder(s).raisedBy(2) * 1000.0).toUnit();
+            Q_UNUSED(unit);
+        }
+    } else {
+        QVERIFY(kg * m / s.raisedBy(2) * 1000.0 == kilonewton);
+        QBENCHMARK {
+            UdUnit unit = kg * m / s.raisedBy(2) * 1000.0;
+            Q_UNUSED(unit);
+        }
+    }
+}
+
+void UdUnits2Benchmark::toggleUnit_data()
+{
+    QTest::addColumn<bool>("matrix");
+    QTest::newRow("converter") << false;
+    QTest::newRow("matrix")    << true;
+}
+
+void UdUnits2Benchmark::toggleUnit()
+{
+    QFETCH(bool, matrix);
+    const char *const family[] = { "Pa", "hPa", "kPa", "bar", "mbar", "psi", "atm", "mmHg", "inHg" };
+    QVector<UdUnit> units;
+    for (const char *text: family)
+        units.append(m_system->unitFromString(text));
+    const UdConversionMatrix table(units);
+    QVERIFY(table.isValid());
+    const int count = units.size();
+    qreal result = 0.0;
+    int to = 0;
+    if (matrix) {
+        QBENCHMARK {
+            to = (to + 1) % count;
+            result += table.convert(101325.0, 0, to);
+        }
+    } else {
+        QBENCHMARK {
+            to = (to + 1) % count;
+            result += UdUnitConverter(units.first(), units.at(to)).convert(101325.0);
+        }
+    }
+    Q_UNUSED(result);
+}
+
+void UdUnits2Benchmark::serializeUnit_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<bool>("binary");
+    QTest::newRow("product text")   << QString("kg m-2 s-1") << false;
+    QTest::newRow("product binary") << QString("kg m-2 s-1") << true;
+    QTest::newRow("offset text")    << QString("degF")       << false;
+    QTest::newRow("offset binary")  << QString("degF")       << true;
+}
+
+void UdUnits2Benchmark::serializeUnit()
+{
+    QFETCH(QString, text);
+    QFETCH(bool, binary);
+    const UdUnit unit = m_system->unitFromString(text);
+    QVERIFY(unit.isValid());
+    QByteArray data;
+    data.reserve(256);
+    if (binary) {
+        QBENCHMARK {
+            data.resize(0);
+            QDataStream out(&data, QIODevice::WriteOnly);
+            m_system->writeUnit(out, unit);
+            QDataStream in(data);
+            m_system->readUnit(in);
+        }
+    } else {
+        QBENCHMARK {
+            m_system->unitFromString(unit.format(UdUnit::DefinitionForm));
+        }
+    }
+}
+
+void UdUnits2Benchmark::autoPrefix_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::newRow("1")  << 1;
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("1M") << 1000000;
+}
+
+void UdUnits2Benchmark::autoPrefix()
+{
+    QFETCH(int, count);
+    const UdUnit ampere = m_system->unitBySymbol("A");
+    QVector<qreal> values(count);
+    for (int i = 0; i < count; ++i)
+        values[i] = 1e-4 * ((qint64(i) * 7919) % 1000);
+    UdUnitPrefix prefix;
+    m_system->autoPrefix(ampere, values.constData(), values.size(), &prefix);
+    QCOMPARE(prefix.symbol(), count > 1 ? QString("m") : QString());
+    QBENCHMARK {
+        m_system->autoPrefix(ampere, values.constData(), values.size());
+    }
+}
+
+// 1000 records converted per iteration, compared with parsing units and
+// creating a converter for each quantity
+void UdUnits2Benchmark::convertRecords_data()
+{
+    QTest::addColumn<QString>("input");
+    QTest::newRow("naive") << QString("naive");
+    QTest::newRow("variant") << QString("variant");
+    QTest::newRow("json") << QString("json");
+    QTest::newRow("bytes") << QString("bytes");
+}
+
+void UdUnits2Benchmark::convertRecords()
+{
+    QFETCH(QString, input);
+    const QJsonArray records = weatherRecords(1000);
+    UdRecordConverter converter(m_system);
+    QVERIFY(converter.addFields(s_weatherSchema));
+    QVector<UdRecordConverter::FieldError> errors;
+    converter.convert(records, &errors);
+    QVERIFY(errors.isEmpty());
+
+    if (input == "naive") {
+        QBENCHMARK {
+            QJsonArray results;
+            for (const QJsonValue &value: records) {
+                QJsonObject record = value.toObject();
+                for (auto it = s_weatherSchema.constBegin(); it != s_weatherSchema.constEnd(); ++it) {
+                    const QStringList keys = it.key().split('.');
+                    QJsonObject parent = keys.size() > 1 ? record.value(keys.first()).toObject()
+                                                         : record;
+                    QJsonObject quantity = parent.value(keys.last()).toObject();
+                    UdUnitConverter unitConverter(
+                                m_system->unitFromString(quantity.value("unit").toString()),
+                                m_system->unitFromString(it.value().toString()));
+                    quantity.insert("value", unitConverter.convert(quantity.value("value").toDouble()));
+                    quantity.insert("unit", it.value().toString());
+                    parent.insert(keys.last(), quantity);
+                    if (keys.size() > 1)
+                        record.insert(keys.first(), parent);
+                    else
+                        record = parent;
+                }
+                results.append(record);
+            }
+        }
+    } else if (input == "variant") {
+        const QVariantList variants = records.toVariantList();
+        QBENCHMARK {
+            converter.convert(variants);
+        }
+    } else if (input == "json") {
+        QBENCHMARK {
+            converter.convert(records);
+        }
+    } else {
+        const QByteArray json = QJsonDocument(records).toJson(QJsonDocument::Compact);
+        QBENCHMARK {
+            converter.convertJson(json);
+        }
+    }
+}
+
+void UdUnits2Benchmark::serializeConverter()
+{
+    const UdUnitConverter converter(m_system->unitBySymbol("degF"), m_system->unitBySymbol("degC"));
+    UdUnitConverter result(converter);
+    QByteArray data;
+    data.reserve(256);
+    QBENCHMARK {
+        data.resize(0);
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out << converter;
+        QDataStream in(data);
+        in >> result;
+    }
+}
+
+void UdUnits2Benchmark::concurrentSnapshot()
+{
+    UdConcurrentUnitSystem system;
+    QVERIFY(system.isValid());
+    QBENCHMARK {
+        system.snapshot();
+    }
+}
+
+void UdUnits2Benchmark::concurrentRefresh()
+{
+    UdConcurrentUnitSystem system;
+    QVERIFY(system.isValid());
+    UdUnitSystemSnapshot snapshot = system.snapshot();
+    QBENCHMARK {
+        system.refresh(snapshot);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QStringList arguments;
+    for (int i = 0; i < argc; ++i)
+        arguments.append(QString::fromLocal8Bit(argv[i]));
+    if (!arguments.contains(QStringLiteral("-o")))
+        arguments << QStringLiteral("-o") << QStringLiteral("bench_udunits2.csv,csv")
+                  << QStringLiteral("-o") << QStringLiteral("-,txt");
+    UdUnits2Benchmark benchmark;
+    return QTest::qExec(&benchmark, arguments);
+}
+
+#include "bench_udunits2.moc"
@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# Performance benchmarks
+#
+#-------------------------------------------------
+
+QT       += testlib
+
+QT       -= gui
+
+TARGET = bench_udunits2
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+
+SOURCES += \
+    bench_udunits2.cpp
+
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../src/release/ -lqudunit
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../src/debug/ -lqudunit
+else:unix: LIBS += -L$$OUT_PWD/../src/ -lqudunit -ludunits2
+
+INCLUDEPATH += $$PWD/../src
+DEPENDPATH += $$PWD/../src
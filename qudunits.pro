@@ -5,6 +5,17 @@ DEFINES += QUU_VERSION=\\\"$$UU_VERSION\\\"
 TEMPLATE = subdirs
 SUBDIRS = \
     src \
-    tests
+    tests \
+    tools \
+    udgentable \
+    benchmarks
+
+udgentable.subdir = tools/udgentable
+
+tests.depends = src
+tools.depends = src
+benchmarks.depends = src
+# udgentable is built from the library sources, see src/qudunit.pri
+qudunit_builtin_table: src.depends += udgentable
 
 include(doc/doc.pri)
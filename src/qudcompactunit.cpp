@@ -0,0 +1,684 @@
+#include "qudcompactunit.h"
+
+#include <QHash>
+#include <QReadLocker>
+#include <QReadWriteLock>
+#include <QWriteLocker>
+
+#include <cmath>
+
+namespace {
+
+// Base units and powers of a compact unit, sorted by identifier address
+struct DimensionKey
+{
+    const char *identifiers[UdCompactUnit::MaximumBaseUnitCount];
+    int powers[UdCompactUnit::MaximumBaseUnitCount];
+    int count;
+};
+
+bool operator ==(const DimensionKey &lhs, const DimensionKey &rhs)
+{
+    if (lhs.count != rhs.count)
+        return false;
+    for (int i = 0; i < lhs.count; ++i) {
+        if (lhs.identifiers[i] != rhs.identifiers[i] || lhs.powers[i] != rhs.powers[i])
+            return false;
+    }
+    return true;
+}
+
+uint qHash(const DimensionKey &key, uint seed = 0)
+{
+    uint hash = seed ^ uint(key.count);
+    for (int i = 0; i < key.count; ++i)
+        hash = hash * 31u + (uint(quintptr(key.identifiers[i]) >> 3) ^ uint(key.powers[i]));
+    return hash;
+}
+
+// Units created for the compact units of a unit-system, owned: base units by
+// identifier, and products of their powers by dimension vector
+struct SystemUnits
+{
+    ~SystemUnits()
+    {
+        for (ut_unit *unit: bases)
+            ut_free(unit);
+        for (ut_unit *unit: products)
+            ut_free(unit);
+    }
+
+    QHash<const char *, ut_unit *> bases;
+    QHash<DimensionKey, ut_unit *> products;
+};
+
+// Released by UdUnitSystem, before its udunits2 unit-system is freed
+struct UnitCache
+{
+    QReadWriteLock lock;
+    QHash<const ut_system *, SystemUnits *> systems;
+};
+
+Q_GLOBAL_STATIC(UnitCache, s_unitCache)
+
+}
+
+/*!
+ * \class UdCompactUnit
+ * \ingroup index
+ * \preliminary
+ * \brief The UdCompactUnit class is a lightweight representation of a linear unit.
+ *
+ * A compact unit represents a unit as a product of base units raised to integer
+ * powers (its dimension vector), a scale factor and an offset, all of it
+ * stored inline: creating, copying and combining compact units never allocates
+ * memory nor calls into \UU.
+ *
+ * Compact units are meant for unit algebra generating many intermediate units,
+ * only the final result needs to be turned into a UdUnit with toUnit():
+ * \code
+ * UdCompactUnit kg(system->unitBySymbol("kg"));
+ * UdCompactUnit m(system->unitBySymbol("m"));
+ * UdCompactUnit s(system->unitBySymbol("s"));
+ * UdCompactUnit newton = (kg * m) / (s * s);
+ * if (newton.hasSameDimension(force))
+ *     ...
+ * UdUnit unit = newton.toUnit();
+ * \endcode
+ *
+ * Only basic, product and galilean units can be represented, as long as their
+ * base units have a name or a symbol and there are no more than
+ * MaximumBaseUnitCount of them. Constructing a compact unit from any other
+ * unit (timestamp or logarithmic units) gives an invalid compact unit, as does
+ * any meaningless operation (eg. the square root of a meter).
+ *
+ * As with \UU, an offset is dropped when a unit is multiplied, divided,
+ * raised or rooted.
+ *
+ * A compact unit refers to the unit-system of the unit it has been constructed
+ * from, and so must not outlive it.
+ *
+ * \sa UdUnit
+ */
+
+/*!
+ * \internal
+ * Decomposes a unit into a UdCompactUnit.
+ */
+struct UdCompactUnitVisitor
+{
+    static ut_status visitBasic(const ut_unit *unit, void *arg)
+    {
+        UdCompactUnit *compact = static_cast<UdCompactUnit *>(arg);
+        bool isSymbol = true;
+        const char *identifier = ut_get_symbol(unit, UT_UTF8);
+        if (identifier == nullptr) {
+            isSymbol = false;
+            identifier = ut_get_name(unit, UT_UTF8);
+        }
+        if (identifier == nullptr)
+            return UT_VISIT_ERROR;
+        if (!compact->addBase(identifier, isSymbol, ut_is_dimensionless(unit) != 0, 1))
+            return UT_VISIT_ERROR;
+        return UT_SUCCESS;
+    }
+
+    static ut_status visitProduct(const ut_unit *unit, int count, const ut_unit *const *basicUnits,
+                                  const int *powers, void *arg)
+    {
+        Q_UNUSED(unit);
+        UdCompactUnit *compact = static_cast<UdCompactUnit *>(arg);
+        for (int i = 0; i < count; ++i) {
+            bool isSymbol = true;
+            const char *identifier = ut_get_symbol(basicUnits[i], UT_UTF8);
+            if (identifier == nullptr) {
+                isSymbol = false;
+                identifier = ut_get_name(basicUnits[i], UT_UTF8);
+            }
+            if (identifier == nullptr)
+                return UT_VISIT_ERROR;
+            if (!compact->addBase(identifier, isSymbol,
+                                  ut_is_dimensionless(basicUnits[i]) != 0, powers[i]))
+                return UT_VISIT_ERROR;
+        }
+        return UT_SUCCESS;
+    }
+
+    static ut_status visitGalilean(const ut_unit *unit, double scale, const ut_unit *underlyingUnit,
+                                   double origin, void *arg)
+    {
+        Q_UNUSED(unit);
+        UdCompactUnit *compact = static_cast<UdCompactUnit *>(arg);
+        const ut_status status = ut_accept_visitor(underlyingUnit, &visitor, arg);
+        compact->m_scale = scale;
+        compact->m_offset = origin;
+        return status;
+    }
+
+    static ut_status visitTimestamp(const ut_unit *unit, const ut_unit *timeUnit,
+                                    double origin, void *arg)
+    {
+        Q_UNUSED(unit);
+        Q_UNUSED(timeUnit);
+        Q_UNUSED(origin);
+        Q_UNUSED(arg);
+        return UT_VISIT_ERROR;
+    }
+
+    static ut_status visitLogarithmic(const ut_unit *unit, double base,
+                                      const ut_unit *reference, void *arg)
+    {
+        Q_UNUSED(unit);
+        Q_UNUSED(base);
+        Q_UNUSED(reference);
+        Q_UNUSED(arg);
+        return UT_VISIT_ERROR;
+    }
+
+    static ut_visitor visitor;
+};
+
+ut_visitor UdCompactUnitVisitor::visitor = {
+    &UdCompactUnitVisitor::visitBasic,
+    &UdCompactUnitVisitor::visitProduct,
+    &UdCompactUnitVisitor::visitGalilean,
+    &UdCompactUnitVisitor::visitTimestamp,
+    &UdCompactUnitVisitor::visitLogarithmic
+};
+
+/*!
+ * Constructs an invalid compact unit.
+ */
+UdCompactUnit::UdCompactUnit():
+    m_system(nullptr), m_symbolMask(0), m_dimensionlessMask(0), m_count(0),
+    m_valid(false), m_scale(1.0), m_offset(0.0)
+{
+
+}
+
+/*!
+ * Constructs a compact unit equivalent to \a unit. The compact unit is invalid
+ * if \a unit is invalid or if it cannot be represented.
+ */
+UdCompactUnit::UdCompactUnit(const UdUnit &unit):
+    m_system(nullptr), m_symbolMask(0), m_dimensionlessMask(0), m_count(0),
+    m_valid(false), m_scale(1.0), m_offset(0.0)
+{
+    if (!unit.isValid())
+        return;
+    m_system = ut_get_system(unit.m_unit);
+    m_valid = true;
+    if (ut_accept_visitor(unit.m_unit, &UdCompactUnitVisitor::visitor, this) != UT_SUCCESS)
+        invalidate();
+}
+
+/*!
+ * Returns true if this compact unit is valid, false otherwise.
+ */
+bool UdCompactUnit::isValid() const
+{
+    return m_valid;
+}
+
+/*!
+ * Returns true if this compact unit is dimensionless, false otherwise.
+ * An invalid compact unit is considered dimensionfull.
+ */
+bool UdCompactUnit::isDimensionless() const
+{
+    if (!m_valid)
+        return false;
+    for (int i = 0; i < m_count; ++i) {
+        if ((m_dimensionlessMask & (1u << i)) == 0)
+            return false;
+    }
+    return true;
+}
+
+/*!
+ * Returns true if this compact unit and \a other are valid, belong to the
+ * same unit-system and have the same dimension, ie. if values can be converted
+ * between them.
+ */
+bool UdCompactUnit::hasSameDimension(const UdCompactUnit &other) const
+{
+    if (!m_valid || !other.m_valid || m_system != other.m_system)
+        return false;
+    UdCompactUnit ratio(*this);
+    ratio.accumulate(other, -1);
+    return ratio.isDimensionless();
+}
+
+/*!
+ * Returns the scale factor of this compact unit relative to the product of its
+ * base units.
+ */
+qreal UdCompactUnit::scale() const
+{
+    return m_scale;
+}
+
+/*!
+ * Returns the offset of this compact unit, expressed in this compact unit.
+ * \sa UdUnit::offsetBy()
+ */
+qreal UdCompactUnit::offset() const
+{
+    return m_offset;
+}
+
+/*!
+ * Returns the number of distinct base units this compact unit is made of.
+ */
+int UdCompactUnit::baseUnitCount() const
+{
+    return m_count;
+}
+
+/*!
+ * Returns the symbol, or the name if it has no symbol, of the base unit at \a index.
+ */
+QString UdCompactUnit::baseUnitIdentifier(int index) const
+{
+    if (index < 0 || index >= m_count)
+        return QString();
+    return QString::fromUtf8(m_identifiers[index]);
+}
+
+/*!
+ * Returns the power of the base unit at \a index.
+ */
+int UdCompactUnit::basePower(int index) const
+{
+    if (index < 0 || index >= m_count)
+        return 0;
+    return m_powers[index];
+}
+
+/*!
+ * Returns the UdUnit equivalent to this compact unit, or an invalid UdUnit
+ * if this compact unit is invalid or if one of its base units can't be found
+ * in its unit-system anymore.
+ *
+ * The product of the powers of the base units is created by \UU once per
+ * unit-system, from base units looked up once too, and then copied: a
+ * compact unit is turned into a UdUnit with a single \UU unit allocation,
+ * plus one if it has both a scale factor and an offset.
+ */
+UdUnit UdCompactUnit::toUnit() const
+{
+    if (!m_valid)
+        return UdUnit();
+    const ut_unit *product = productUnit();
+    if (product == nullptr)
+        return UdUnit(nullptr, UT_UNKNOWN);
+
+    ut_set_status(UT_SUCCESS);
+    ut_unit *unit = m_scale != 1.0 ? ut_scale(m_scale, product) : ut_clone(product);
+    if (unit != nullptr && m_offset != 0.0) {
+        ut_unit *offset = ut_offset(unit, m_offset);
+        ut_free(unit);
+        unit = offset;
+    }
+    return UdUnit(unit, ut_get_status());
+}
+
+/*!
+ * \internal
+ * Returns the cached product of the powers of the base units of this compact
+ * unit, creating it if needed, or nullptr if a base unit can't be found.
+ * The product is owned by the cache and stays valid as long as the
+ * unit-system.
+ */
+const ut_unit *UdCompactUnit::productUnit() const
+{
+    DimensionKey key;
+    key.count = m_count;
+    for (int i = 0; i < m_count; ++i) {
+        int j = i;
+        for (; j > 0 && key.identifiers[j - 1] > m_identifiers[i]; --j) {
+            key.identifiers[j] = key.identifiers[j - 1];
+            key.powers[j] = key.powers[j - 1];
+        }
+        key.identifiers[j] = m_identifiers[i];
+        key.powers[j] = m_powers[i];
+    }
+
+    UnitCache *cache = s_unitCache();
+    {
+        QReadLocker locker(&cache->lock);
+        const SystemUnits *units = cache->systems.value(m_system, nullptr);
+        if (units != nullptr) {
+            const ut_unit *product = units->products.value(key, nullptr);
+            if (product != nullptr)
+                return product;
+        }
+    }
+
+    // Products are created once per unit-system, holding the lock meanwhile
+    // is simpler than reconciling concurrent creations
+    QWriteLocker locker(&cache->lock);
+    SystemUnits *&units = cache->systems[m_system];
+    if (units == nullptr)
+        units = new SystemUnits;
+    ut_unit *&product = units->products[key];
+    if (product != nullptr)
+        return product;
+
+    ut_unit *result = nullptr;
+    for (int i = 0; i < m_count; ++i) {
+        ut_unit *&base = units->bases[m_identifiers[i]];
+        if (base == nullptr) {
+            base = (m_symbolMask & (1u << i)) ? ut_get_unit_by_symbol(m_system, m_identifiers[i])
+                                              : ut_get_unit_by_name(m_system, m_identifiers[i]);
+        }
+        ut_unit *powered = base == nullptr ? nullptr
+                                           : m_powers[i] != 1 ? ut_raise(base, m_powers[i])
+                                                              : ut_clone(base);
+        ut_unit *next = powered == nullptr || result == nullptr ? powered
+                                                                : ut_multiply(result, powered);
+        if (next != powered)
+            ut_free(powered);
+        ut_free(result);
+        result = next;
+        if (result == nullptr)
+            break;
+    }
+    if (m_count == 0)
+        result = ut_get_dimensionless_unit_one(m_system);
+    if (result == nullptr) {
+        units->products.remove(key);
+        return nullptr;
+    }
+    product = result;
+    return product;
+}
+
+/*!
+ * \internal
+ * Frees the units cached for the compact units of \a system, which is about
+ * to be freed.
+ */
+void UdCompactUnit::releaseUnits(const ut_system *system)
+{
+    UnitCache *cache = s_unitCache();
+    QWriteLocker locker(&cache->lock);
+    delete cache->systems.take(system);
+}
+
+/*!
+ * Returns true if \a lhs and \a rhs are both valid and represent the same unit,
+ * false otherwise.
+ */
+bool operator ==(const UdCompactUnit &lhs, const UdCompactUnit &rhs)
+{
+    if (!lhs.m_valid || !rhs.m_valid)
+        return lhs.m_valid == rhs.m_valid;
+    if (lhs.m_system != rhs.m_system || lhs.m_count != rhs.m_count
+            || lhs.m_scale != rhs.m_scale || lhs.m_offset != rhs.m_offset)
+        return false;
+    for (int i = 0; i < lhs.m_count; ++i) {
+        int j = 0;
+        while (j < rhs.m_count && rhs.m_identifiers[j] != lhs.m_identifiers[i])
+            ++j;
+        if (j == rhs.m_count || rhs.m_powers[j] != lhs.m_powers[i])
+            return false;
+    }
+    return true;
+}
+
+/*!
+ * Returns the product of \a lhs and \a rhs.
+ */
+UdCompactUnit operator *(const UdCompactUnit &lhs, const UdCompactUnit &rhs)
+{
+    UdCompactUnit result(lhs);
+    result *= rhs;
+    return result;
+}
+
+/*!
+ * Returns \a lhs scaled by \a rhs.
+ * \sa scaledBy()
+ */
+UdCompactUnit operator *(const UdCompactUnit &lhs, qreal rhs)
+{
+    return lhs.scaledBy(rhs);
+}
+
+/*!
+ * Returns \a rhs scaled by \a lhs.
+ * \sa scaledBy()
+ */
+UdCompactUnit operator *(qreal lhs, const UdCompactUnit &rhs)
+{
+    return rhs.scaledBy(lhs);
+}
+
+/*!
+ * Returns the quotient of \a lhs by \a rhs.
+ */
+UdCompactUnit operator /(const UdCompactUnit &lhs, const UdCompactUnit &rhs)
+{
+    UdCompactUnit result(lhs);
+    result /= rhs;
+    return result;
+}
+
+/*!
+ * Returns \a lhs scaled by the inverse of \a rhs.
+ * \sa scaledBy()
+ */
+UdCompactUnit operator /(const UdCompactUnit &lhs, qreal rhs)
+{
+    return lhs.scaledBy(1 / rhs);
+}
+
+/*!
+ * Returns the inverse of \a rhs scaled by \a lhs.
+ */
+UdCompactUnit operator /(qreal lhs, const UdCompactUnit &rhs)
+{
+    return rhs.inverted().scaledBy(lhs);
+}
+
+/*!
+ * Returns \a lhs offset by \a rhs.
+ * \sa offsetBy()
+ */
+UdCompactUnit operator +(const UdCompactUnit &lhs, qreal rhs)
+{
+    return lhs.offsetBy(rhs);
+}
+
+/*!
+ * Returns \a lhs offset by minus \a rhs.
+ * \sa offsetBy()
+ */
+UdCompactUnit operator -(const UdCompactUnit &lhs, qreal rhs)
+{
+    return lhs.offsetBy(-rhs);
+}
+
+/*!
+ * Multiplies this compact unit by \a other and returns a reference to this compact unit.
+ */
+UdCompactUnit &UdCompactUnit::operator *=(const UdCompactUnit &other)
+{
+    if (m_valid && other.m_valid)
+        m_scale *= other.m_scale;
+    accumulate(other, 1);
+    return *this;
+}
+
+/*!
+ * Divides this compact unit by \a other and returns a reference to this compact unit.
+ */
+UdCompactUnit &UdCompactUnit::operator /=(const UdCompactUnit &other)
+{
+    if (m_valid && other.m_valid)
+        m_scale /= other.m_scale;
+    accumulate(other, -1);
+    return *this;
+}
+
+/*!
+ * Returns a compact unit equivalent to this compact unit scaled by \a factor.
+ * \sa UdUnit::scaledBy()
+ */
+UdCompactUnit UdCompactUnit::scaledBy(qreal factor) const
+{
+    UdCompactUnit result(*this);
+    if (factor == 0.0 || !std::isfinite(factor)) {
+        result.invalidate();
+        return result;
+    }
+    result.m_scale *= factor;
+    result.m_offset /= factor;
+    return result;
+}
+
+/*!
+ * Returns a compact unit equivalent to this compact unit relative to the origin
+ * defined by \a offset.
+ * \sa UdUnit::offsetBy()
+ */
+UdCompactUnit UdCompactUnit::offsetBy(qreal offset) const
+{
+    UdCompactUnit result(*this);
+    result.m_offset += offset;
+    return result;
+}
+
+/*!
+ * Returns the inverse of this compact unit.
+ */
+UdCompactUnit UdCompactUnit::inverted() const
+{
+    return raisedBy(-1);
+}
+
+/*!
+ * Returns this compact unit raised by \a power.
+ */
+UdCompactUnit UdCompactUnit::raisedBy(int power) const
+{
+    UdCompactUnit result(*this);
+    if (!m_valid)
+        return result;
+    result.m_offset = 0.0;
+    result.m_scale = std::pow(m_scale, power);
+    if (power == 0) {
+        result.m_count = 0;
+        result.m_symbolMask = 0;
+        result.m_dimensionlessMask = 0;
+    }
+    for (int i = 0; i < result.m_count; ++i)
+        result.m_powers[i] = qint16(result.m_powers[i] * power);
+    return result;
+}
+
+/*!
+ * Returns the \a root 'th root of this compact unit, or an invalid compact unit
+ * if the root is meaningless.
+ */
+UdCompactUnit UdCompactUnit::rootedBy(int root) const
+{
+    UdCompactUnit result(*this);
+    if (!m_valid)
+        return result;
+    if (root <= 0 || (m_scale < 0.0 && root % 2 == 0)) {
+        result.invalidate();
+        return result;
+    }
+    for (int i = 0; i < result.m_count; ++i) {
+        if (result.m_powers[i] % root != 0) {
+            result.invalidate();
+            return result;
+        }
+        result.m_powers[i] = qint16(result.m_powers[i] / root);
+    }
+    result.m_offset = 0.0;
+    result.m_scale = m_scale < 0.0 ? -std::pow(-m_scale, 1.0 / root)
+                                   : std::pow(m_scale, 1.0 / root);
+    return result;
+}
+
+/*!
+ * \internal
+ */
+void UdCompactUnit::invalidate()
+{
+    m_valid = false;
+    m_count = 0;
+    m_symbolMask = 0;
+    m_dimensionlessMask = 0;
+    m_scale = 1.0;
+    m_offset = 0.0;
+}
+
+/*!
+ * \internal
+ * Adds the base units of \a other raised by \a sign to this compact unit.
+ * The scale factor is left untouched and the offset is dropped.
+ */
+void UdCompactUnit::accumulate(const UdCompactUnit &other, int sign)
+{
+    if (!m_valid)
+        return;
+    if (!other.m_valid || other.m_system != m_system) {
+        invalidate();
+        return;
+    }
+    m_offset = 0.0;
+    for (int i = 0; i < other.m_count; ++i) {
+        if (!addBase(other.m_identifiers[i], (other.m_symbolMask & (1u << i)) != 0,
+                     (other.m_dimensionlessMask & (1u << i)) != 0,
+                     sign * other.m_powers[i])) {
+            invalidate();
+            return;
+        }
+    }
+}
+
+/*!
+ * \internal
+ * Multiplies this compact unit by the base unit \a identifier raised by \a power.
+ * Returns false if there's no room left for a new base unit.
+ */
+bool UdCompactUnit::addBase(const char *identifier, bool isSymbol, bool isDimensionless, int power)
+{
+    for (int i = 0; i < m_count; ++i) {
+        if (m_identifiers[i] != identifier)
+            continue;
+        m_powers[i] = qint16(m_powers[i] + power);
+        if (m_powers[i] == 0) {
+            // Move the last base unit in place of this one
+            const int last = m_count - 1;
+            const quint16 lastBit = quint16(1u << last);
+            const quint16 bit = quint16(1u << i);
+            m_identifiers[i] = m_identifiers[last];
+            m_powers[i] = m_powers[last];
+            m_symbolMask = quint16((m_symbolMask & ~bit) | ((m_symbolMask & lastBit) ? bit : 0));
+            m_dimensionlessMask = quint16((m_dimensionlessMask & ~bit)
+                                          | ((m_dimensionlessMask & lastBit) ? bit : 0));
+            m_symbolMask &= quint16(~lastBit);
+            m_dimensionlessMask &= quint16(~lastBit);
+            --m_count;
+        }
+        return true;
+    }
+    if (power == 0)
+        return true;
+    if (m_count == MaximumBaseUnitCount)
+        return false;
+    const quint16 bit = quint16(1u << m_count);
+    m_identifiers[m_count] = identifier;
+    m_powers[m_count] = qint16(power);
+    if (isSymbol)
+        m_symbolMask |= bit;
+    if (isDimensionless)
+        m_dimensionlessMask |= bit;
+    ++m_count;
+    return true;
+}
@@ -0,0 +1,76 @@
+#ifndef QUDCOMPACTUNIT_H
+#define QUDCOMPACTUNIT_H
+
+#include "qudunit_global.h"
+#include "qudunit.h"
+
+class QUDUNITSHARED_EXPORT UdCompactUnit
+{
+public:
+    enum {
+        MaximumBaseUnitCount = 10
+    };
+
+    UdCompactUnit();
+    explicit UdCompactUnit(const UdUnit &unit);
+
+    bool isValid() const;
+    bool isDimensionless() const;
+    bool hasSameDimension(const UdCompactUnit &other) const;
+
+    qreal scale() const;
+    qreal offset() const;
+    int baseUnitCount() const;
+    QString baseUnitIdentifier(int index) const;
+    int basePower(int index) const;
+
+    UdUnit toUnit() const;
+
+    friend bool operator ==(const UdCompactUnit &lhs, const UdCompactUnit &rhs);
+    inline friend bool operator !=(const UdCompactUnit &lhs, const UdCompactUnit &rhs)
+    { return !(lhs == rhs); }
+
+    friend UdCompactUnit operator *(const UdCompactUnit &lhs, const UdCompactUnit &rhs);
+    friend UdCompactUnit operator *(const UdCompactUnit &lhs, qreal rhs);
+    friend UdCompactUnit operator *(qreal lhs, const UdCompactUnit &rhs);
+    friend UdCompactUnit operator /(const UdCompactUnit &lhs, const UdCompactUnit &rhs);
+    friend UdCompactUnit operator /(const UdCompactUnit &lhs, qreal rhs);
+    friend UdCompactUnit operator /(qreal lhs, const UdCompactUnit &rhs);
+    friend UdCompactUnit operator +(const UdCompactUnit &lhs, qreal rhs);
+    friend UdCompactUnit operator -(const UdCompactUnit &lhs, qreal rhs);
+
+    UdCompactUnit &operator *=(const UdCompactUnit &other);
+    UdCompactUnit &operator /=(const UdCompactUnit &other);
+
+    UdCompactUnit scaledBy(qreal factor) const;
+    UdCompactUnit offsetBy(qreal offset) const;
+    UdCompactUnit inverted() const;
+    UdCompactUnit raisedBy(int power) const;
+    UdCompactUnit rootedBy(int root) const;
+
+private:
+    friend class UdUnitSystem;
+    friend struct UdCompactUnitVisitor;
+
+    void invalidate();
+    void accumulate(const UdCompactUnit &other, int sign);
+    bool addBase(const char *identifier, bool isSymbol, bool isDimensionless, int power);
+    const ut_unit *productUnit() const;
+    static void releaseUnits(const ut_system *system);
+
+    // Base units are identified by the symbol (or name if they have no
+    // symbol) their unit-system maps them to. These strings are owned by the
+    // unit-system, so the same base unit always has the same identifier
+    // address for the lifetime of the unit-system.
+    const ut_system *m_system;
+    const char *m_identifiers[MaximumBaseUnitCount];
+    qint16 m_powers[MaximumBaseUnitCount];
+    quint16 m_symbolMask;
+    quint16 m_dimensionlessMask;
+    qint16 m_count;
+    bool m_valid;
+    qreal m_scale;
+    qreal m_offset;
+};
+
+#endif // QUDCOMPACTUNIT_H
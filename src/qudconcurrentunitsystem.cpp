@@ -0,0 +1,324 @@
+#include "qudconcurrentunitsystem.h"
+
+#include <QMutexLocker>
+#include <QScopedPointer>
+
+#include <atomic>
+
+/*!
+ * \internal
+ * An immutable version of a unit-system.
+ */
+struct UdUnitSystemVersion
+{
+    UdUnitSystemVersion(UdUnitSystem *system, quint64 number):
+        system(system), number(number)
+    {
+    }
+
+    QScopedPointer<UdUnitSystem> system;
+    quint64 number;
+};
+
+/*!
+ * \class UdUnitSystemSnapshot
+ * \ingroup index
+ * \preliminary
+ * \brief The UdUnitSystemSnapshot class is an immutable version of a UdConcurrentUnitSystem.
+ *
+ * A snapshot keeps its version of the unit-system alive: the unit-system is
+ * destroyed when the last snapshot referring to it is destroyed, and not
+ * before, even if newer versions have been published in the meantime.
+ *
+ * Units obtained from a snapshot belong to the unit-system of that version,
+ * they must not outlive the snapshot, and they can be neither compared nor
+ * converted to units obtained from another version.
+ *
+ * \sa UdConcurrentUnitSystem
+ */
+
+/*!
+ * Constructs an invalid snapshot.
+ */
+UdUnitSystemSnapshot::UdUnitSystemSnapshot()
+{
+
+}
+
+/*!
+ * \internal
+ */
+UdUnitSystemSnapshot::UdUnitSystemSnapshot(const std::shared_ptr<const UdUnitSystemVersion> &version):
+    m_version(version)
+{
+
+}
+
+/*!
+ * Returns true if this snapshot refers to a valid unit-system, false otherwise.
+ */
+bool UdUnitSystemSnapshot::isValid() const
+{
+    return m_version && m_version->system->isValid();
+}
+
+/*!
+ * Returns the version number of this snapshot, or 0 if the snapshot is
+ * invalid. Versions are numbered from 1, increasing with each publication.
+ */
+quint64 UdUnitSystemSnapshot::version() const
+{
+    return m_version ? m_version->number : 0;
+}
+
+/*!
+ * Returns the unit-system of this snapshot, or nullptr if the snapshot is
+ * invalid.
+ */
+const UdUnitSystem *UdUnitSystemSnapshot::system() const
+{
+    return m_version ? m_version->system.data() : nullptr;
+}
+
+/*!
+ * \fn const UdUnitSystem *UdUnitSystemSnapshot::operator ->() const
+ * Returns the unit-system of this snapshot.
+ * \sa system()
+ */
+
+/*!
+ * \class UdConcurrentUnitSystem
+ * \ingroup index
+ * \preliminary
+ * \brief The UdConcurrentUnitSystem class is a unit-system which can be
+ * extended while being used by other threads.
+ *
+ * A UdUnitSystem can't be modified while other threads use it. A concurrent
+ * unit-system instead publishes immutable versions of a unit-system: readers
+ * take a UdUnitSystemSnapshot of the current version, and writers register new
+ * units and prefixes by building and publishing a new version, without ever
+ * blocking readers. Old versions are destroyed when they are not used any
+ * more.
+ *
+ * Taking a snapshot atomically loads a shared pointer to the current version.
+ * Readers looking for the best throughput keep their snapshot and call
+ * refresh() regularly, which only costs an atomic load of the version number
+ * as long as nothing has been published:
+ * \code
+ * UdUnitSystemSnapshot snapshot = system.snapshot();
+ * forever {
+ *     if (system.refresh(snapshot))
+ *         converter = UdUnitConverter(snapshot->unitFromString(from),
+ *                                     snapshot->unitFromString(to));
+ *     converter.convert(values.constData(), values.data(), values.size());
+ *     ...
+ * }
+ * \endcode
+ *
+ * \UU can't copy a unit-system, so a writer builds a new version by loading
+ * the database again and replaying all the registrations made so far, then
+ * the new ones. This makes registrations expensive, apply() registers many
+ * of them at once. Writers are serialized, and a registration that fails
+ * leaves the current version untouched.
+ *
+ * Lookups, parsing and conversions are thread-safe on a snapshot, see
+ * UdUnitSystem. Lookups and conversions run concurrently. Parsing is
+ * serialized process-wide because \UU parser is not reentrant, and waits
+ * while a writer loads the database: readers should parse once per version,
+ * as above, rather than once per value.
+ *
+ * \sa UdUnitSystemSnapshot, UdUnitSystem
+ */
+
+/*!
+ * \class UdConcurrentUnitSystem::Registration
+ * \brief The Registration struct describes a unit or a prefix to add.
+ *
+ * \c kind tells what to add:
+ * \list
+ *  \li BaseUnit: a new base unit, with \c name and \c symbol.
+ *  \li DimensionlessUnit: a new dimensionless unit, with \c name and \c symbol.
+ *  \li Unit: the unit parsed from \c definition, eg. "1852 m", mapped to
+ *      \c name and \c symbol.
+ *  \li Prefix: a prefix \c name and \c symbol standing for \c value.
+ * \endlist
+ */
+
+/*!
+ * Constructs a concurrent unit-system and publishes its first version, loaded
+ * from the database \a databasePath, see UdUnitSystem::loadDatabase().
+ */
+UdConcurrentUnitSystem::UdConcurrentUnitSystem(const QString &databasePath):
+    m_databasePath(databasePath), m_version(0)
+{
+    UdUnitSystem *system = UdUnitSystem::loadDatabase(m_databasePath);
+    m_error = system->error();
+    publish(system);
+}
+
+/*!
+ * Destroys the concurrent unit-system. Snapshots taken from it remain valid.
+ */
+UdConcurrentUnitSystem::~UdConcurrentUnitSystem()
+{
+
+}
+
+/*!
+ * Returns true if the database could be loaded, false otherwise.
+ */
+bool UdConcurrentUnitSystem::isValid() const
+{
+    return !m_error.isError();
+}
+
+/*!
+ * Returns the error that occurred while loading the database, if any.
+ */
+UdError UdConcurrentUnitSystem::error() const
+{
+    return m_error;
+}
+
+/*!
+ * Returns the number of the current version.
+ */
+quint64 UdConcurrentUnitSystem::version() const
+{
+    return m_version.loadAcquire();
+}
+
+/*!
+ * Returns a snapshot of the current version.
+ * This function is thread-safe.
+ */
+UdUnitSystemSnapshot UdConcurrentUnitSystem::snapshot() const
+{
+    return UdUnitSystemSnapshot(std::atomic_load(&m_current));
+}
+
+/*!
+ * Replaces \a snapshot by a snapshot of the current version if it is invalid
+ * or older, and returns true, returns false if \a snapshot is already up to
+ * date.
+ * This function is thread-safe.
+ */
+bool UdConcurrentUnitSystem::refresh(UdUnitSystemSnapshot &snapshot) const
+{
+    if (snapshot.m_version && snapshot.m_version->number == m_version.loadAcquire())
+        return false;
+    snapshot = this->snapshot();
+    return true;
+}
+
+/*!
+ * Publishes a new version with a base unit mapped to \a name and \a symbol.
+ * \sa apply()
+ */
+UdError UdConcurrentUnitSystem::addBaseUnit(const QString &name, const QString &symbol)
+{
+    Registration registration = { Registration::BaseUnit, name, symbol, QString(), 0.0 };
+    return apply(QVector<Registration>() << registration);
+}
+
+/*!
+ * Publishes a new version with a dimensionless unit mapped to \a name and
+ * \a symbol.
+ * \sa apply()
+ */
+UdError UdConcurrentUnitSystem::addDimensionlessUnit(const QString &name, const QString &symbol)
+{
+    Registration registration = { Registration::DimensionlessUnit, name, symbol, QString(), 0.0 };
+    return apply(QVector<Registration>() << registration);
+}
+
+/*!
+ * Publishes a new version where the unit parsed from \a definition is mapped to
+ * \a name and \a symbol.
+ * \sa apply()
+ */
+UdError UdConcurrentUnitSystem::addUnit(const QString &definition, const QString &name,
+                                        const QString &symbol)
+{
+    Registration registration = { Registration::Unit, name, symbol, definition, 0.0 };
+    return apply(QVector<Registration>() << registration);
+}
+
+/*!
+ * Publishes a new version with a prefix \a name and \a symbol standing for
+ * \a value.
+ * \sa apply()
+ */
+UdError UdConcurrentUnitSystem::addPrefix(const QString &name, const QString &symbol, qreal value)
+{
+    Registration registration = { Registration::Prefix, name, symbol, QString(), value };
+    return apply(QVector<Registration>() << registration);
+}
+
+/*!
+ * Builds a new version with all the \a registrations and publishes it.
+ * If any registration fails, nothing is published and the error is returned.
+ * This function is thread-safe, and never blocks readers.
+ */
+UdError UdConcurrentUnitSystem::apply(const QVector<Registration> &registrations)
+{
+    QMutexLocker locker(&m_writeMutex);
+    if (registrations.isEmpty())
+        return UdError();
+
+    QScopedPointer<UdUnitSystem> system(UdUnitSystem::loadDatabase(m_databasePath));
+    if (!system->isValid())
+        return system->error();
+    foreach (const Registration &registration, m_registrations) {
+        const UdError error = apply(system.data(), registration);
+        if (error.isError())
+            return error;
+    }
+    foreach (const Registration &registration, registrations) {
+        const UdError error = apply(system.data(), registration);
+        if (error.isError())
+            return error;
+    }
+
+    m_registrations += registrations;
+    publish(system.take());
+    return UdError();
+}
+
+/*!
+ * \internal
+ * Applies \a registration to \a system.
+ */
+UdError UdConcurrentUnitSystem::apply(UdUnitSystem *system, const Registration &registration)
+{
+    switch (registration.kind) {
+    case Registration::BaseUnit:
+        return system->addBaseUnit(registration.name, registration.symbol).error();
+    case Registration::DimensionlessUnit:
+        return system->addDimensionlessUnit(registration.name, registration.symbol).error();
+    case Registration::Unit: {
+        const UdUnit unit = system->unitFromString(registration.definition);
+        if (!unit.isValid())
+            return unit.error();
+        return UdError::fromStatus(system->registerUnit(unit.m_unit, registration.name,
+                                                        registration.symbol));
+    }
+    case Registration::Prefix:
+        return UdError::fromStatus(system->registerPrefix(registration.name, registration.symbol,
+                                                          registration.value));
+    }
+    return UdError(UdError::BadArgumentError);
+}
+
+/*!
+ * \internal
+ * Makes \a system the current version, taking its ownership.
+ */
+void UdConcurrentUnitSystem::publish(UdUnitSystem *system)
+{
+    const quint64 number = m_version.loadAcquire() + 1;
+    std::shared_ptr<const UdUnitSystemVersion> version =
+            std::make_shared<const UdUnitSystemVersion>(system, number);
+    std::atomic_store(&m_current, version);
+    m_version.storeRelease(number);
+}
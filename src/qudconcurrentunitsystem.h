@@ -0,0 +1,85 @@
+#ifndef QUDCONCURRENTUNITSYSTEM_H
+#define QUDCONCURRENTUNITSYSTEM_H
+
+#include "qudunit_global.h"
+#include "qudunit.h"
+
+#include <QAtomicInteger>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+
+struct UdUnitSystemVersion;
+
+class QUDUNITSHARED_EXPORT UdUnitSystemSnapshot
+{
+public:
+    UdUnitSystemSnapshot();
+
+    bool isValid() const;
+    quint64 version() const;
+    const UdUnitSystem *system() const;
+    inline const UdUnitSystem *operator ->() const
+    { return system(); }
+
+private:
+    friend class UdConcurrentUnitSystem;
+    explicit UdUnitSystemSnapshot(const std::shared_ptr<const UdUnitSystemVersion> &version);
+
+    std::shared_ptr<const UdUnitSystemVersion> m_version;
+};
+
+class QUDUNITSHARED_EXPORT UdConcurrentUnitSystem
+{
+public:
+    struct Registration {
+        enum Kind {
+            BaseUnit = 0,
+            DimensionlessUnit,
+            Unit,
+            Prefix
+        };
+
+        Kind kind;
+        QString name;
+        QString symbol;
+        QString definition;
+        qreal value;
+    };
+
+    explicit UdConcurrentUnitSystem(const QString &databasePath = QString());
+    ~UdConcurrentUnitSystem();
+
+    bool isValid() const;
+    UdError error() const;
+    quint64 version() const;
+
+    UdUnitSystemSnapshot snapshot() const;
+    bool refresh(UdUnitSystemSnapshot &snapshot) const;
+
+    UdError addBaseUnit(const QString &name, const QString &symbol);
+    UdError addDimensionlessUnit(const QString &name, const QString &symbol);
+    UdError addUnit(const QString &definition, const QString &name, const QString &symbol);
+    UdError addPrefix(const QString &name, const QString &symbol, qreal value);
+    UdError apply(const QVector<Registration> &registrations);
+
+private:
+    Q_DISABLE_COPY(UdConcurrentUnitSystem)
+
+    static UdError apply(UdUnitSystem *system, const Registration &registration);
+    void publish(UdUnitSystem *system);
+
+    const QString m_databasePath;
+    std::shared_ptr<const UdUnitSystemVersion> m_current;
+    QAtomicInteger<quint64> m_version;
+    UdError m_error;
+    // Serializes writers, readers never take it
+    QMutex m_writeMutex;
+    QVector<Registration> m_registrations;
+};
+
+Q_DECLARE_TYPEINFO(UdConcurrentUnitSystem::Registration, Q_MOVABLE_TYPE);
+
+#endif // QUDCONCURRENTUNITSYSTEM_H
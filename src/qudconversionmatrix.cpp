@@ -0,0 +1,243 @@
+#include "qudconversionmatrix.h"
+#include "qudinstrumentation_p.h"
+
+#include <QVarLengthArray>
+
+/*!
+ * \class UdConversionMatrix
+ * \ingroup index
+ * \preliminary
+ * \brief The UdConversionMatrix class converts values between any two units
+ * of a family of mutually convertible units.
+ *
+ * A conversion matrix is built once for a family of units, eg. the pressure
+ * units a user can choose from. Each unit is converted to a common reference
+ * unit, the first one, and the affine coefficients of every pair of units
+ * are derived from these conversions and stored in a dense table. Converting
+ * a value from a unit to another then only costs a table lookup and a
+ * multiply-add, without creating any UdUnitConverter:
+ * \code
+ * const UdConversionMatrix pressures(QVector<UdUnit>() << pascal << hectopascal << bar << psi);
+ * display(pressures.convert(value, pressures.indexOf(pascal), selectedIndex));
+ * \endcode
+ *
+ * Units are designated by their index in the family. The coefficients of the
+ * conversions from a unit to all the units are contiguous, which makes
+ * convertToAll() vectorizable.
+ *
+ * Only units whose conversions to the reference unit are affine, ie. not
+ * logarithmic, can be part of a family.
+ *
+ * \sa UdUnitConverter
+ */
+
+/*!
+ * Constructs an invalid, empty, conversion matrix.
+ */
+UdConversionMatrix::UdConversionMatrix():
+    m_error(UdError::BadArgumentError)
+{
+
+}
+
+/*!
+ * Constructs the conversion matrix of the family of \a units, the first of
+ * which is the reference unit.
+ *
+ * If \a units is empty, or if one of the units can't be converted to the
+ * reference unit by an affine conversion, the matrix is invalid and empty.
+ */
+UdConversionMatrix::UdConversionMatrix(const QVector<UdUnit> &units):
+    m_units(units)
+{
+    const int count = m_units.size();
+    if (count == 0) {
+        invalidate(UdError(UdError::BadArgumentError));
+        return;
+    }
+
+    // Conversions to the reference unit, r = a * x + b, in extended precision
+    // so that composing them doesn't add rounding errors of its own
+    QVarLengthArray<long double, 32> factors(count);
+    QVarLengthArray<long double, 32> offsets(count);
+    const UdUnit &reference = m_units.first();
+    for (int i = 0; i < count; ++i) {
+        const UdUnit &unit = m_units.at(i);
+        if (!unit.isValid()) {
+            invalidate(unit.error());
+            return;
+        }
+        const UdUnitConverter converter(unit, reference);
+        if (!converter.isValid()) {
+            invalidate(converter.error());
+            return;
+        }
+        if (converter.m_form != UdUnitConverter::IdentityForm
+                && converter.m_form != UdUnitConverter::AffineForm) {
+            invalidate(UdError(UdError::MeaninglessError));
+            return;
+        }
+        factors[i] = converter.m_factor;
+        offsets[i] = converter.m_offset;
+    }
+
+    // From i to j: y = (a_i * x + b_i - b_j) / a_j
+    m_factors.resize(count * count);
+    m_offsets.resize(count * count);
+    for (int i = 0; i < count; ++i) {
+        for (int j = 0; j < count; ++j) {
+            const int index = i * count + j;
+            if (i == j) {
+                m_factors[index] = 1.0;
+                m_offsets[index] = 0.0;
+            } else {
+                m_factors[index] = qreal(factors[i] / factors[j]);
+                m_offsets[index] = qreal((offsets[i] - offsets[j]) / factors[j]);
+            }
+        }
+    }
+}
+
+/*!
+ * Returns true if the matrix could be built, false otherwise.
+ */
+bool UdConversionMatrix::isValid() const
+{
+    return !m_error.isError();
+}
+
+/*!
+ * Returns the error that prevented the matrix from being built, if any.
+ */
+UdError UdConversionMatrix::error() const
+{
+    return m_error;
+}
+
+/*!
+ * Returns the number of units in the family.
+ */
+int UdConversionMatrix::unitCount() const
+{
+    return m_units.size();
+}
+
+/*!
+ * Returns the unit at \a index, which must be a valid index position.
+ */
+UdUnit UdConversionMatrix::unit(int index) const
+{
+    return m_units.at(index);
+}
+
+/*!
+ * Returns the units of the family.
+ */
+QVector<UdUnit> UdConversionMatrix::units() const
+{
+    return m_units;
+}
+
+/*!
+ * Returns the index of the first unit of the family equal to \a unit, or -1
+ * if there is none.
+ */
+int UdConversionMatrix::indexOf(const UdUnit &unit) const
+{
+    return m_units.indexOf(unit);
+}
+
+/*!
+ * Returns the factor of the conversion from the unit at index \a from to the
+ * unit at index \a to.
+ */
+qreal UdConversionMatrix::factor(int from, int to) const
+{
+    return m_factors.at(from * m_units.size() + to);
+}
+
+/*!
+ * Returns the offset of the conversion from the unit at index \a from to the
+ * unit at index \a to.
+ */
+qreal UdConversionMatrix::offset(int from, int to) const
+{
+    return m_offsets.at(from * m_units.size() + to);
+}
+
+/*!
+ * Returns a converter from the unit at index \a from to the unit at index
+ * \a to, using the coefficients of the matrix. Unlike constructing a
+ * UdUnitConverter, this doesn't call \UU.
+ */
+UdUnitConverter UdConversionMatrix::converter(int from, int to) const
+{
+    QUD_INSTRUMENT_OPERATION(ConverterCreate);
+    const qreal factor = this->factor(from, to);
+    const qreal offset = this->offset(from, to);
+    const UdUnitConverter::Form form = (factor == 1.0 && offset == 0.0)
+            ? UdUnitConverter::IdentityForm : UdUnitConverter::AffineForm;
+    return UdUnitConverter(m_units.at(from), m_units.at(to), form, factor, 1.0, offset);
+}
+
+/*!
+ * \fn qreal UdConversionMatrix::convert(qreal value, int from, int to) const
+ * Returns \a value, expressed in the unit at index \a from, converted to the
+ * unit at index \a to.
+ */
+
+/*!
+ * Converts the \a count values pointed to by \a values from the unit at index
+ * \a from to the unit at index \a to, and stores them in \a results.
+ * \a values and \a results may be the same.
+ */
+void UdConversionMatrix::convert(const qreal *values, qreal *results, qint64 count,
+                                 int from, int to) const
+{
+    QUD_INSTRUMENT_COUNT(ConvertedValues, count);
+    const qreal factor = this->factor(from, to);
+    const qreal offset = this->offset(from, to);
+    for (qint64 i = 0; i < count; ++i)
+        results[i] = factor * values[i] + offset;
+}
+
+/*!
+ * Converts \a value from the unit at index \a from to all the units of the
+ * family, and stores the unitCount() results in \a results, in the order of
+ * the units.
+ */
+void UdConversionMatrix::convertToAll(qreal value, int from, qreal *results) const
+{
+    const int count = m_units.size();
+    QUD_INSTRUMENT_COUNT(ConvertedValues, count);
+    const qreal *factors = m_factors.constData() + from * count;
+    const qreal *offsets = m_offsets.constData() + from * count;
+    for (int j = 0; j < count; ++j)
+        results[j] = factors[j] * value + offsets[j];
+}
+
+/*!
+ * \overload
+ * Converts the \a count values pointed to by \a values from the unit at index
+ * \a from to all the units of the family. \a results must have room for
+ * unitCount() times \a count values: the values converted to the unit at
+ * index j are stored from \c{results + j * count}.
+ */
+void UdConversionMatrix::convertToAll(const qreal *values, qint64 count, int from,
+                                      qreal *results) const
+{
+    for (int j = 0; j < m_units.size(); ++j)
+        convert(values, results + j * count, count, from, j);
+}
+
+/*!
+ * \internal
+ * Makes this matrix invalid and empty because of \a error.
+ */
+void UdConversionMatrix::invalidate(const UdError &error)
+{
+    m_error = error;
+    m_units.clear();
+    m_factors.clear();
+    m_offsets.clear();
+}
@@ -0,0 +1,47 @@
+#ifndef QUDCONVERSIONMATRIX_H
+#define QUDCONVERSIONMATRIX_H
+
+#include "qudunit_global.h"
+#include "qudunit.h"
+#include "quderror.h"
+
+#include <QVector>
+
+class QUDUNITSHARED_EXPORT UdConversionMatrix
+{
+public:
+    UdConversionMatrix();
+    explicit UdConversionMatrix(const QVector<UdUnit> &units);
+
+    bool isValid() const;
+    UdError error() const;
+    int unitCount() const;
+    UdUnit unit(int index) const;
+    QVector<UdUnit> units() const;
+    int indexOf(const UdUnit &unit) const;
+
+    qreal factor(int from, int to) const;
+    qreal offset(int from, int to) const;
+    UdUnitConverter converter(int from, int to) const;
+
+    inline qreal convert(qreal value, int from, int to) const
+    {
+        const int index = from * m_units.size() + to;
+        return m_factors.at(index) * value + m_offsets.at(index);
+    }
+    void convert(const qreal *values, qreal *results, qint64 count, int from, int to) const;
+    void convertToAll(qreal value, int from, qreal *results) const;
+    void convertToAll(const qreal *values, qint64 count, int from, qreal *results) const;
+
+private:
+    void invalidate(const UdError &error);
+
+    QVector<UdUnit> m_units;
+    // Dense row-major tables, the conversion from units i to j is
+    // y = m_factors[i * n + j] * x + m_offsets[i * n + j]
+    QVector<qreal> m_factors;
+    QVector<qreal> m_offsets;
+    UdError m_error;
+};
+
+#endif // QUDCONVERSIONMATRIX_H
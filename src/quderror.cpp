@@ -0,0 +1,140 @@
+#include "quderror.h"
+
+#include <udunits2.h>
+
+/*!
+ * \class UdError
+ * \ingroup index
+ * \preliminary
+ * \brief The UdError class describes the error, if any, of an operation.
+ *
+ * Objects returned by the library carry the error of the operation that
+ * created them: a unit which is not valid tells why with UdUnit::error(),
+ * so does a converter with UdUnitConverter::error() and a unit-system with
+ * UdUnitSystem::error().
+ * \code
+ * UdUnit unit = system->unitFromString(text);
+ * if (!unit.isValid())
+ *     qWarning() << text << unit.error().message();
+ * \endcode
+ *
+ * A UdError is just an error code: creating, copying and testing it costs
+ * nothing, and the error message is only built when message() is called.
+ *
+ * The library doesn't rely on the \UU error message handler, which formats
+ * messages whether they are read or not. Unless the application has installed
+ * its own handler with \c ut_set_error_message_handler(), the library replaces
+ * the default handler, which writes the messages to the standard error, by
+ * \c ut_ignore when the first unit-system is created.
+ */
+
+/*!
+ * \enum UdError::Code
+ * This enum type specifies the errors, they map one to one to the \UU
+ * \c ut_status values:
+ * \value NoError
+ *        No error occurred (\c UT_SUCCESS).
+ * \value BadArgumentError
+ *        An argument is invalid, eg. an invalid unit (\c UT_BAD_ARG).
+ * \value ExistingIdentifierError
+ *        The unit, prefix or identifier already exists (\c UT_EXISTS).
+ * \value NoUnitError
+ *        No such unit exists (\c UT_NO_UNIT).
+ * \value OperatingSystemError
+ *        An operating system error occurred, see \c errno (\c UT_OS).
+ * \value DifferentSystemError
+ *        The units belong to different unit-systems (\c UT_NOT_SAME_SYSTEM).
+ * \value MeaninglessError
+ *        The operation on the units is meaningless (\c UT_MEANINGLESS).
+ * \value NoSecondError
+ *        The unit-system doesn't have a unit named "second" (\c UT_NO_SECOND).
+ * \value VisitError
+ *        An error occurred while visiting a unit (\c UT_VISIT_ERROR).
+ * \value FormatError
+ *        A unit can't be formatted as requested (\c UT_CANT_FORMAT).
+ * \value SyntaxError
+ *        A string unit representation contains a syntax error (\c UT_SYNTAX).
+ * \value UnknownIdentifierError
+ *        A string unit representation contains an unknown identifier (\c UT_UNKNOWN).
+ * \value OpenArgumentError
+ *        Can't open the specified unit database (\c UT_OPEN_ARG).
+ * \value OpenEnvironmentError
+ *        Can't open the unit database specified by the environment variable
+ *        \e {UDUNITS2_XML_PATH} (\c UT_OPEN_ENV).
+ * \value OpenDefaultError
+ *        Can't open the installed, default unit database (\c UT_OPEN_DEFAULT).
+ * \value ParseError
+ *        An error occurred while parsing the unit database (\c UT_PARSE).
+ */
+
+/*!
+ * \fn UdError::UdError()
+ * Constructs a NoError error.
+ */
+
+/*!
+ * \fn UdError::UdError(Code code)
+ * Constructs an error with the given \a code.
+ */
+
+/*!
+ * \fn UdError::Code UdError::code() const
+ * Returns the error code.
+ */
+
+/*!
+ * \fn bool UdError::isError() const
+ * Returns true if the code is not NoError, false otherwise.
+ */
+
+/*!
+ * Returns a human readable description of the error.
+ */
+QString UdError::message() const
+{
+    switch (m_code) {
+    case NoError:
+        return QString();
+    case BadArgumentError:
+        return QStringLiteral("Invalid argument");
+    case ExistingIdentifierError:
+        return QStringLiteral("Unit, prefix or identifier already exists");
+    case NoUnitError:
+        return QStringLiteral("No such unit exists");
+    case OperatingSystemError:
+        return QStringLiteral("Operating system error");
+    case DifferentSystemError:
+        return QStringLiteral("Units belong to different unit-systems");
+    case MeaninglessError:
+        return QStringLiteral("Operation on the units is meaningless");
+    case NoSecondError:
+        return QStringLiteral("Unit-system doesn't have a unit named \"second\"");
+    case VisitError:
+        return QStringLiteral("Error visiting the unit");
+    case FormatError:
+        return QStringLiteral("Unit can't be formatted in the desired manner");
+    case SyntaxError:
+        return QStringLiteral("String unit representation contains a syntax error");
+    case UnknownIdentifierError:
+        return QStringLiteral("String unit representation contains an unknown identifier");
+    case OpenArgumentError:
+        return QStringLiteral("Can't open the specified unit database");
+    case OpenEnvironmentError:
+        return QStringLiteral("Can't open the unit database specified by UDUNITS2_XML_PATH");
+    case OpenDefaultError:
+        return QStringLiteral("Can't open the default unit database");
+    case ParseError:
+        return QStringLiteral("Error parsing the unit database");
+    }
+    return QStringLiteral("Unknown error");
+}
+
+/*!
+ * Returns the error corresponding to the \UU \a status.
+ */
+UdError UdError::fromStatus(int status)
+{
+    if (status < UT_SUCCESS || status > UT_PARSE)
+        return UdError(BadArgumentError);
+    return UdError(Code(status));
+}
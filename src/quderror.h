@@ -0,0 +1,53 @@
+#ifndef QUDERROR_H
+#define QUDERROR_H
+
+#include "qudunit_global.h"
+
+#include <QMetaType>
+#include <QString>
+
+class QUDUNITSHARED_EXPORT UdError
+{
+public:
+    // Values match the ones of ut_status
+    enum Code {
+        NoError = 0,
+        BadArgumentError,
+        ExistingIdentifierError,
+        NoUnitError,
+        OperatingSystemError,
+        DifferentSystemError,
+        MeaninglessError,
+        NoSecondError,
+        VisitError,
+        FormatError,
+        SyntaxError,
+        UnknownIdentifierError,
+        OpenArgumentError,
+        OpenEnvironmentError,
+        OpenDefaultError,
+        ParseError
+    };
+
+    inline UdError(): m_code(NoError) {}
+    inline explicit UdError(Code code): m_code(code) {}
+
+    inline Code code() const { return m_code; }
+    inline bool isError() const { return m_code != NoError; }
+    QString message() const;
+
+    static UdError fromStatus(int status);
+
+    inline friend bool operator ==(const UdError &lhs, const UdError &rhs)
+    { return lhs.m_code == rhs.m_code; }
+    inline friend bool operator !=(const UdError &lhs, const UdError &rhs)
+    { return lhs.m_code != rhs.m_code; }
+
+private:
+    Code m_code;
+};
+
+Q_DECLARE_TYPEINFO(UdError, Q_PRIMITIVE_TYPE);
+Q_DECLARE_METATYPE(UdError::Code);
+
+#endif // QUDERROR_H
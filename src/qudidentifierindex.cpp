@@ -0,0 +1,170 @@
+#include "qudidentifierindex_p.h"
+
+#include <cstring>
+
+namespace {
+
+inline char foldCase(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+}
+
+const int s_initialCapacity = 64;
+
+}
+
+/*!
+ * \class UdIdentifierIndex
+ * \internal
+ * \brief The UdIdentifierIndex class maps the names and symbols of a
+ * unit-system to units, with lookups which stay fast whatever the number of
+ * identifiers.
+ * \sa UdUnitSystem::unitByName(), UdUnitSystem::unitBySymbol()
+ */
+
+UdIdentifierIndex::UdIdentifierIndex()
+{
+
+}
+
+UdIdentifierIndex::~UdIdentifierIndex()
+{
+    for (ut_unit *unit: m_units)
+        ut_free(unit);
+}
+
+/*!
+ * Takes ownership of \a unit and returns its index, to be passed to
+ * insert().
+ */
+int UdIdentifierIndex::addUnit(ut_unit *unit)
+{
+    m_units.append(unit);
+    return m_units.size() - 1;
+}
+
+/*!
+ * Maps the null-terminated \a text to the unit at index \a unit, replacing
+ * its previous mapping if any.
+ */
+void UdIdentifierIndex::insert(const char *text, bool isName, int unit)
+{
+    Map &map = isName ? m_names : m_symbols;
+    if (2 * (map.entries.size() + 1) > map.buckets.size())
+        grow(map);
+
+    quint32 size = 0;
+    const quint32 textHash = hash(text, isName, &size);
+    const int found = findSlot(map, text, isName, textHash, size);
+    Slot &slot = map.buckets[found];
+    if (slot.entry >= 0) {
+        map.entries[slot.entry].unit = unit;
+        return;
+    }
+
+    const Entry entry = { quint32(m_strings.size()), size, unit };
+    m_strings.append(text, int(size));
+    m_strings.append('\0');
+    slot.hash = textHash;
+    slot.entry = map.entries.size();
+    map.entries.append(entry);
+}
+
+/*!
+ * Returns the unit the null-terminated \a text maps to, or nullptr if there
+ * is none.
+ */
+const ut_unit *UdIdentifierIndex::find(const char *text, bool isName) const
+{
+    const int index = indexOf(text, isName);
+    return index >= 0 ? m_units.at(index) : nullptr;
+}
+
+/*!
+ * Returns the index of the unit the null-terminated \a text maps to, or -1 if
+ * there is none.
+ */
+int UdIdentifierIndex::indexOf(const char *text, bool isName) const
+{
+    const Map &map = isName ? m_names : m_symbols;
+    if (map.entries.isEmpty())
+        return -1;
+    quint32 size = 0;
+    const quint32 textHash = hash(text, isName, &size);
+    const Slot &slot = map.buckets.at(findSlot(map, text, isName, textHash, size));
+    return slot.entry >= 0 ? map.entries.at(slot.entry).unit : -1;
+}
+
+/*!
+ * Returns the 32-bit FNV-1a hash of \a text, names being hashed
+ * case-insensitively, and stores its length in \a size.
+ */
+quint32 UdIdentifierIndex::hash(const char *text, bool isName, quint32 *size)
+{
+    quint32 hash = 2166136261u;
+    const char *c = text;
+    for (; *c != '\0'; ++c) {
+        hash ^= quint8(isName ? foldCase(*c) : *c);
+        hash *= 16777619u;
+    }
+    *size = quint32(c - text);
+    // Spread the high bits to the low bits used as slot index
+    hash ^= hash >> 15;
+    hash *= 0x2c1b3c6du;
+    hash ^= hash >> 12;
+    return hash;
+}
+
+/*!
+ * Returns the index of the slot holding \a text in \a map, or of the free
+ * slot it would be inserted in.
+ */
+int UdIdentifierIndex::findSlot(const Map &map, const char *text, bool isName, quint32 hash,
+                                quint32 size) const
+{
+    const quint32 mask = quint32(map.buckets.size() - 1);
+    const Slot *buckets = map.buckets.constData();
+    const char *strings = m_strings.constData();
+    for (quint32 i = hash & mask;; i = (i + 1) & mask) {
+        const Slot &slot = buckets[i];
+        if (slot.entry < 0)
+            return int(i);
+        if (slot.hash != hash)
+            continue;
+        const Entry &entry = map.entries.at(slot.entry);
+        if (entry.size != size)
+            continue;
+        const char *key = strings + entry.text;
+        if (!isName) {
+            if (std::memcmp(key, text, size) == 0)
+                return int(i);
+            continue;
+        }
+        quint32 j = 0;
+        while (j < size && foldCase(key[j]) == foldCase(text[j]))
+            ++j;
+        if (j == size)
+            return int(i);
+    }
+}
+
+/*!
+ * Doubles the capacity of \a map. Slots keep the hash of their identifier,
+ * so no identifier is hashed again.
+ */
+void UdIdentifierIndex::grow(Map &map)
+{
+    const int capacity = map.buckets.isEmpty() ? s_initialCapacity : 2 * map.buckets.size();
+    const Slot empty = { 0, -1 };
+    QVector<Slot> buckets(capacity, empty);
+    const quint32 mask = quint32(capacity - 1);
+    for (const Slot &slot: map.buckets) {
+        if (slot.entry < 0)
+            continue;
+        quint32 i = slot.hash & mask;
+        while (buckets.at(int(i)).entry >= 0)
+            i = (i + 1) & mask;
+        buckets[int(i)] = slot;
+    }
+    map.buckets.swap(buckets);
+}
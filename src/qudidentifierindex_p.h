@@ -0,0 +1,76 @@
+#ifndef QUDIDENTIFIERINDEX_P_H
+#define QUDIDENTIFIERINDEX_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the qudunits API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include <QByteArray>
+#include <QVector>
+
+#include <udunits2.h>
+
+// Names and symbols of a unit-system mapped to units, in front of the
+// udunits2 maps whose lookups and insertions slow down as they grow.
+//
+// Each map is an open-addressing hash table with linear probing over a flat
+// array of (hash, entry) buckets, kept at most half full. Entries refer to
+// their identifier in a single string pool and to their unit by index, so
+// that a lookup touches one slot most of the time, and one entry and one
+// string to confirm it. Names are compared case-insensitively, for ASCII
+// letters, as udunits2 does.
+class UdIdentifierIndex
+{
+public:
+    UdIdentifierIndex();
+    ~UdIdentifierIndex();
+
+    int addUnit(ut_unit *unit);
+    void insert(const char *text, bool isName, int unit);
+    const ut_unit *find(const char *text, bool isName) const;
+    int indexOf(const char *text, bool isName) const;
+    const ut_unit *unit(int index) const { return m_units.at(index); }
+
+    int unitCount() const { return m_units.size(); }
+    int nameCount() const { return m_names.entries.size(); }
+    int symbolCount() const { return m_symbols.entries.size(); }
+
+private:
+    Q_DISABLE_COPY(UdIdentifierIndex)
+
+    struct Slot
+    {
+        quint32 hash;
+        qint32 entry; // -1 if free
+    };
+
+    struct Entry
+    {
+        quint32 text; // offset in m_strings
+        quint32 size;
+        qint32 unit;  // index in m_units
+    };
+
+    struct Map
+    {
+        QVector<Slot> buckets;
+        QVector<Entry> entries;
+    };
+
+    static quint32 hash(const char *text, bool isName, quint32 *size);
+    int findSlot(const Map &map, const char *text, bool isName, quint32 hash, quint32 size) const;
+    static void grow(Map &map);
+
+    Map m_names;
+    Map m_symbols;
+    QByteArray m_strings;
+    // Owned
+    QVector<ut_unit *> m_units;
+};
+
+#endif // QUDIDENTIFIERINDEX_P_H
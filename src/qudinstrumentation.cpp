@@ -0,0 +1,261 @@
+#include "qudinstrumentation_p.h"
+
+#include <QAtomicInteger>
+
+#include <cstring>
+
+/*!
+ * \class UdInstrumentation
+ * \ingroup index
+ * \preliminary
+ * \brief The UdInstrumentation class gives access to the library performance counters.
+ *
+ * When the library is built with the \c QUDUNIT_INSTRUMENTATION define (eg.
+ * with \c{qmake CONFIG+=qudunit_instrumentation}), the public operations of
+ * UdUnitSystem, UdUnit and UdUnitConverter record how many times they have
+ * been called and how long they took, and the library counts the allocations
+ * of \UU units and converters, the number of values converted and the hits and
+ * misses of its caches.
+ *
+ * Durations are accumulated in latency histograms with logarithmic buckets:
+ * bucket \e i counts the calls that took less than bucketUpperBound(\e i)
+ * nanoseconds and at least bucketUpperBound(\e i - 1), the last bucket counts
+ * all the longer calls.
+ *
+ * All the statistics are updated with relaxed atomic operations, they can be
+ * read at any time, from any thread, with snapshot():
+ * \code
+ * const UdInstrumentation::Snapshot snapshot = UdInstrumentation::snapshot();
+ * for (int i = 0; i < UdInstrumentation::OperationCount; ++i) {
+ *     const UdInstrumentation::Operation operation = UdInstrumentation::Operation(i);
+ *     const UdInstrumentation::OperationStatistics &statistics = snapshot.operations[i];
+ *     report(UdInstrumentation::operationName(operation),
+ *            statistics.count, statistics.totalNanoseconds);
+ * }
+ * \endcode
+ *
+ * Values updated concurrently with a snapshot may or may not be part of it,
+ * and a snapshot is not guaranteed to be consistent across statistics.
+ *
+ * Without \c QUDUNIT_INSTRUMENTATION, the instrumentation is compiled out,
+ * isEnabled() returns false and snapshots are all zeros.
+ */
+
+/*!
+ * \enum UdInstrumentation::Operation
+ * This enum type specifies the instrumented operations:
+ * \value LoadDatabase
+ *        UdUnitSystem::loadDatabase()
+ * \value UnitByName
+ *        UdUnitSystem::unitByName()
+ * \value UnitBySymbol
+ *        UdUnitSystem::unitBySymbol()
+ * \value UnitFromString
+ *        UdUnitSystem::unitFromString()
+ * \value DimensionlessUnitOne
+ *        UdUnitSystem::dimensionLessUnitOne()
+ * \value UnitCopy
+ *        UdUnit copy construction and assignment
+ * \value UnitCompare
+ *        UdUnit comparison
+ * \value UnitFormat
+ *        UdUnit::format()
+ * \value UnitArithmetic
+ *        UdUnit operations creating a new unit, such as UdUnit::scaledBy() or
+ *        the product of two units
+ * \value ConverterCreate
+ *        UdUnitConverter construction and UdUnitConverter::inverse()
+ * \value ConverterCopy
+ *        UdUnitConverter copy construction and assignment
+ * \value ConvertValue
+ *        Conversion of a single value
+ * \value ConvertArray
+ *        Conversion of an array of values
+ * \value OperationCount
+ *        The number of operations
+ */
+
+/*!
+ * \enum UdInstrumentation::Counter
+ * This enum type specifies the event counters:
+ * \value UnitAllocations
+ *        Number of units allocated by \UU
+ * \value ConverterAllocations
+ *        Number of converters allocated by \UU
+ * \value ConvertedValues
+ *        Number of values converted
+ * \value CacheHits
+ *        Number of lookups satisfied by a cache of the library
+ * \value CacheMisses
+ *        Number of lookups that missed a cache of the library
+ * \value CounterCount
+ *        The number of counters
+ */
+
+/*!
+ * \class UdInstrumentation::OperationStatistics
+ * \brief The OperationStatistics struct holds the statistics of an operation.
+ *
+ * \c count is the number of calls, \c totalNanoseconds the accumulated
+ * duration of these calls and \c histogram their latency distribution.
+ */
+
+/*!
+ * \class UdInstrumentation::Snapshot
+ * \brief The Snapshot struct holds all the statistics at a point in time.
+ *
+ * \c operations is indexed by Operation and \c counters by Counter.
+ */
+
+#ifdef QUDUNIT_INSTRUMENTATION
+
+namespace {
+
+struct OperationData
+{
+    QAtomicInteger<quint64> count;
+    QAtomicInteger<quint64> totalNanoseconds;
+    QAtomicInteger<quint64> histogram[UdInstrumentation::HistogramBucketCount];
+};
+
+OperationData s_operations[UdInstrumentation::OperationCount];
+QAtomicInteger<quint64> s_counters[UdInstrumentation::CounterCount];
+
+int bucketOf(qint64 nanoseconds)
+{
+    if (nanoseconds <= 0)
+        return 0;
+    const int bits = 64 - qCountLeadingZeroBits(quint64(nanoseconds));
+    return qMin(bits, int(UdInstrumentation::HistogramBucketCount) - 1);
+}
+
+}
+
+/*!
+ * \internal
+ * Records a call to \a operation which took \a nanoseconds.
+ */
+void UdInstrumentationPrivate::record(UdInstrumentation::Operation operation, qint64 nanoseconds)
+{
+    OperationData &data = s_operations[operation];
+    data.count.fetchAndAddRelaxed(1);
+    data.totalNanoseconds.fetchAndAddRelaxed(quint64(qMax(nanoseconds, qint64(0))));
+    data.histogram[bucketOf(nanoseconds)].fetchAndAddRelaxed(1);
+}
+
+/*!
+ * \internal
+ * Adds \a amount to \a counter.
+ */
+void UdInstrumentationPrivate::count(UdInstrumentation::Counter counter, quint64 amount)
+{
+    s_counters[counter].fetchAndAddRelaxed(amount);
+}
+
+#endif // QUDUNIT_INSTRUMENTATION
+
+/*!
+ * Returns true if the library has been built with instrumentation enabled,
+ * false otherwise.
+ */
+bool UdInstrumentation::isEnabled()
+{
+#ifdef QUDUNIT_INSTRUMENTATION
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*!
+ * Returns the current value of all the statistics.
+ */
+UdInstrumentation::Snapshot UdInstrumentation::snapshot()
+{
+    Snapshot result;
+    std::memset(&result, 0, sizeof(result));
+#ifdef QUDUNIT_INSTRUMENTATION
+    for (int i = 0; i < OperationCount; ++i) {
+        result.operations[i].count = s_operations[i].count.load();
+        result.operations[i].totalNanoseconds = s_operations[i].totalNanoseconds.load();
+        for (int j = 0; j < HistogramBucketCount; ++j)
+            result.operations[i].histogram[j] = s_operations[i].histogram[j].load();
+    }
+    for (int i = 0; i < CounterCount; ++i)
+        result.counters[i] = s_counters[i].load();
+#endif
+    return result;
+}
+
+/*!
+ * Resets all the statistics to zero.
+ */
+void UdInstrumentation::reset()
+{
+#ifdef QUDUNIT_INSTRUMENTATION
+    for (int i = 0; i < OperationCount; ++i) {
+        s_operations[i].count.store(0);
+        s_operations[i].totalNanoseconds.store(0);
+        for (int j = 0; j < HistogramBucketCount; ++j)
+            s_operations[i].histogram[j].store(0);
+    }
+    for (int i = 0; i < CounterCount; ++i)
+        s_counters[i].store(0);
+#endif
+}
+
+/*!
+ * Returns a stable, lower-case name for \a operation, suitable as a metric
+ * label, or nullptr if \a operation is out of range.
+ */
+const char *UdInstrumentation::operationName(Operation operation)
+{
+    static const char *const names[OperationCount] = {
+        "load_database",
+        "unit_by_name",
+        "unit_by_symbol",
+        "unit_from_string",
+        "dimensionless_unit_one",
+        "unit_copy",
+        "unit_compare",
+        "unit_format",
+        "unit_arithmetic",
+        "converter_create",
+        "converter_copy",
+        "convert_value",
+        "convert_array"
+    };
+    if (operation < 0 || operation >= OperationCount)
+        return nullptr;
+    return names[operation];
+}
+
+/*!
+ * Returns a stable, lower-case name for \a counter, suitable as a metric
+ * label, or nullptr if \a counter is out of range.
+ */
+const char *UdInstrumentation::counterName(Counter counter)
+{
+    static const char *const names[CounterCount] = {
+        "unit_allocations",
+        "converter_allocations",
+        "converted_values",
+        "cache_hits",
+        "cache_misses"
+    };
+    if (counter < 0 || counter >= CounterCount)
+        return nullptr;
+    return names[counter];
+}
+
+/*!
+ * Returns the exclusive upper bound, in nanoseconds, of the histogram
+ * \a bucket, that is 2 to the power of \a bucket. The last bucket has no
+ * upper bound, this function returns the largest quint64 for it.
+ */
+quint64 UdInstrumentation::bucketUpperBound(int bucket)
+{
+    if (bucket >= HistogramBucketCount - 1)
+        return ~quint64(0);
+    return quint64(1) << qMax(bucket, 0);
+}
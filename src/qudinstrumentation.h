@@ -0,0 +1,59 @@
+#ifndef QUDINSTRUMENTATION_H
+#define QUDINSTRUMENTATION_H
+
+#include "qudunit_global.h"
+
+class QUDUNITSHARED_EXPORT UdInstrumentation
+{
+public:
+    enum Operation {
+        LoadDatabase = 0,
+        UnitByName,
+        UnitBySymbol,
+        UnitFromString,
+        DimensionlessUnitOne,
+        UnitCopy,
+        UnitCompare,
+        UnitFormat,
+        UnitArithmetic,
+        ConverterCreate,
+        ConverterCopy,
+        ConvertValue,
+        ConvertArray,
+        OperationCount
+    };
+
+    enum Counter {
+        UnitAllocations = 0,
+        ConverterAllocations,
+        ConvertedValues,
+        CacheHits,
+        CacheMisses,
+        CounterCount
+    };
+
+    enum {
+        HistogramBucketCount = 32
+    };
+
+    struct OperationStatistics {
+        quint64 count;
+        quint64 totalNanoseconds;
+        quint64 histogram[HistogramBucketCount];
+    };
+
+    struct Snapshot {
+        OperationStatistics operations[OperationCount];
+        quint64 counters[CounterCount];
+    };
+
+    static bool isEnabled();
+    static Snapshot snapshot();
+    static void reset();
+
+    static const char *operationName(Operation operation);
+    static const char *counterName(Counter counter);
+    static quint64 bucketUpperBound(int bucket);
+};
+
+#endif // QUDINSTRUMENTATION_H
@@ -0,0 +1,57 @@
+#ifndef QUDINSTRUMENTATION_P_H
+#define QUDINSTRUMENTATION_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the qudunits API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include "qudinstrumentation.h"
+
+#ifdef QUDUNIT_INSTRUMENTATION
+
+#include <QElapsedTimer>
+
+namespace UdInstrumentationPrivate {
+
+void record(UdInstrumentation::Operation operation, qint64 nanoseconds);
+void count(UdInstrumentation::Counter counter, quint64 amount);
+
+class OperationTimer
+{
+public:
+    explicit OperationTimer(UdInstrumentation::Operation operation):
+        m_operation(operation)
+    {
+        m_timer.start();
+    }
+
+    ~OperationTimer()
+    {
+        record(m_operation, m_timer.nsecsElapsed());
+    }
+
+private:
+    UdInstrumentation::Operation m_operation;
+    QElapsedTimer m_timer;
+};
+
+}
+
+#  define QUD_INSTRUMENT_OPERATION(operation) \
+    UdInstrumentationPrivate::OperationTimer qudOperationTimer(UdInstrumentation::operation)
+#  define QUD_INSTRUMENT_COUNT(counter, amount) \
+    UdInstrumentationPrivate::count(UdInstrumentation::counter, quint64(amount))
+
+#else
+
+#  define QUD_INSTRUMENT_OPERATION(operation) do { } while (false)
+#  define QUD_INSTRUMENT_COUNT(counter, amount) do { } while (false)
+
+#endif // QUDUNIT_INSTRUMENTATION
+
+#endif // QUDINSTRUMENTATION_P_H
@@ -0,0 +1,220 @@
+#include "qudquantityarray.h"
+
+#include <algorithm>
+
+/*!
+ * \class UdQuantityArray
+ * \ingroup index
+ * \preliminary
+ * \brief The UdQuantityArray class is an array of values expressed in a unit.
+ *
+ * A quantity array holds a contiguous buffer of values together with their
+ * unit. The buffer is implicitly shared: copying an array, or taking a slice
+ * of it with mid(), doesn't copy any value.
+ *
+ * Converting an array to another unit with convertTo() or convertedTo() only
+ * records the target unit: the values are converted when they are read, with
+ * at(), copyTo(), toVector() or data(). Successive conversions are composed
+ * into a single one, from the unit the values are stored in (see
+ * storageUnit()) to the last target unit, and converting back to the storage
+ * unit cancels the pending conversion altogether:
+ * \code
+ * UdQuantityArray temperatures(samples, kelvin);
+ * temperatures.convertTo(fahrenheit);   // nothing converted yet
+ * temperatures.convertTo(celsius);      // still nothing converted
+ * plot(temperatures.toVector());        // one K to degC pass
+ * \endcode
+ *
+ * Reading values doesn't modify the array, so values read several times are
+ * converted several times. evaluate() converts the values once and for all,
+ * data() does it before returning a pointer to the values.
+ *
+ * \sa UdUnitConverter
+ */
+
+/*!
+ * Constructs an empty array, with an invalid unit.
+ */
+UdQuantityArray::UdQuantityArray():
+    m_offset(0), m_size(0)
+{
+
+}
+
+/*!
+ * Constructs an array holding \a values expressed in \a unit.
+ * \a values is implicitly shared, not copied.
+ */
+UdQuantityArray::UdQuantityArray(const QVector<qreal> &values, const UdUnit &unit):
+    m_values(values), m_offset(0), m_size(values.size()),
+    m_storageUnit(unit), m_unit(unit)
+{
+
+}
+
+/*!
+ * Returns true if the array has no values, false otherwise.
+ */
+bool UdQuantityArray::isEmpty() const
+{
+    return m_size == 0;
+}
+
+/*!
+ * Returns the number of values in the array.
+ */
+int UdQuantityArray::size() const
+{
+    return m_size;
+}
+
+/*!
+ * Returns the unit the values are read in.
+ */
+UdUnit UdQuantityArray::unit() const
+{
+    return m_unit;
+}
+
+/*!
+ * Returns the unit the values are stored in. It differs from unit() when a
+ * conversion is pending.
+ */
+UdUnit UdQuantityArray::storageUnit() const
+{
+    return m_storageUnit;
+}
+
+/*!
+ * Returns true if the values have to be converted when they are read.
+ */
+bool UdQuantityArray::isConversionPending() const
+{
+    return !m_converter.isNull();
+}
+
+/*!
+ * Makes \a unit the unit the values are read in. The values are not converted
+ * until they are read.
+ * Returns true on success, false if the values can't be converted to \a unit,
+ * in which case the array is left unchanged.
+ */
+bool UdQuantityArray::convertTo(const UdUnit &unit)
+{
+    if (unit == m_unit)
+        return true;
+    if (unit == m_storageUnit) {
+        m_converter.clear();
+        m_unit = m_storageUnit;
+        return true;
+    }
+    QSharedPointer<const UdUnitConverter> converter(new UdUnitConverter(m_storageUnit, unit));
+    if (!converter->isValid())
+        return false;
+    m_converter = converter;
+    m_unit = unit;
+    return true;
+}
+
+/*!
+ * Returns a copy of this array, sharing its values, read in \a unit.
+ * If the values can't be converted to \a unit, an empty array is returned.
+ * \sa convertTo()
+ */
+UdQuantityArray UdQuantityArray::convertedTo(const UdUnit &unit) const
+{
+    UdQuantityArray result(*this);
+    if (!result.convertTo(unit))
+        return UdQuantityArray();
+    return result;
+}
+
+/*!
+ * Returns a slice of this array, sharing its values and its pending
+ * conversion, made of the \a length values starting at \a position.
+ * If \a length is -1 (the default), or if there are less than \a length values
+ * available, all the values from \a position are included.
+ */
+UdQuantityArray UdQuantityArray::mid(int position, int length) const
+{
+    UdQuantityArray result(*this);
+    position = qBound(0, position, m_size);
+    if (length < 0 || length > m_size - position)
+        length = m_size - position;
+    result.m_offset = m_offset + position;
+    result.m_size = length;
+    return result;
+}
+
+/*!
+ * Returns the value at \a index, which must be a valid index position.
+ */
+qreal UdQuantityArray::at(int index) const
+{
+    Q_ASSERT(index >= 0 && index < m_size);
+    const qreal *value = m_values.constData() + m_offset + index;
+    if (m_converter.isNull())
+        return *value;
+    qreal result;
+    m_converter->convert(value, &result, 1);
+    return result;
+}
+
+/*!
+ * \fn qreal UdQuantityArray::operator [](int index) const
+ * Returns the value at \a index.
+ * \sa at()
+ */
+
+/*!
+ * Writes the size() values, in unit(), to \a destination.
+ */
+void UdQuantityArray::copyTo(qreal *destination) const
+{
+    const qreal *values = m_values.constData() + m_offset;
+    if (m_converter.isNull())
+        std::copy(values, values + m_size, destination);
+    else
+        m_converter->convert(values, destination, m_size);
+}
+
+/*!
+ * Returns the values, in unit(). If no conversion is pending and the array
+ * is not a slice, the values are shared, not copied.
+ */
+QVector<qreal> UdQuantityArray::toVector() const
+{
+    if (m_converter.isNull() && m_offset == 0 && m_size == m_values.size())
+        return m_values;
+    QVector<qreal> result(m_size);
+    copyTo(result.data());
+    return result;
+}
+
+/*!
+ * Applies the pending conversion, if any, so that the values are stored in
+ * unit(). Other arrays sharing the values are not affected.
+ */
+void UdQuantityArray::evaluate()
+{
+    if (m_converter.isNull())
+        return;
+    QVector<qreal> values(m_size);
+    m_converter->convert(m_values.constData() + m_offset, values.data(), m_size);
+    m_values = values;
+    m_offset = 0;
+    m_storageUnit = m_unit;
+    m_converter.clear();
+}
+
+/*!
+ * Returns a pointer to the size() values, in unit(), applying the pending
+ * conversion first if any. The pointer remains valid as long as the array is
+ * not modified nor destroyed.
+ * \sa evaluate()
+ */
+const qreal *UdQuantityArray::data()
+{
+    evaluate();
+    return m_values.constData() + m_offset;
+}
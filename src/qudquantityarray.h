@@ -0,0 +1,45 @@
+#ifndef QUDQUANTITYARRAY_H
+#define QUDQUANTITYARRAY_H
+
+#include "qudunit_global.h"
+#include "qudunit.h"
+
+#include <QSharedPointer>
+#include <QVector>
+
+class QUDUNITSHARED_EXPORT UdQuantityArray
+{
+public:
+    UdQuantityArray();
+    UdQuantityArray(const QVector<qreal> &values, const UdUnit &unit);
+
+    bool isEmpty() const;
+    int size() const;
+    UdUnit unit() const;
+    UdUnit storageUnit() const;
+    bool isConversionPending() const;
+
+    bool convertTo(const UdUnit &unit);
+    UdQuantityArray convertedTo(const UdUnit &unit) const;
+    UdQuantityArray mid(int position, int length = -1) const;
+
+    qreal at(int index) const;
+    inline qreal operator [](int index) const
+    { return at(index); }
+    void copyTo(qreal *destination) const;
+    QVector<qreal> toVector() const;
+
+    void evaluate();
+    const qreal *data();
+
+private:
+    QVector<qreal> m_values;
+    int m_offset;
+    int m_size;
+    UdUnit m_storageUnit;
+    UdUnit m_unit;
+    // Conversion from m_storageUnit to m_unit, null if there's none pending
+    QSharedPointer<const UdUnitConverter> m_converter;
+};
+
+#endif // QUDQUANTITYARRAY_H
@@ -0,0 +1,438 @@
+#include "qudrecordconverter.h"
+
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QJsonValue>
+#include <QVariant>
+
+namespace {
+
+// Access to the maps and values of QVariantMap and QJsonObject records, so
+// that both are converted by the same code.
+struct VariantTraits
+{
+    typedef QVariantMap Map;
+    typedef QVariant Value;
+
+    static bool isMap(const Value &value)
+    {
+        return value.userType() == QMetaType::QVariantMap;
+    }
+    static Map toMap(const Value &value) { return value.toMap(); }
+    static Value fromMap(const Map &map) { return map; }
+    static bool toNumber(const Value &value, qreal *number)
+    {
+        switch (value.userType()) {
+        case QMetaType::Double:
+        case QMetaType::Float:
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+            *number = value.toDouble();
+            return true;
+        default:
+            return false;
+        }
+    }
+    static QString toString(const Value &value)
+    {
+        return value.userType() == QMetaType::QString ? value.toString() : QString();
+    }
+    static Value fromNumber(qreal number) { return number; }
+    static Value fromString(const QString &text) { return text; }
+};
+
+struct JsonTraits
+{
+    typedef QJsonObject Map;
+    typedef QJsonValue Value;
+
+    static bool isMap(const Value &value) { return value.isObject(); }
+    static Map toMap(const Value &value) { return value.toObject(); }
+    static Value fromMap(const Map &map) { return map; }
+    static bool toNumber(const Value &value, qreal *number)
+    {
+        if (!value.isDouble())
+            return false;
+        *number = value.toDouble();
+        return true;
+    }
+    static QString toString(const Value &value)
+    {
+        return value.isString() ? value.toString() : QString();
+    }
+    static Value fromNumber(qreal number) { return number; }
+    static Value fromString(const QString &text) { return text; }
+};
+
+const QString s_valueKey = QStringLiteral("value");
+const QString s_unitKey = QStringLiteral("unit");
+
+// Number of parsed units and of converters cached, unit strings come from
+// the records and mustn't grow the caches without limit
+const int s_cacheSize = 256;
+
+}
+
+/*!
+ * \class UdRecordConverter
+ * \ingroup index
+ * \preliminary
+ * \brief The UdRecordConverter class converts the quantities of JSON and
+ * QVariantMap records to the units of a schema.
+ *
+ * A quantity is a map holding a number, and the unit it is expressed in:
+ * \code
+ * {"station": "LFPG", "air": {"temperature": {"value": 293.15, "unit": "K"}}}
+ * \endcode
+ *
+ * The schema maps the path of each quantity, made of the keys leading to it
+ * separated by '.', to its target unit. It is compiled once by addField()
+ * or addFields(), then convert() converts the quantities of each record to
+ * their target unit, in place of their value and unit, and leaves the rest
+ * of the record untouched:
+ * \code
+ * UdRecordConverter converter(system);
+ * converter.addField("air.temperature", "degC");
+ * QJsonObject result = converter.convert(record);
+ * // {"station": "LFPG", "air": {"temperature": {"value": 20, "unit": "degC"}}}
+ * \endcode
+ *
+ * Records usually repeat the same few units, so the converter parses each
+ * unit string once, and creates one UdUnitConverter per pair of source and
+ * target units, which it reuses for all the following records. Each field
+ * also remembers its last source unit, so converting a stream of records in
+ * the same units doesn't even look up the cache. Units which can't be parsed
+ * or converted are not cached, and the cache is cleared once it holds 256
+ * converters, so that records with arbitrary units don't grow it without
+ * limit.
+ *
+ * A quantity which can't be converted, because it is missing or malformed,
+ * because its unit can't be parsed, or because its unit can't be converted
+ * to the target unit, is left unchanged and reported with its record and
+ * path, without stopping the conversion of the other fields and records.
+ *
+ * A record converter isn't thread-safe, and must not be used after its
+ * unit-system is destroyed.
+ *
+ * \sa UdUnitConverter, UdUnitSystem::unitFromString()
+ */
+
+/*!
+ * \class UdRecordConverter::FieldError
+ * \brief The FieldError struct reports a quantity which couldn't be
+ * converted.
+ *
+ * \c record is the index of the record in the converted list or array, 0 for
+ * a single record, and -1 if the whole input is invalid. \c path is the path
+ * of the quantity in the schema, and \c error the reason it wasn't
+ * converted: UdError::BadArgumentError if the quantity is missing or
+ * malformed, the error parsing its unit, or UdError::MeaninglessError if its
+ * unit can't be converted to the target unit.
+ */
+
+/*!
+ * Constructs a record converter with an empty schema, using \a system to
+ * parse units.
+ */
+UdRecordConverter::UdRecordConverter(const UdUnitSystem *system):
+    m_system(system)
+{
+
+}
+
+/*!
+ * Returns the unit-system of this record converter.
+ */
+const UdUnitSystem *UdRecordConverter::system() const
+{
+    return m_system;
+}
+
+/*!
+ * Returns the error of the last call to addField() or addFields().
+ */
+UdError UdRecordConverter::error() const
+{
+    return m_error;
+}
+
+/*!
+ * Adds the quantity at \a path to the schema, to be converted to \a unit.
+ * If \a path is already in the schema, its target unit is replaced.
+ *
+ * Returns false, and sets error(), if \a path is empty or \a unit can't be
+ * parsed.
+ */
+bool UdRecordConverter::addField(const QString &path, const QString &unit)
+{
+    const QStringList keys = path.split(QLatin1Char('.'));
+    if (path.isEmpty() || keys.contains(QString())) {
+        m_error = UdError(UdError::BadArgumentError);
+        return false;
+    }
+    const UdUnit target = parse(unit);
+    if (!target.isValid()) {
+        m_error = target.error();
+        return false;
+    }
+    m_error = UdError();
+
+    Field field = { path, keys, unit, target, QString(), -1 };
+    for (Field &existing: m_fields) {
+        if (existing.path == path) {
+            existing = field;
+            return true;
+        }
+    }
+    m_fields.append(field);
+    return true;
+}
+
+/*!
+ * Adds each path of \a schema to the schema, to be converted to the unit
+ * string it maps to.
+ *
+ * Returns false, and sets error(), at the first field which can't be added.
+ * \sa addField()
+ */
+bool UdRecordConverter::addFields(const QVariantMap &schema)
+{
+    for (auto it = schema.constBegin(); it != schema.constEnd(); ++it) {
+        if (!addField(it.key(), it.value().toString()))
+            return false;
+    }
+    return true;
+}
+
+/*!
+ * Returns the paths of the schema, in the order they were added.
+ */
+QStringList UdRecordConverter::fieldPaths() const
+{
+    QStringList paths;
+    paths.reserve(m_fields.size());
+    for (const Field &field: m_fields)
+        paths.append(field.path);
+    return paths;
+}
+
+/*!
+ * Returns the number of quantities in the schema.
+ */
+int UdRecordConverter::fieldCount() const
+{
+    return m_fields.size();
+}
+
+/*!
+ * Returns a copy of \a record with its quantities converted to the units of
+ * the schema. The quantities which can't be converted are appended to
+ * \a errors, if not null.
+ */
+QVariantMap UdRecordConverter::convert(const QVariantMap &record, QVector<FieldError> *errors)
+{
+    QVariantMap result = record;
+    convertRecord<VariantTraits>(result, 0, errors);
+    return result;
+}
+
+/*!
+ * \overload
+ */
+QJsonObject UdRecordConverter::convert(const QJsonObject &record, QVector<FieldError> *errors)
+{
+    QJsonObject result = record;
+    convertRecord<JsonTraits>(result, 0, errors);
+    return result;
+}
+
+/*!
+ * Returns a copy of \a records with the quantities of each record converted
+ * to the units of the schema. Elements which aren't maps are reported with
+ * an empty path and left unchanged.
+ */
+QVariantList UdRecordConverter::convert(const QVariantList &records, QVector<FieldError> *errors)
+{
+    QVariantList results;
+    results.reserve(records.size());
+    for (int i = 0; i < records.size(); ++i) {
+        const QVariant &record = records.at(i);
+        if (!VariantTraits::isMap(record)) {
+            if (errors != nullptr)
+                errors->append({ i, QString(), UdError(UdError::BadArgumentError) });
+            results.append(record);
+            continue;
+        }
+        QVariantMap result = record.toMap();
+        convertRecord<VariantTraits>(result, i, errors);
+        results.append(QVariant(result));
+    }
+    return results;
+}
+
+/*!
+ * \overload
+ */
+QJsonArray UdRecordConverter::convert(const QJsonArray &records, QVector<FieldError> *errors)
+{
+    QJsonArray results;
+    for (int i = 0; i < records.size(); ++i) {
+        const QJsonValue record = records.at(i);
+        if (!record.isObject()) {
+            if (errors != nullptr)
+                errors->append({ i, QString(), UdError(UdError::BadArgumentError) });
+            results.append(record);
+            continue;
+        }
+        QJsonObject result = record.toObject();
+        convertRecord<JsonTraits>(result, i, errors);
+        results.append(result);
+    }
+    return results;
+}
+
+/*!
+ * Returns the compact JSON of the record or array of records \a json, with
+ * their quantities converted to the units of the schema.
+ *
+ * Returns an empty byte array, and appends a UdError::ParseError with
+ * record -1 to \a errors, if \a json isn't a valid JSON object or array.
+ */
+QByteArray UdRecordConverter::convertJson(const QByteArray &json, QVector<FieldError> *errors)
+{
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(json, &parseError);
+    if (parseError.error != QJsonParseError::NoError || document.isNull()) {
+        if (errors != nullptr)
+            errors->append({ -1, QString(), UdError(UdError::ParseError) });
+        return QByteArray();
+    }
+    if (document.isArray())
+        return QJsonDocument(convert(document.array(), errors)).toJson(QJsonDocument::Compact);
+    return QJsonDocument(convert(document.object(), errors)).toJson(QJsonDocument::Compact);
+}
+
+/*!
+ * Returns the number of converters cached, one for each pair of source and
+ * target units met so far, up to 256.
+ */
+int UdRecordConverter::cacheSize() const
+{
+    return m_converters.size();
+}
+
+/*!
+ * Clears the parsed units and the converters cached, for example after new
+ * units or aliases are registered in the unit-system. The schema is kept.
+ */
+void UdRecordConverter::clearCache()
+{
+    m_units.clear();
+    m_converterIndexes.clear();
+    m_converters.clear();
+    for (Field &field: m_fields) {
+        field.lastSource.clear();
+        field.lastConverter = -1;
+    }
+}
+
+template <typename Traits>
+void UdRecordConverter::convertRecord(typename Traits::Map &record, int index,
+                                      QVector<FieldError> *errors)
+{
+    for (Field &field: m_fields) {
+        const UdError error = convertField<Traits>(record, field, 0);
+        if (error.isError() && errors != nullptr)
+            errors->append({ index, field.path, error });
+    }
+}
+
+// Converts the quantity of field whose key at depth is in map, writing back
+// the maps leading to it only once it is converted.
+template <typename Traits>
+UdError UdRecordConverter::convertField(typename Traits::Map &map, Field &field, int depth)
+{
+    const QString &key = field.keys.at(depth);
+    const typename Traits::Value node = map.value(key);
+    if (!Traits::isMap(node))
+        return UdError(UdError::BadArgumentError);
+
+    typename Traits::Map child = Traits::toMap(node);
+    if (depth + 1 < field.keys.size()) {
+        const UdError error = convertField<Traits>(child, field, depth + 1);
+        if (error.isError())
+            return error;
+    } else {
+        qreal value = 0.0;
+        const QString source = Traits::toString(child.value(s_unitKey));
+        if (!Traits::toNumber(child.value(s_valueKey), &value) || source.isEmpty())
+            return UdError(UdError::BadArgumentError);
+        UdError error;
+        UdUnitConverter *unitConverter = converter(field, source, &error);
+        if (unitConverter == nullptr)
+            return error;
+        child.insert(s_valueKey, Traits::fromNumber(unitConverter->convert(value)));
+        child.insert(s_unitKey, Traits::fromString(field.unitText));
+    }
+    map.insert(key, Traits::fromMap(child));
+    return UdError();
+}
+
+/*!
+ * \internal
+ * Returns the cached converter from \a source unit string to the unit of
+ * \a field, creating it if needed. Returns nullptr, and stores the error in
+ * \a error, if there is no such converter. The returned converter is valid
+ * until the next call.
+ */
+UdUnitConverter *UdRecordConverter::converter(Field &field, const QString &source,
+                                              UdError *error)
+{
+    if (field.lastConverter >= 0 && field.lastSource == source)
+        return &m_converters[field.lastConverter];
+
+    const QPair<QString, QString> key(source, field.unitText);
+    int index = m_converterIndexes.value(key, -1);
+    if (index < 0) {
+        const UdUnit from = parse(source);
+        if (!from.isValid()) {
+            *error = from.error();
+            return nullptr;
+        }
+        const UdUnitConverter created(from, field.unit);
+        if (!created.isValid()) {
+            *error = created.error().isError() ? created.error()
+                                               : UdError(UdError::MeaninglessError);
+            return nullptr;
+        }
+        if (m_converters.size() >= s_cacheSize)
+            clearCache();
+        index = m_converters.size();
+        m_converters.append(created);
+        m_converterIndexes.insert(key, index);
+    }
+    field.lastSource = source;
+    field.lastConverter = index;
+    return &m_converters[index];
+}
+
+/*!
+ * \internal
+ * Returns the unit parsed from \a text, from the cache if already parsed.
+ * Texts which can't be parsed are not cached.
+ */
+UdUnit UdRecordConverter::parse(const QString &text)
+{
+    auto it = m_units.constFind(text);
+    if (it != m_units.constEnd())
+        return it.value();
+    const UdUnit unit = m_system->unitFromString(text);
+    if (!unit.isValid())
+        return unit;
+    if (m_units.size() >= s_cacheSize)
+        m_units.clear();
+    m_units.insert(text, unit);
+    return unit;
+}
@@ -0,0 +1,75 @@
+#ifndef QUDRECORDCONVERTER_H
+#define QUDRECORDCONVERTER_H
+
+#include "qudunit_global.h"
+#include "qudunit.h"
+
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+#include <QVariantMap>
+#include <QVector>
+
+class QUDUNITSHARED_EXPORT UdRecordConverter
+{
+public:
+    struct FieldError {
+        int record;
+        QString path;
+        UdError error;
+    };
+
+    explicit UdRecordConverter(const UdUnitSystem *system);
+
+    const UdUnitSystem *system() const;
+    UdError error() const;
+
+    bool addField(const QString &path, const QString &unit);
+    bool addFields(const QVariantMap &schema);
+    QStringList fieldPaths() const;
+    int fieldCount() const;
+
+    QVariantMap convert(const QVariantMap &record, QVector<FieldError> *errors = nullptr);
+    QJsonObject convert(const QJsonObject &record, QVector<FieldError> *errors = nullptr);
+    QVariantList convert(const QVariantList &records, QVector<FieldError> *errors = nullptr);
+    QJsonArray convert(const QJsonArray &records, QVector<FieldError> *errors = nullptr);
+    QByteArray convertJson(const QByteArray &json, QVector<FieldError> *errors = nullptr);
+
+    int cacheSize() const;
+    void clearCache();
+
+private:
+    struct Field {
+        QString path;
+        QStringList keys;
+        QString unitText;
+        UdUnit unit;
+        // Converter of the last source unit string seen for this field
+        QString lastSource;
+        int lastConverter;
+    };
+
+    template <typename Traits>
+    void convertRecord(typename Traits::Map &record, int index, QVector<FieldError> *errors);
+    template <typename Traits>
+    UdError convertField(typename Traits::Map &map, Field &field, int depth);
+    UdUnitConverter *converter(Field &field, const QString &source, UdError *error);
+    UdUnit parse(const QString &text);
+
+    const UdUnitSystem *m_system;
+    UdError m_error;
+    QVector<Field> m_fields;
+    // Parsed units, by unit string
+    QHash<QString, UdUnit> m_units;
+    // Converters, by source and target unit strings
+    QHash<QPair<QString, QString>, int> m_converterIndexes;
+    QVector<UdUnitConverter> m_converters;
+};
+
+Q_DECLARE_TYPEINFO(UdRecordConverter::FieldError, Q_MOVABLE_TYPE);
+
+#endif // QUDRECORDCONVERTER_H
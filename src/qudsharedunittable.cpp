@@ -0,0 +1,230 @@
+#include "qudsharedunittable.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QSharedMemory>
+
+#include <cstring>
+
+/*!
+ * \class UdSharedUnitTable
+ * \ingroup index
+ * \preliminary
+ * \brief The UdSharedUnitTable class shares a read-only UdUnitTable between
+ * processes.
+ *
+ * A unit table is a single block of memory without any pointer, so one
+ * process can build it and publish it, either in a shared memory segment
+ * with create() or in a file with createFile(), and other processes attach
+ * to it, with attach() or attachFile(), by mapping it without any copy nor
+ * parsing. All the processes then share the same physical pages, whatever
+ * their number:
+ * \code
+ * // Parent process, before starting workers
+ * UdSharedUnitTable published;
+ * published.create("units", UdUnitTable::fromDatabase());
+ *
+ * // Worker processes
+ * UdSharedUnitTable shared;
+ * if (shared.attach("units"))
+ *     system = UdUnitSystem::loadTable(shared.table());
+ * \endcode
+ *
+ * The table returned by table() refers to the mapped memory: it and the
+ * unit-systems loaded from it must not be used after the shared table is
+ * detached or destroyed. A shared memory segment is destroyed when the last
+ * process detaches from it, so the creating process must keep its shared
+ * table as long as other processes may attach. A file stays until it is
+ * removed, and is replaced atomically by createFile(), processes attached to
+ * the previous file keep using it.
+ *
+ * Only the table is shared. \UU unit-systems can't be, so each process
+ * still loads its own with UdUnitSystem::loadTable(): it doesn't read any
+ * XML, but still creates every unit and maps every identifier in the heap of
+ * the process, as \UU needs them to parse. Sharing a table therefore saves
+ * the database parsing at startup, not the private memory of each unit-system.
+ * Name and symbol lookups then go to the shared table.
+ *
+ * Where workers are started with fork(), the unit-system itself can be
+ * shared: loaded by the parent process before forking, its pages are shared
+ * copy-on-write by all the workers, which neither attach nor load anything:
+ * \code
+ * // Parent process, before starting any thread using the unit-system
+ * UdUnitSystem *system = UdUnitSystem::loadDatabase();
+ * for (int i = 0; i < workerCount; ++i) {
+ *     if (fork() == 0)
+ *         return runWorker(system);
+ * }
+ * \endcode
+ *
+ * A page is only copied once a worker writes to it: adding units or
+ * prefixes, and caches filled on first use, such as the identifier index of
+ * unit-systems not loaded from a table or the cache of
+ * UdUnitSystem::canonicalForm(), copy the pages they modify.
+ *
+ * \sa UdUnitTable, UdUnitSystem::loadTable()
+ */
+
+/*!
+ * Constructs a detached shared table.
+ */
+UdSharedUnitTable::UdSharedUnitTable():
+    m_memory(nullptr), m_file(nullptr), m_mapped(nullptr)
+{
+
+}
+
+/*!
+ * Destroys the shared table, detaching from it.
+ */
+UdSharedUnitTable::~UdSharedUnitTable()
+{
+    detach();
+}
+
+/*!
+ * Copies \a table to a new shared memory segment identified by \a key, and
+ * attaches to it. Returns false if \a table is invalid, if a segment with
+ * this \a key already exists or if it can't be created.
+ */
+bool UdSharedUnitTable::create(const QString &key, const UdUnitTable &table)
+{
+    detach();
+    if (!table.isValid()) {
+        m_error = UdError(UdError::BadArgumentError);
+        return false;
+    }
+    m_memory = new QSharedMemory(key);
+    if (!m_memory->create(int(table.size()))) {
+        m_error = UdError(m_memory->error() == QSharedMemory::AlreadyExists
+                          ? UdError::ExistingIdentifierError : UdError::OperatingSystemError);
+        detach();
+        return false;
+    }
+    m_memory->lock();
+    std::memcpy(m_memory->data(), table.data(), size_t(table.size()));
+    m_memory->unlock();
+    return setImage(static_cast<const uchar *>(m_memory->constData()), table.size());
+}
+
+/*!
+ * Attaches, read-only, to the shared memory segment identified by \a key.
+ * Returns false if there's no such segment or if it doesn't hold a valid
+ * table.
+ */
+bool UdSharedUnitTable::attach(const QString &key)
+{
+    detach();
+    m_memory = new QSharedMemory(key);
+    if (!m_memory->attach(QSharedMemory::ReadOnly)) {
+        m_error = UdError(m_memory->error() == QSharedMemory::NotFound
+                          ? UdError::OpenArgumentError : UdError::OperatingSystemError);
+        detach();
+        return false;
+    }
+    return setImage(static_cast<const uchar *>(m_memory->constData()), m_memory->size());
+}
+
+/*!
+ * Writes \a table to the file \a pathname, replacing it atomically, and
+ * attaches to it. Returns false if \a table is invalid or if the file can't
+ * be written.
+ */
+bool UdSharedUnitTable::createFile(const QString &pathname, const UdUnitTable &table)
+{
+    detach();
+    if (!table.isValid()) {
+        m_error = UdError(UdError::BadArgumentError);
+        return false;
+    }
+    QSaveFile file(pathname);
+    if (!file.open(QIODevice::WriteOnly)
+            || file.write(table.data(), table.size()) != table.size()
+            || !file.commit()) {
+        m_error = UdError(UdError::OperatingSystemError);
+        return false;
+    }
+    return attachFile(pathname);
+}
+
+/*!
+ * Maps the file \a pathname, read-only and shared. Returns false if the
+ * file can't be mapped or if it doesn't hold a valid table.
+ */
+bool UdSharedUnitTable::attachFile(const QString &pathname)
+{
+    detach();
+    m_file = new QFile(pathname);
+    if (!m_file->open(QIODevice::ReadOnly)) {
+        m_error = UdError(UdError::OpenArgumentError);
+        detach();
+        return false;
+    }
+    const qint64 size = m_file->size();
+    m_mapped = size > 0 ? m_file->map(0, size) : nullptr;
+    if (m_mapped == nullptr) {
+        m_error = UdError(UdError::OperatingSystemError);
+        detach();
+        return false;
+    }
+    return setImage(m_mapped, size);
+}
+
+/*!
+ * Detaches from the shared memory segment or the file. The table returned
+ * by table() must not be used any more.
+ */
+void UdSharedUnitTable::detach()
+{
+    m_table = UdUnitTable();
+    if (m_mapped != nullptr)
+        m_file->unmap(m_mapped);
+    m_mapped = nullptr;
+    delete m_file;
+    m_file = nullptr;
+    delete m_memory;
+    m_memory = nullptr;
+}
+
+/*!
+ * Returns true if this shared table is attached to a valid table, false
+ * otherwise.
+ */
+bool UdSharedUnitTable::isAttached() const
+{
+    return m_table.isValid();
+}
+
+/*!
+ * Returns the table this shared table is attached to, which refers to the
+ * shared memory, or an invalid table if it isn't attached.
+ */
+UdUnitTable UdSharedUnitTable::table() const
+{
+    return m_table;
+}
+
+/*!
+ * Returns the error which made the last creation or attachment fail.
+ */
+UdError UdSharedUnitTable::error() const
+{
+    return m_error;
+}
+
+/*!
+ * \internal
+ * Uses the \a size bytes at \a data as table, detaching if they don't hold
+ * a valid one.
+ */
+bool UdSharedUnitTable::setImage(const uchar *data, qint64 size)
+{
+    m_table = UdUnitTable(reinterpret_cast<const char *>(data), size);
+    if (!m_table.isValid()) {
+        m_error = m_table.error();
+        detach();
+        return false;
+    }
+    m_error = UdError();
+    return true;
+}
@@ -0,0 +1,41 @@
+#ifndef QUDSHAREDUNITTABLE_H
+#define QUDSHAREDUNITTABLE_H
+
+#include "qudunit_global.h"
+#include "quderror.h"
+#include "qudunittable.h"
+
+#include <QString>
+
+class QFile;
+class QSharedMemory;
+
+class QUDUNITSHARED_EXPORT UdSharedUnitTable
+{
+public:
+    UdSharedUnitTable();
+    ~UdSharedUnitTable();
+
+    bool create(const QString &key, const UdUnitTable &table);
+    bool attach(const QString &key);
+    bool createFile(const QString &pathname, const UdUnitTable &table);
+    bool attachFile(const QString &pathname);
+    void detach();
+
+    bool isAttached() const;
+    UdUnitTable table() const;
+    UdError error() const;
+
+private:
+    Q_DISABLE_COPY(UdSharedUnitTable)
+
+    bool setImage(const uchar *data, qint64 size);
+
+    QSharedMemory *m_memory;
+    QFile *m_file;
+    uchar *m_mapped;
+    UdUnitTable m_table;
+    UdError m_error;
+};
+
+#endif // QUDSHAREDUNITTABLE_H
@@ -1,6 +1,249 @@
 #include "qudunit.h"
+#include "qudcompactunit.h"
+#include "qudidentifierindex_p.h"
+#include "qudinstrumentation_p.h"
+#include "qudunittable_p.h"
 
+#include <QDataStream>
 #include <QDebug>
+#include <QFutureInterface>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QReadLocker>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Maps the UTF-8 \a text to \a unit and, for primary identifiers, \a unit to
+// \a text, as loading an XML database does. Identifiers which are already
+// mapped are left as they are.
+ut_status mapIdentifier(const ut_unit *unit, const char *text, bool isSymbol, bool isPrimary)
+{
+    ut_status status = isSymbol ? ut_map_symbol_to_unit(text, UT_UTF8, unit)
+                                : ut_map_name_to_unit(text, UT_UTF8, unit);
+    if (status != UT_SUCCESS && status != UT_EXISTS)
+        return status;
+    if (!isPrimary)
+        return UT_SUCCESS;
+    bool isAscii = true;
+    for (const char *c = text; *c != '\0'; ++c)
+        isAscii = isAscii && uchar(*c) < 0x80;
+    const ut_encoding encodings[] = { UT_UTF8, UT_ASCII, UT_LATIN1 };
+    for (int i = 0; i < (isAscii ? 3 : 1); ++i) {
+        status = isSymbol ? ut_map_unit_to_symbol(unit, text, encodings[i])
+                          : ut_map_unit_to_name(unit, text, encodings[i]);
+        if (status != UT_SUCCESS && status != UT_EXISTS)
+            return status;
+    }
+    return UT_SUCCESS;
+}
+
+// Largest finite magnitude of the \a count \a values, 0 if there is none.
+// Branchless, so that it vectorizes.
+qreal largestMagnitude(const qreal *values, qint64 count)
+{
+    const qreal infinity = std::numeric_limits<qreal>::infinity();
+    qreal largest = 0.0;
+    for (qint64 i = 0; i < count; ++i) {
+        const qreal magnitude = std::fabs(values[i]);
+        largest = (magnitude > largest && magnitude < infinity) ? magnitude : largest;
+    }
+    return largest;
+}
+
+// Whether \a value is an integral power of 1000, as engineering notation
+// prefixes are
+bool isEngineeringPrefix(qreal value)
+{
+    const qreal exponent = std::round(std::log10(value));
+    return std::fmod(exponent, 3.0) == 0.0
+            && std::fabs(value / std::pow(10.0, exponent) - 1.0) < 1e-12;
+}
+
+// udunits2 parser keeps its state in global variables: units are parsed,
+// and databases loaded, by one thread at a time, whatever their unit-system
+Q_GLOBAL_STATIC(QMutex, s_parserMutex)
+
+// Errors are reported with UdError, there's no need for udunits2 to format
+// messages nobody reads. An error message handler installed by the
+// application is left untouched.
+void ignoreErrorMessages()
+{
+    static const bool ignored = [] {
+        const ut_error_message_handler previous = ut_set_error_message_handler(ut_ignore);
+        if (previous != ut_write_to_stderr) {
+            ut_set_error_message_handler(previous);
+            return false;
+        }
+        return true;
+    }();
+    Q_UNUSED(ignored);
+}
+
+// Null-terminated UTF-8 strings passed to udunits2, on the stack for
+// identifiers and unit strings of usual length.
+typedef QVarLengthArray<char, 256> Utf8Buffer;
+
+const char *terminated(const char *data, int size, Utf8Buffer &buffer)
+{
+    if (size < 0 || data == nullptr)
+        return data;
+    buffer.resize(size + 1);
+    std::memcpy(buffer.data(), data, size_t(size));
+    buffer[size] = '\0';
+    return buffer.constData();
+}
+
+const char *toUtf8(QLatin1String text, Utf8Buffer &buffer)
+{
+    buffer.resize(2 * text.size() + 1);
+    char *out = buffer.data();
+    for (int i = 0; i < text.size(); ++i) {
+        const uchar c = uchar(text.data()[i]);
+        if (c < 0x80) {
+            *out++ = char(c);
+        } else {
+            *out++ = char(0xc0 | (c >> 6));
+            *out++ = char(0x80 | (c & 0x3f));
+        }
+    }
+    *out = '\0';
+    return buffer.constData();
+}
+
+const char *toUtf8(const QChar *text, int size, Utf8Buffer &buffer)
+{
+    // A UTF-16 code unit never takes more than 3 bytes in UTF-8
+    buffer.resize(3 * size + 1);
+    char *out = buffer.data();
+    for (int i = 0; i < size; ++i) {
+        uint code = text[i].unicode();
+        if (code < 0x80) {
+            *out++ = char(code);
+        } else if (code < 0x800) {
+            *out++ = char(0xc0 | (code >> 6));
+            *out++ = char(0x80 | (code & 0x3f));
+        } else {
+            if (QChar::isHighSurrogate(code) && i + 1 < size && text[i + 1].isLowSurrogate()) {
+                code = QChar::surrogateToUcs4(ushort(code), text[++i].unicode());
+                *out++ = char(0xf0 | (code >> 18));
+                *out++ = char(0x80 | ((code >> 12) & 0x3f));
+            } else {
+                if (QChar::isSurrogate(code))
+                    code = QChar::ReplacementCharacter;
+                *out++ = char(0xe0 | (code >> 12));
+            }
+            *out++ = char(0x80 | ((code >> 6) & 0x3f));
+            *out++ = char(0x80 | (code & 0x3f));
+        }
+    }
+    *out = '\0';
+    return buffer.constData();
+}
+
+// Runs function(interface) on a thread pool, the returned future is finished
+// when the function returns. The function is not run if the future has been
+// canceled in the meantime.
+template <typename T, typename Function>
+class AsyncTask : public QRunnable
+{
+public:
+    explicit AsyncTask(const Function &function):
+        m_function(function)
+    {
+    }
+
+    QFuture<T> start(QThreadPool *pool)
+    {
+        if (pool == nullptr)
+            pool = QThreadPool::globalInstance();
+        m_interface.setThreadPool(pool);
+        m_interface.reportStarted();
+        const QFuture<T> future = m_interface.future();
+        pool->start(this);
+        return future;
+    }
+
+    void run() override
+    {
+        if (!m_interface.isCanceled())
+            m_function(m_interface);
+        m_interface.reportFinished();
+    }
+
+private:
+    QFutureInterface<T> m_interface;
+    Function m_function;
+};
+
+template <typename T, typename Function>
+QFuture<T> runAsync(QThreadPool *pool, const Function &function)
+{
+    return (new AsyncTask<T, Function>(function))->start(pool);
+}
+
+// Number of values converted between progress reports and cancellation checks
+const qint64 s_asyncBlockSize = 1 << 16;
+
+// 64-bit FNV-1a
+quint64 hashOf(const QByteArray &data)
+{
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    for (int i = 0; i < data.size(); ++i) {
+        hash ^= uchar(data.at(i));
+        hash *= Q_UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+// Number of unit strings UdUnitSystem::canonicalForm() caches, the cache is
+// cleared when full so that arbitrary input doesn't grow it without limit
+const int s_canonicalCacheSize = 4096;
+
+// Version of the binary records written by UdUnitSystem::writeUnit() and
+// the UdUnitConverter stream operators
+const quint8 s_streamVersion = 1;
+
+// Forms of the unit records
+enum UnitRecordForm {
+    NullUnitRecord = 0,
+    // Dimension vector, scale and offset (basic, product and galilean units)
+    CompactUnitRecord,
+    // Definition string (timestamp and logarithmic units)
+    DefinitionUnitRecord
+};
+
+// Size of the buffer definitions are formatted to, including the terminator
+const int s_definitionSize = 1024;
+
+// Reals are written as their IEEE 754 bit pattern, whatever the floating
+// point precision of the stream, so that they are read back exactly
+void writeReal(QDataStream &stream, qreal value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    stream << bits;
+}
+
+qreal readReal(QDataStream &stream)
+{
+    quint64 bits = 0;
+    stream >> bits;
+    qreal value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+}
 
 
 /*!
@@ -18,6 +261,7 @@
  * every accessible unit belongs to one and only one unit-system.
  * It is not possible to convert numeric values between units of different unit-systems.
  * Similarly, units belonging to different unit-systems always compare unequal.
+ * UdUnitTranslator translates units from a unit-system to another.
  *
  * \section1 XML databases
  *
@@ -67,7 +311,29 @@
  *
  * \note If you use loadDatabase(), then you shouldn't normally need to do this.
  *
+ * \section1 Thread-safety
+ *
+ * The const functions of a unit-system, lookups and parsing included, can be
+ * called by several threads at once, as long as no thread modifies the
+ * unit-system meanwhile, see UdConcurrentUnitSystem for that. The caches
+ * they fill are guarded by a read-write lock per unit-system. \UU parser is
+ * not reentrant: parsing units and loading databases are serialized by a
+ * process-wide mutex, whatever the unit-system. Converters take no lock.
+ *
+ * \UU error status is shared by all threads: the status of an operation run
+ * concurrently with others may be wrong, its result isn't.
+ */
+
+/*!
+ * \internal
+ * Units of a table loaded with loadTable(), by table index, for lookups which
+ * bypass \UU maps.
  */
+struct UdUnitSystem::TableIndex
+{
+    UdUnitTable table;
+    QVector<ut_unit *> units;
+};
 
 /*!
  * \enum UdUnitSystem::DatabaseOrigin
@@ -91,13 +357,15 @@
  */
 UdUnitSystem::UdUnitSystem()
 {
-    m_errorMessage = QString();
+    ignoreErrorMessages();
     ut_set_status(UT_SUCCESS);
     m_system = ut_new_system();
-    if (m_system == nullptr) {
-        m_error = ut_get_status();
-        //m_errorMessage = ...;
-    }
+    m_error = ut_get_status();
+    m_canonicalCache = nullptr;
+    m_fingerprint = 0;
+    m_tableIndex = nullptr;
+    m_identifierIndex = nullptr;
+    m_prefixes = nullptr;
 }
 
 
@@ -106,7 +374,8 @@ UdUnitSystem::UdUnitSystem()
  * Constructs a UdUnitSystem using \UU \a system internal represention.
  */
 UdUnitSystem::UdUnitSystem(ut_system *system, ut_status status):
-    m_system(system), m_error(status)
+    m_system(system), m_error(status), m_canonicalCache(nullptr), m_fingerprint(0),
+    m_tableIndex(nullptr), m_identifierIndex(nullptr), m_prefixes(nullptr)
 {
 
 }
@@ -116,6 +385,15 @@ UdUnitSystem::UdUnitSystem(ut_system *system, ut_status status):
  */
 UdUnitSystem::~UdUnitSystem()
 {
+    delete m_canonicalCache;
+    delete m_identifierIndex;
+    delete m_prefixes;
+    if (m_tableIndex != nullptr) {
+        for (ut_unit *unit: m_tableIndex->units)
+            ut_free(unit);
+        delete m_tableIndex;
+    }
+    UdCompactUnit::releaseUnits(m_system);
     ut_free_system(m_system);
 }
 
@@ -128,14 +406,170 @@ UdUnitSystem::~UdUnitSystem()
  */
 UdUnitSystem *UdUnitSystem::loadDatabase(const QString &pathname)
 {
+    QUD_INSTRUMENT_OPERATION(LoadDatabase);
+    ignoreErrorMessages();
     ut_set_status(UT_SUCCESS);
-    const char *path = nullptr;
-    if (!pathname.isEmpty())
-        path = pathname.toUtf8().constData();
-    ut_system *system = ut_read_xml(path);
+    const QByteArray path = pathname.toUtf8();
+    QMutexLocker locker(s_parserMutex());
+    ut_system *system = ut_read_xml(path.isEmpty() ? nullptr : path.constData());
     return new UdUnitSystem(system, ut_get_status());
 }
 
+/*!
+ * Loads the unit database specified by \a pathname, as loadDatabase() does,
+ * without blocking the calling thread: the database is loaded on \a pool, or
+ * on the global thread pool if \a pool is null.
+ *
+ * The returned future holds the loaded unit-system, which the caller takes
+ * ownership of. Loading can't be interrupted, canceling the future before
+ * loading starts prevents it, canceling it later deletes the loaded
+ * unit-system.
+ *
+ * \note \UU error status is shared by all threads, the status of other
+ * operations done while the database is being loaded may be wrong.
+ */
+QFuture<UdUnitSystem *> UdUnitSystem::loadDatabaseAsync(const QString &pathname, QThreadPool *pool)
+{
+    return runAsync<UdUnitSystem *>(pool, [pathname](QFutureInterface<UdUnitSystem *> &interface) {
+        UdUnitSystem *system = loadDatabase(pathname);
+        if (interface.isCanceled())
+            delete system;
+        else
+            interface.reportResult(system);
+    });
+}
+
+/*!
+ * Returns a unit-system made of the units, identifiers and prefixes of
+ * \a table, see UdUnitTable. No XML is read nor parsed, except the definition
+ * of the few units the table can't describe otherwise. Every unit is still
+ * created and every identifier mapped in \UU, which its parser needs.
+ *
+ * Names and symbols of the table are then looked up in \a table first, in
+ * constant time, and in \UU maps otherwise, eg. for units added with
+ * addUnit().
+ *
+ * If \a table refers to external memory, it must remain valid as long as
+ * the returned unit-system is used. An invalid unit-system is returned if
+ * \a table is invalid.
+ * \sa loadBuiltinDatabase(), UdUnitTable::fromDatabase()
+ */
+UdUnitSystem *UdUnitSystem::loadTable(const UdUnitTable &table)
+{
+    QUD_INSTRUMENT_OPERATION(LoadDatabase);
+    ignoreErrorMessages();
+    if (!table.isValid())
+        return new UdUnitSystem(nullptr, UT_BAD_ARG);
+    ut_set_status(UT_SUCCESS);
+    ut_system *system = ut_new_system();
+    if (system == nullptr)
+        return new UdUnitSystem(nullptr, ut_get_status());
+    QScopedPointer<UdUnitSystem> result(new UdUnitSystem(system, UT_SUCCESS));
+    result->m_tableIndex = new TableIndex;
+    result->m_tableIndex->table = table;
+    QVector<ut_unit *> &units = result->m_tableIndex->units;
+    units.fill(nullptr, table.unitCount());
+
+    const UdUnitTable::Header *header = table.header();
+    QVector<ut_unit *> bases(int(header->bases.count), nullptr);
+    ut_status status = UT_SUCCESS;
+    for (int i = 0; i < bases.size() && status == UT_SUCCESS; ++i) {
+        const UdUnitTable::Base &base = table.bases()[i];
+        bases[i] = (base.flags & UdUnitTable::DimensionlessFlag) ? ut_new_dimensionless_unit(system)
+                                                                 : ut_new_base_unit(system);
+        status = bases.at(i) == nullptr ? ut_get_status()
+                                        : mapIdentifier(bases.at(i), table.string(base.identifier),
+                                                        base.flags & UdUnitTable::SymbolFlag, true);
+    }
+    for (quint32 i = 0; i < header->prefixes.count && status == UT_SUCCESS; ++i) {
+        const UdUnitTable::Prefix &prefix = table.prefixes()[i];
+        const char *text = table.string(prefix.identifier);
+        status = (prefix.flags & UdUnitTable::SymbolFlag) ? ut_add_symbol_prefix(system, text, prefix.value)
+                                                          : ut_add_name_prefix(system, text, prefix.value);
+        if (status == UT_EXISTS)
+            status = UT_SUCCESS;
+    }
+
+    // Units with a definition may refer to any other unit, they are created
+    // and mapped once all the others are
+    for (int pass = 0; pass < 2 && status == UT_SUCCESS; ++pass) {
+        for (int i = 0; i < units.size() && status == UT_SUCCESS; ++i) {
+            const UdUnitTable::Unit &record = table.units()[i];
+            if ((record.definition != 0) != (pass == 1))
+                continue;
+            ut_unit *unit = nullptr;
+            if (record.definition != 0) {
+                QMutexLocker locker(s_parserMutex());
+                unit = ut_parse(system, table.string(record.definition), UT_ASCII);
+            } else {
+                for (quint32 j = 0; j < record.factorCount; ++j) {
+                    const UdUnitTable::Factor &factor = table.factors()[record.firstFactor + j];
+                    ut_unit *powered = ut_raise(bases.at(int(factor.base)), factor.power);
+                    if (unit != nullptr) {
+                        ut_unit *product = ut_multiply(unit, powered);
+                        ut_free(unit);
+                        ut_free(powered);
+                        powered = product;
+                    }
+                    unit = powered;
+                }
+                if (unit == nullptr)
+                    unit = ut_get_dimensionless_unit_one(system);
+                if (record.scale != 1.0) {
+                    ut_unit *scaled = ut_scale(record.scale, unit);
+                    ut_free(unit);
+                    unit = scaled;
+                }
+                if (record.offset != 0.0) {
+                    ut_unit *shifted = ut_offset(unit, record.offset);
+                    ut_free(unit);
+                    unit = shifted;
+                }
+            }
+            units[i] = unit;
+            if (unit == nullptr)
+                status = ut_get_status() != UT_SUCCESS ? ut_get_status() : UT_PARSE;
+        }
+        const UdUnitTable::Identifier *identifierSets[] = { table.names(), table.symbols() };
+        const quint32 identifierCounts[] = { header->names.count, header->symbols.count };
+        for (int set = 0; set < 2 && status == UT_SUCCESS; ++set) {
+            for (quint32 j = 0; j < identifierCounts[set] && status == UT_SUCCESS; ++j) {
+                const UdUnitTable::Identifier &identifier = identifierSets[set][j];
+                if ((table.units()[identifier.unit].definition != 0) != (pass == 1))
+                    continue;
+                status = mapIdentifier(units.at(int(identifier.unit)), table.string(identifier.text),
+                                       set == 1, identifier.flags & UdUnitTable::PrimaryFlag);
+            }
+        }
+    }
+
+    for (ut_unit *base: bases)
+        ut_free(base);
+    if (status != UT_SUCCESS) {
+        for (ut_unit *unit: units)
+            ut_free(unit);
+        delete result->m_tableIndex;
+        result->m_tableIndex = nullptr;
+    }
+    result->m_error = status;
+    return result.take();
+}
+
+/*!
+ * Returns the unit-system of the table compiled into the library, see
+ * UdUnitTable::builtin(), or the one of the default database loaded with
+ * loadDatabase() if the library has been configured without it.
+ * The builtin table is built from the database \UU uses by default when
+ * the library is built, the \e {UDUNITS2_XML_PATH} environment variable
+ * doesn't apply to it.
+ * \sa loadTable()
+ */
+UdUnitSystem *UdUnitSystem::loadBuiltinDatabase()
+{
+    const UdUnitTable table = UdUnitTable::builtin();
+    return table.isValid() ? loadTable(table) : loadDatabase();
+}
+
 /*!
  * Returns the UdUnit to which \a name maps from this unit-system or an invalid
  * UdUnit if no such unit exists ot if this unit-system is invalid.
@@ -144,11 +578,56 @@ UdUnitSystem *UdUnitSystem::loadDatabase(const QString &pathname)
  */
 UdUnit UdUnitSystem::unitByName(const QString &name) const
 {
-    ut_set_status(UT_SUCCESS);
-    ut_unit *unit = ut_get_unit_by_name(m_system, name.toLocal8Bit().constData());
-    int status = ut_get_status();
-    return UdUnit(unit, status);
+    Utf8Buffer buffer;
+    return findByName(toUtf8(name.constData(), name.size(), buffer));
+}
+
+/*!
+ * \overload
+ * \a name is encoded in UTF-8, and copied like by the \c{const char *}
+ * overload, as it may not be null-terminated. A name containing a null
+ * character is invalid.
+ */
+UdUnit UdUnitSystem::unitByName(const QByteArray &name) const
+{
+    if (name.contains('\0'))
+        return UdUnit(nullptr, UT_UNKNOWN);
+    Utf8Buffer buffer;
+    return findByName(terminated(name.constData(), name.size(), buffer));
+}
+
+/*!
+ * \overload
+ * \a name is encoded in UTF-8 and has \a size bytes. If \a size is negative,
+ * \a name must be null-terminated and is used as is. Otherwise \a name is
+ * copied, on the stack for names of usual length.
+ */
+UdUnit UdUnitSystem::unitByName(const char *name, int size) const
+{
+    Utf8Buffer buffer;
+    return findByName(terminated(name, size, buffer));
 }
+
+/*!
+ * \overload
+ */
+UdUnit UdUnitSystem::unitByName(QLatin1String name) const
+{
+    Utf8Buffer buffer;
+    return findByName(toUtf8(name, buffer));
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+/*!
+ * \overload
+ */
+UdUnit UdUnitSystem::unitByName(QStringView name) const
+{
+    Utf8Buffer buffer;
+    return findByName(toUtf8(name.data(), int(name.size()), buffer));
+}
+#endif
+
 /*!
  * Returns the UdUnit to which \a symbol maps from this unit-system or an invalid
  * UdUnit if no such unit exists or if this unit-system is invalid.
@@ -157,9 +636,129 @@ UdUnit UdUnitSystem::unitByName(const QString &name) const
  */
 UdUnit UdUnitSystem::unitBySymbol(const QString &symbol) const
 {
+    Utf8Buffer buffer;
+    return findBySymbol(toUtf8(symbol.constData(), symbol.size(), buffer));
+}
+
+/*!
+ * \overload
+ * \a symbol is encoded in UTF-8, and copied like by the \c{const char *}
+ * overload, as it may not be null-terminated. A symbol containing a null
+ * character is invalid.
+ */
+UdUnit UdUnitSystem::unitBySymbol(const QByteArray &symbol) const
+{
+    if (symbol.contains('\0'))
+        return UdUnit(nullptr, UT_UNKNOWN);
+    Utf8Buffer buffer;
+    return findBySymbol(terminated(symbol.constData(), symbol.size(), buffer));
+}
+
+/*!
+ * \overload
+ * \a symbol is encoded in UTF-8 and has \a size bytes. If \a size is negative,
+ * \a symbol must be null-terminated and is used as is. Otherwise \a symbol is
+ * copied, on the stack for symbols of usual length.
+ */
+UdUnit UdUnitSystem::unitBySymbol(const char *symbol, int size) const
+{
+    Utf8Buffer buffer;
+    return findBySymbol(terminated(symbol, size, buffer));
+}
+
+/*!
+ * \overload
+ */
+UdUnit UdUnitSystem::unitBySymbol(QLatin1String symbol) const
+{
+    Utf8Buffer buffer;
+    return findBySymbol(toUtf8(symbol, buffer));
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+/*!
+ * \overload
+ */
+UdUnit UdUnitSystem::unitBySymbol(QStringView symbol) const
+{
+    Utf8Buffer buffer;
+    return findBySymbol(toUtf8(symbol.data(), int(symbol.size()), buffer));
+}
+#endif
+
+/*!
+ * \internal
+ * Looks up the UTF-8, null-terminated \a name.
+ */
+UdUnit UdUnitSystem::findByName(const char *name) const
+{
+    QUD_INSTRUMENT_OPERATION(UnitByName);
+    if (m_tableIndex != nullptr) {
+        const int index = m_tableIndex->table.unitIndexByName(name);
+        if (index >= 0)
+            return UdUnit(ut_clone(m_tableIndex->units.at(index)), UT_SUCCESS);
+    }
+    if (name != nullptr) {
+        QReadLocker locker(&m_cacheLock);
+        const ut_unit *indexed = m_identifierIndex != nullptr ? m_identifierIndex->find(name, true)
+                                                              : nullptr;
+        if (indexed != nullptr) {
+            QUD_INSTRUMENT_COUNT(CacheHits, 1);
+            return UdUnit(ut_clone(indexed), UT_SUCCESS);
+        }
+    }
+    QUD_INSTRUMENT_COUNT(CacheMisses, 1);
+    ut_set_status(UT_SUCCESS);
+    ut_unit *unit = ut_get_unit_by_name(m_system, name);
+    int status = ut_get_status();
+    if (unit == nullptr && status == UT_SUCCESS)
+        status = UT_UNKNOWN;
+    if (unit != nullptr) {
+        QWriteLocker locker(&m_cacheLock);
+        // Another thread may have indexed it meanwhile
+        if (m_identifierIndex == nullptr || m_identifierIndex->find(name, true) == nullptr) {
+            const int index = indexUnit(unit);
+            m_identifierIndex->insert(name, true, index);
+        }
+    }
+    return UdUnit(unit, status);
+}
+
+/*!
+ * \internal
+ * Looks up the UTF-8, null-terminated \a symbol.
+ */
+UdUnit UdUnitSystem::findBySymbol(const char *symbol) const
+{
+    QUD_INSTRUMENT_OPERATION(UnitBySymbol);
+    if (m_tableIndex != nullptr) {
+        const int index = m_tableIndex->table.unitIndexBySymbol(symbol);
+        if (index >= 0)
+            return UdUnit(ut_clone(m_tableIndex->units.at(index)), UT_SUCCESS);
+    }
+    if (symbol != nullptr) {
+        QReadLocker locker(&m_cacheLock);
+        const ut_unit *indexed = m_identifierIndex != nullptr ? m_identifierIndex->find(symbol, false)
+                                                              : nullptr;
+        if (indexed != nullptr) {
+            QUD_INSTRUMENT_COUNT(CacheHits, 1);
+            return UdUnit(ut_clone(indexed), UT_SUCCESS);
+        }
+    }
+    QUD_INSTRUMENT_COUNT(CacheMisses, 1);
     ut_set_status(UT_SUCCESS);
-    ut_unit *unit = ut_get_unit_by_symbol(m_system, symbol.toUtf8().constData());
+    ut_unit *unit = ut_get_unit_by_symbol(m_system, symbol);
     int status = ut_get_status();
+    if (unit == nullptr && status == UT_SUCCESS)
+        status = UT_UNKNOWN;
+    if (unit != nullptr) {
+        QWriteLocker locker(&m_cacheLock);
+        // Another thread may have indexed it meanwhile
+        if (m_identifierIndex == nullptr || m_identifierIndex->find(symbol, false) == nullptr) {
+            const int index = indexUnit(unit);
+            m_identifierIndex->insert(symbol, false, index);
+        }
+    }
     return UdUnit(unit, status);
 }
 
@@ -170,6 +769,7 @@ UdUnit UdUnitSystem::unitBySymbol(const QString &symbol) const
  */
 UdUnit UdUnitSystem::dimensionLessUnitOne() const
 {
+    QUD_INSTRUMENT_OPERATION(DimensionlessUnitOne);
     ut_set_status(UT_SUCCESS);
     ut_unit *unit = ut_get_dimensionless_unit_one(m_system);
     int status = ut_get_status();
@@ -185,26 +785,443 @@ UdUnit UdUnitSystem::dimensionLessUnitOne() const
  */
 UdUnit UdUnitSystem::unitFromString(const QString &text) const
 {
+    Utf8Buffer buffer;
+    return parse(toUtf8(text.constData(), text.size(), buffer), UT_UTF8);
+}
+
+/*!
+ * \overload
+ * \a text is encoded in UTF-8, and copied like by the \c{const char *}
+ * overload, as it may not be null-terminated. A text containing a null
+ * character is invalid.
+ */
+UdUnit UdUnitSystem::unitFromString(const QByteArray &text) const
+{
+    if (text.contains('\0'))
+        return UdUnit(nullptr, UT_PARSE);
+    Utf8Buffer buffer;
+    return parse(terminated(text.constData(), text.size(), buffer), UT_UTF8);
+}
+
+/*!
+ * \overload
+ * \a text is encoded in UTF-8 and has \a size bytes. If \a size is negative,
+ * \a text must be null-terminated and is used as is. Otherwise \a text is
+ * copied, on the stack for texts of usual length.
+ */
+UdUnit UdUnitSystem::unitFromString(const char *text, int size) const
+{
+    Utf8Buffer buffer;
+    return parse(terminated(text, size, buffer), UT_UTF8);
+}
+
+/*!
+ * \overload
+ * \a text is parsed as Latin-1 by \UU, no transcoding is done.
+ */
+UdUnit UdUnitSystem::unitFromString(QLatin1String text) const
+{
+    Utf8Buffer buffer;
+    return parse(terminated(text.data(), text.size(), buffer), UT_LATIN1);
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+/*!
+ * \overload
+ */
+UdUnit UdUnitSystem::unitFromString(QStringView text) const
+{
+    Utf8Buffer buffer;
+    return parse(toUtf8(text.data(), int(text.size()), buffer), UT_UTF8);
+}
+#endif
+
+/*!
+ * Parses each of the \a texts, as unitFromString() does, without blocking the
+ * calling thread: parsing runs on \a pool, or on the global thread pool if
+ * \a pool is null.
+ *
+ * The unit parsed from a text is the result of the returned future at the
+ * index of the text, results are reported as soon as they are parsed, and
+ * progress is the number of texts parsed so far. Canceling the future stops
+ * parsing after the current text.
+ *
+ * This unit-system must outlive the returned future. \UU parser is not
+ * reentrant, so parsing still runs on one thread at a time, see
+ * \l {UdUnitSystem#Thread-safety}{Thread-safety}.
+ */
+QFuture<UdUnit> UdUnitSystem::parseAsync(const QStringList &texts, QThreadPool *pool) const
+{
+    const UdUnitSystem *system = this;
+    return runAsync<UdUnit>(pool, [system, texts](QFutureInterface<UdUnit> &interface) {
+        interface.setProgressRange(0, texts.size());
+        for (int i = 0; i < texts.size() && !interface.isCanceled(); ++i) {
+            interface.reportResult(system->unitFromString(texts.at(i)), i);
+            interface.setProgressValue(i + 1);
+        }
+    });
+}
+
+/*!
+ * \internal
+ * Parses the null-terminated \a text, using \a encoding.
+ */
+UdUnit UdUnitSystem::parse(const char *text, ut_encoding encoding) const
+{
+    QUD_INSTRUMENT_OPERATION(UnitFromString);
+    QMutexLocker locker(s_parserMutex());
     ut_set_status(UT_SUCCESS);
-    ut_unit *unit = ut_parse(m_system, text.toUtf8().constData(), UT_UTF8);
+    ut_unit *unit = ut_parse(m_system, text, encoding);
     int status = ut_get_status();
+    locker.unlock();
     return UdUnit(unit, status);
 }
 
 /*!
  * Returns true if this unit-system system is valid, false otherwise.
  */
-bool UdUnitSystem::isValid()
+bool UdUnitSystem::isValid() const
 {
     return m_system != nullptr;
 }
 
 /*!
- * TBD
+ * Returns the error that occurred while creating this unit-system, if any.
+ * \sa errorMessage()
+ */
+UdError UdUnitSystem::error() const
+{
+    return UdError::fromStatus(m_error);
+}
+
+/*!
+ * Returns a human readable description of error(), or an empty string if no
+ * error occurred.
  */
 QString UdUnitSystem::errorMessage() const
 {
-    return m_errorMessage;
+    return error().message();
+}
+
+/*!
+ * \internal
+ * Canonical form and key of a unit.
+ */
+struct UdUnitSystem::CanonicalUnit
+{
+    QString form;
+    quint64 key;
+};
+
+/*!
+ * Returns the canonical form of \a unit, a unit of this unit-system, or an
+ * empty string if \a unit is invalid.
+ *
+ * Units that are equal have the same canonical form, however they are spelled:
+ * "m/s", "m s-1", "meter/second" and "m.s^-1" all have the canonical form
+ * "m.s-1". This makes canonical forms suitable to group or deduplicate units
+ * with plain string comparisons or hashing, instead of comparing each pair of
+ * units.
+ *
+ * The canonical form is made of the scale factor, the base units sorted by
+ * identifier with their powers, and the offset, eg. "0.555555555555556 K @ 459.67"
+ * for degrees Fahrenheit. Numbers are written with 15 significant digits, so
+ * that units differing only by rounding errors share the same canonical form.
+ * Timestamp and logarithmic units, which cannot be expressed that way, are
+ * written in their definition form instead. Canonical forms can be parsed back
+ * with unitFromString().
+ *
+ * \sa canonicalKey()
+ */
+QString UdUnitSystem::canonicalForm(const UdUnit &unit) const
+{
+    return canonicalize(unit).form;
+}
+
+/*!
+ * \overload
+ * Returns the canonical form of the unit parsed from \a text, or an empty
+ * string if \a text can't be parsed. Canonical forms are cached by \a text,
+ * so each distinct unit string is usually parsed only once: texts which can't
+ * be parsed are not cached, the cache is cleared when units or prefixes are
+ * added, and when it holds 4096 texts.
+ */
+QString UdUnitSystem::canonicalForm(const QString &text) const
+{
+    return canonicalize(text).form;
+}
+
+/*!
+ * Returns a 64-bit hash of the canonical form of \a unit, or 0 if \a unit is
+ * invalid. Equal units have the same canonical key. Distinct units may have
+ * the same canonical key, but they are very unlikely to.
+ * \sa canonicalForm()
+ */
+quint64 UdUnitSystem::canonicalKey(const UdUnit &unit) const
+{
+    return canonicalize(unit).key;
+}
+
+/*!
+ * \overload
+ * Returns the canonical key of the unit parsed from \a text, or 0 if \a text
+ * can't be parsed. Canonical keys are cached by \a text.
+ */
+quint64 UdUnitSystem::canonicalKey(const QString &text) const
+{
+    return canonicalize(text).key;
+}
+
+/*!
+ * \internal
+ * Computes the canonical form and key of \a unit.
+ */
+UdUnitSystem::CanonicalUnit UdUnitSystem::canonicalize(const UdUnit &unit) const
+{
+    CanonicalUnit result = { QString(), 0 };
+    if (!unit.isValid())
+        return result;
+
+    const UdCompactUnit compact(unit);
+    if (compact.isValid()) {
+        QVector<QPair<QString, int> > bases;
+        bases.reserve(compact.baseUnitCount());
+        for (int i = 0; i < compact.baseUnitCount(); ++i)
+            bases.append(qMakePair(compact.baseUnitIdentifier(i), compact.basePower(i)));
+        std::sort(bases.begin(), bases.end());
+        QStringList powered;
+        for (const QPair<QString, int> &base: bases)
+            powered.append(base.second == 1 ? base.first
+                                            : base.first + QString::number(base.second));
+        if (compact.scale() != 1.0 || powered.isEmpty())
+            result.form = QString::number(compact.scale(), 'g', 15);
+        if (!powered.isEmpty()) {
+            if (!result.form.isEmpty())
+                result.form += QLatin1Char(' ');
+            result.form += powered.join(QLatin1Char('.'));
+        }
+        if (compact.offset() != 0.0)
+            result.form += QStringLiteral(" @ ") + QString::number(compact.offset(), 'g', 15);
+    } else {
+        static const int size = 256;
+        char buffer[size + 1];
+        const int length = ut_format(unit.m_unit, buffer, size, UT_ASCII | UT_DEFINITION);
+        if (length < 0 || length > size)
+            return result;
+        result.form = QString::fromLatin1(buffer, length);
+    }
+    result.key = hashOf(result.form.toUtf8());
+    return result;
+}
+
+/*!
+ * \internal
+ * Returns the cached canonical form and key of the unit parsed from \a text.
+ * Texts are parsed without holding the cache lock, two threads missing the
+ * same text both parse it. Texts which can't be parsed are not cached, they
+ * may parse once units or prefixes are added.
+ */
+UdUnitSystem::CanonicalUnit UdUnitSystem::canonicalize(const QString &text) const
+{
+    {
+        QReadLocker locker(&m_cacheLock);
+        if (m_canonicalCache != nullptr) {
+            QHash<QString, CanonicalUnit>::const_iterator cached = m_canonicalCache->constFind(text);
+            if (cached != m_canonicalCache->constEnd()) {
+                QUD_INSTRUMENT_COUNT(CacheHits, 1);
+                return cached.value();
+            }
+        }
+    }
+    QUD_INSTRUMENT_COUNT(CacheMisses, 1);
+    const CanonicalUnit canonical = canonicalize(unitFromString(text));
+    if (canonical.form.isEmpty())
+        return canonical;
+    QWriteLocker locker(&m_cacheLock);
+    if (m_canonicalCache == nullptr)
+        m_canonicalCache = new QHash<QString, CanonicalUnit>();
+    else if (m_canonicalCache->size() >= s_canonicalCacheSize)
+        m_canonicalCache->clear();
+    m_canonicalCache->insert(text, canonical);
+    return canonical;
+}
+
+/*!
+ * Returns a 64-bit fingerprint of this unit-system, computed from the
+ * definitions of the SI base units and of a few common derived units.
+ * Unit-systems loaded from the same database have the same fingerprint.
+ * \sa writeUnit()
+ */
+quint64 UdUnitSystem::fingerprint() const
+{
+    {
+        QReadLocker locker(&m_cacheLock);
+        if (m_fingerprint != 0)
+            return m_fingerprint;
+    }
+    static const char *const probes[] = {
+        "m", "kg", "s", "A", "K", "mol", "cd", "rad", "sr",
+        "N", "J", "W", "Pa", "V", "degC", "min", "h", "in", "lb"
+    };
+    QByteArray forms;
+    for (const char *symbol: probes) {
+        forms += canonicalForm(unitBySymbol(symbol)).toUtf8();
+        forms += '\n';
+    }
+    const quint64 fingerprint = hashOf(forms);
+    QWriteLocker locker(&m_cacheLock);
+    m_fingerprint = fingerprint;
+    return fingerprint;
+}
+
+/*!
+ * Writes \a unit, a unit of this unit-system, to \a stream in a compact
+ * binary form which readUnit() reads back.
+ *
+ * Basic, product and galilean units are written as their dimension vector,
+ * scale and offset, and other units as their definition, together with the
+ * fingerprint() of this unit-system. Writing a unit doesn't allocate any
+ * memory besides what \a stream needs, nor format it with \UU unless it is
+ * a timestamp or logarithmic unit.
+ *
+ * If \a unit belongs to another unit-system, nothing is written and the
+ * status of \a stream is set to QDataStream::WriteFailed.
+ */
+void UdUnitSystem::writeUnit(QDataStream &stream, const UdUnit &unit) const
+{
+    if (unit.isValid() && ut_get_system(unit.m_unit) != m_system) {
+        stream.setStatus(QDataStream::WriteFailed);
+        return;
+    }
+    stream << s_streamVersion << fingerprint();
+    if (!unit.isValid()) {
+        stream << quint8(NullUnitRecord);
+        return;
+    }
+
+    const UdCompactUnit compact(unit);
+    bool isCompact = compact.isValid();
+    for (int i = 0; isCompact && i < compact.m_count; ++i)
+        isCompact = std::strlen(compact.m_identifiers[i]) <= 0xff;
+    if (isCompact) {
+        stream << quint8(CompactUnitRecord);
+        writeReal(stream, compact.m_scale);
+        writeReal(stream, compact.m_offset);
+        stream << quint8(compact.m_count);
+        for (int i = 0; i < compact.m_count; ++i) {
+            const quint8 length = quint8(std::strlen(compact.m_identifiers[i]));
+            stream << quint8((compact.m_symbolMask >> i) & 1) << compact.m_powers[i] << length;
+            stream.writeRawData(compact.m_identifiers[i], length);
+        }
+        return;
+    }
+
+    char buffer[s_definitionSize];
+    const int length = ut_format(unit.m_unit, buffer, s_definitionSize, UT_ASCII | UT_DEFINITION);
+    if (length < 0 || length >= s_definitionSize) {
+        stream.setStatus(QDataStream::WriteFailed);
+        return;
+    }
+    stream << quint8(DefinitionUnitRecord) << quint16(length);
+    stream.writeRawData(buffer, length);
+}
+
+/*!
+ * Reads a unit written by writeUnit() from \a stream and returns the
+ * equivalent unit of this unit-system.
+ *
+ * The unit is rebuilt from the identifiers of its base units, which must be
+ * known to this unit-system. If the unit was written by a unit-system with a
+ * different fingerprint(), it is read but an invalid unit with a
+ * UdError::DifferentSystemError is returned. If the record is corrupted or
+ * of an unknown version, the status of \a stream is set to
+ * QDataStream::ReadCorruptData.
+ */
+UdUnit UdUnitSystem::readUnit(QDataStream &stream) const
+{
+    quint8 version = 0;
+    stream >> version;
+    if (stream.status() != QDataStream::Ok)
+        return UdUnit(nullptr, UT_PARSE);
+    if (version != s_streamVersion) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return UdUnit(nullptr, UT_PARSE);
+    }
+    quint64 fingerprint = 0;
+    quint8 form = NullUnitRecord;
+    stream >> fingerprint >> form;
+
+    if (form == NullUnitRecord)
+        return UdUnit();
+
+    if (form == DefinitionUnitRecord) {
+        quint16 length = 0;
+        stream >> length;
+        if (length >= s_definitionSize) {
+            stream.setStatus(QDataStream::ReadCorruptData);
+            return UdUnit(nullptr, UT_PARSE);
+        }
+        char buffer[s_definitionSize];
+        if (stream.readRawData(buffer, length) != length) {
+            stream.setStatus(QDataStream::ReadPastEnd);
+            return UdUnit(nullptr, UT_PARSE);
+        }
+        if (fingerprint != this->fingerprint())
+            return UdUnit(nullptr, UT_NOT_SAME_SYSTEM);
+        buffer[length] = '\0';
+        return parse(buffer, UT_ASCII);
+    }
+
+    if (form != CompactUnitRecord) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return UdUnit(nullptr, UT_PARSE);
+    }
+    const qreal scale = readReal(stream);
+    const qreal offset = readReal(stream);
+    quint8 count = 0;
+    stream >> count;
+    if (count > UdCompactUnit::MaximumBaseUnitCount) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return UdUnit(nullptr, UT_PARSE);
+    }
+    quint8 isSymbol[UdCompactUnit::MaximumBaseUnitCount];
+    qint16 powers[UdCompactUnit::MaximumBaseUnitCount];
+    char identifiers[UdCompactUnit::MaximumBaseUnitCount][0xff + 1];
+    for (int i = 0; i < count; ++i) {
+        quint8 length = 0;
+        stream >> isSymbol[i] >> powers[i] >> length;
+        if (stream.readRawData(identifiers[i], length) != length) {
+            stream.setStatus(QDataStream::ReadPastEnd);
+            return UdUnit(nullptr, UT_PARSE);
+        }
+        identifiers[i][length] = '\0';
+    }
+    if (stream.status() != QDataStream::Ok)
+        return UdUnit(nullptr, UT_PARSE);
+    if (fingerprint != this->fingerprint())
+        return UdUnit(nullptr, UT_NOT_SAME_SYSTEM);
+
+    // Identifiers owned by this unit-system replace the ones read
+    UdCompactUnit compact;
+    compact.m_system = m_system;
+    compact.m_valid = true;
+    for (int i = 0; i < count; ++i) {
+        ut_unit *base = isSymbol[i] ? ut_get_unit_by_symbol(m_system, identifiers[i])
+                                    : ut_get_unit_by_name(m_system, identifiers[i]);
+        if (base == nullptr)
+            return UdUnit(nullptr, UT_UNKNOWN);
+        const char *identifier = isSymbol[i] ? ut_get_symbol(base, UT_UTF8)
+                                             : ut_get_name(base, UT_UTF8);
+        const bool added = identifier != nullptr
+                && compact.addBase(identifier, isSymbol[i] != 0, ut_is_dimensionless(base) != 0,
+                                   powers[i]);
+        ut_free(base);
+        if (!added)
+            return UdUnit(nullptr, UT_UNKNOWN);
+    }
+    compact.m_scale = scale;
+    compact.m_offset = offset;
+    return compact.toUnit();
 }
 
 /*!
@@ -216,41 +1233,311 @@ QString UdUnitSystem::errorMessage() const
  */
 UdUnit UdUnitSystem::addBaseUnit(const QString &name, const QString &symbol)
 {
-    Q_UNUSED(name);
-    Q_UNUSED(symbol);
-    return UdUnit();
+    ut_set_status(UT_SUCCESS);
+    ut_unit *unit = ut_new_base_unit(m_system);
+    int status = ut_get_status();
+    if (unit != nullptr) {
+        status = registerUnit(unit, name, symbol);
+        if (status != UT_SUCCESS) {
+            ut_free(unit);
+            unit = nullptr;
+        }
+    }
+    return UdUnit(unit, status);
+}
+
+/*!
+ * Creates and adds a new dimensionless-unit to this unit-system.
+ * This function returns the new unit.
+ * If \a name is not empty then this unit can then be retreived using
+ * unitByName(), similary if \a symbol is not empty then this unit can then be
+ * retreived using unitBySymbol().
+ */
+UdUnit UdUnitSystem::addDimensionlessUnit(const QString &name, const QString &symbol)
+{
+    ut_set_status(UT_SUCCESS);
+    ut_unit *unit = ut_new_dimensionless_unit(m_system);
+    int status = ut_get_status();
+    if (unit != nullptr) {
+        status = registerUnit(unit, name, symbol);
+        if (status != UT_SUCCESS) {
+            ut_free(unit);
+            unit = nullptr;
+        }
+    }
+    return UdUnit(unit, status);
+}
+
+/*!
+ * Adds a new unit to this unit-system.
+ * This function returns true if \a unit, which must belong to this unit-system,
+ * could be mapped to \a name and \a symbol, false otherwise.
+ * If \a name is not empty then this unit can then be retreived using
+ * unitByName(), similary if \a symbol is not empty then this unit can then be
+ * retreived using unitBySymbol().
+ * If \a unit already has a name or a symbol, it keeps being formatted with it.
+ */
+bool UdUnitSystem::addUnit(const UdUnit &unit, const QString &name, const QString &symbol)
+{
+    return registerUnit(unit.m_unit, name, symbol) == UT_SUCCESS;
+}
+
+/*!
+ * Adds a prefix with the given \a name and \a symbol standing for \a value,
+ * eg. "kilo", "k" and 1000.0.
+ * This function returns true on success, false otherwise.
+ */
+bool UdUnitSystem::addPrefix(const QString &name, const QString &symbol, qreal value)
+{
+    return registerPrefix(name, symbol, value) == UT_SUCCESS;
+}
+
+/*!
+ * \internal
+ * Maps \a unit to and from \a name and \a symbol, returns the \UU status.
+ */
+int UdUnitSystem::registerUnit(const ut_unit *unit, const QString &name, const QString &symbol)
+{
+    if (unit == nullptr || ut_get_system(unit) != m_system)
+        return UT_BAD_ARG;
+    if (!name.isEmpty()) {
+        const QByteArray utf8 = name.toUtf8();
+        ut_status status = ut_map_name_to_unit(utf8.constData(), UT_UTF8, unit);
+        if (status != UT_SUCCESS)
+            return status;
+        status = ut_map_unit_to_name(unit, utf8.constData(), UT_UTF8);
+        if (status != UT_SUCCESS && status != UT_EXISTS)
+            return status;
+    }
+    if (!symbol.isEmpty()) {
+        const QByteArray utf8 = symbol.toUtf8();
+        ut_status status = ut_map_symbol_to_unit(utf8.constData(), UT_UTF8, unit);
+        if (status != UT_SUCCESS)
+            return status;
+        status = ut_map_unit_to_symbol(unit, utf8.constData(), UT_UTF8);
+        if (status != UT_SUCCESS && status != UT_EXISTS)
+            return status;
+    }
+    if (!name.isEmpty() || !symbol.isEmpty()) {
+        QWriteLocker locker(&m_cacheLock);
+        const int index = indexUnit(unit);
+        if (!name.isEmpty())
+            m_identifierIndex->insert(name.toUtf8().constData(), true, index);
+        if (!symbol.isEmpty())
+            m_identifierIndex->insert(symbol.toUtf8().constData(), false, index);
+        // Unit strings may now parse to another unit
+        if (m_canonicalCache != nullptr)
+            m_canonicalCache->clear();
+        m_fingerprint = 0;
+    }
+    return UT_SUCCESS;
+}
+
+/*!
+ * \internal
+ * Adds a copy of \a unit to the identifier index, creating it if needed, and
+ * returns its index there. Aliases share a single copy: if the name or the
+ * symbol \UU maps \a unit to is already indexed to an equal unit, its index
+ * is returned instead.
+ *
+ * \UU maps identifiers with binary trees, whose lookups and insertions slow
+ * down as unit-systems grow. The identifier index is a flat hash table in
+ * front of them, holding the registered identifiers and the ones already
+ * looked up, so that lookups cost the same with a thousand or a million
+ * identifiers.
+ *
+ * The cache lock must be held for writing.
+ */
+int UdUnitSystem::indexUnit(const ut_unit *unit) const
+{
+    if (m_identifierIndex == nullptr)
+        m_identifierIndex = new UdIdentifierIndex;
+    const char *name = ut_get_name(unit, UT_UTF8);
+    int index = name != nullptr ? m_identifierIndex->indexOf(name, true) : -1;
+    if (index < 0) {
+        const char *symbol = ut_get_symbol(unit, UT_UTF8);
+        index = symbol != nullptr ? m_identifierIndex->indexOf(symbol, false) : -1;
+    }
+    if (index >= 0 && ut_compare(m_identifierIndex->unit(index), unit) == 0)
+        return index;
+    return m_identifierIndex->addUnit(ut_clone(unit));
+}
+
+/*!
+ * \internal
+ * Adds the prefix \a name and \a symbol for \a value, returns the \UU status.
+ */
+int UdUnitSystem::registerPrefix(const QString &name, const QString &symbol, qreal value)
+{
+    if (m_system == nullptr || (name.isEmpty() && symbol.isEmpty()))
+        return UT_BAD_ARG;
+    if (!name.isEmpty()) {
+        const ut_status status = ut_add_name_prefix(m_system, name.toUtf8().constData(), value);
+        if (status != UT_SUCCESS)
+            return status;
+    }
+    if (!symbol.isEmpty()) {
+        const ut_status status = ut_add_symbol_prefix(m_system, symbol.toUtf8().constData(), value);
+        if (status != UT_SUCCESS)
+            return status;
+    }
+    QWriteLocker locker(&m_cacheLock);
+    delete m_prefixes;
+    m_prefixes = nullptr;
+    if (m_canonicalCache != nullptr)
+        m_canonicalCache->clear();
+    m_fingerprint = 0;
+    return UT_SUCCESS;
+}
+
+/*!
+ * Returns the SI prefixes this unit-system defines, from yocto to yotta, with
+ * their standard value. Prefixes added with other values, or which are not
+ * SI prefixes, are not returned.
+ *
+ * The prefixes are found by parsing symbols of an SI base unit with each
+ * prefix, on the first call only: the prefix table is then cached, until a
+ * prefix is added. Unit-systems without any SI base unit have no prefixes.
+ * \sa autoPrefix()
+ */
+QVector<UdUnitPrefix> UdUnitSystem::prefixes() const
+{
+    {
+        QReadLocker locker(&m_cacheLock);
+        if (m_prefixes != nullptr)
+            return *m_prefixes;
+    }
+    if (m_system == nullptr)
+        return QVector<UdUnitPrefix>();
+
+    // Prefixes are probed with an SI base unit
+    static const char *const probes[] = { "m", "s", "g", "A", "K", "mol", "cd" };
+    ut_unit *probe = nullptr;
+    const char *probeSymbol = nullptr;
+    for (const char *symbol: probes) {
+        probe = ut_get_unit_by_symbol(m_system, symbol);
+        probeSymbol = symbol;
+        if (probe != nullptr)
+            break;
+    }
+    // Not cached, prefixes can't be found until there's such a unit
+    if (probe == nullptr)
+        return QVector<UdUnitPrefix>();
+    QVector<UdUnitPrefix> found;
+
+    static const struct {
+        const char *name;
+        const char *symbols[2];
+        qreal value;
+    } siPrefixes[] = {
+        { "yocto", { "y", nullptr }, 1e-24 },
+        { "zepto", { "z", nullptr }, 1e-21 },
+        { "atto",  { "a", nullptr }, 1e-18 },
+        { "femto", { "f", nullptr }, 1e-15 },
+        { "pico",  { "p", nullptr }, 1e-12 },
+        { "nano",  { "n", nullptr }, 1e-9 },
+        { "micro", { "\xc2\xb5", "u" }, 1e-6 },
+        { "milli", { "m", nullptr }, 1e-3 },
+        { "centi", { "c", nullptr }, 1e-2 },
+        { "deci",  { "d", nullptr }, 1e-1 },
+        { "deca",  { "da", nullptr }, 1e1 },
+        { "hecto", { "h", nullptr }, 1e2 },
+        { "kilo",  { "k", nullptr }, 1e3 },
+        { "mega",  { "M", nullptr }, 1e6 },
+        { "giga",  { "G", nullptr }, 1e9 },
+        { "tera",  { "T", nullptr }, 1e12 },
+        { "peta",  { "P", nullptr }, 1e15 },
+        { "exa",   { "E", nullptr }, 1e18 },
+        { "zetta", { "Z", nullptr }, 1e21 },
+        { "yotta", { "Y", nullptr }, 1e24 }
+    };
+    for (const auto &prefix: siPrefixes) {
+        ut_unit *expected = ut_scale(prefix.value, probe);
+        for (const char *symbol: prefix.symbols) {
+            if (symbol == nullptr)
+                break;
+            const QByteArray prefixed = QByteArray(symbol) + probeSymbol;
+            QMutexLocker locker(s_parserMutex());
+            ut_unit *unit = ut_parse(m_system, prefixed.constData(), UT_UTF8);
+            locker.unlock();
+            const bool isDefined = unit != nullptr && ut_compare(unit, expected) == 0;
+            ut_free(unit);
+            if (isDefined) {
+                found.append(UdUnitPrefix(QString::fromLatin1(prefix.name),
+                                          QString::fromUtf8(symbol), prefix.value));
+                break;
+            }
+        }
+        ut_free(expected);
+    }
+    ut_free(probe);
+
+    QWriteLocker locker(&m_cacheLock);
+    if (m_prefixes == nullptr)
+        m_prefixes = new QVector<UdUnitPrefix>(found);
+    return *m_prefixes;
 }
 
 /*!
- * Creates and adds a new dimensionless-unit to this unit-system.
- * This function returns the new unit.
- * If \a name is not empty then this unit can then be retreived using
- * unitByName(), similary if \a symbol is not empty then this unit can then be
- * retreived using unitBySymbol().
+ * Returns a converter from \a unit to \a unit prefixed with the SI prefix
+ * giving the most readable values for the \a count \a values, in
+ * engineering notation: the largest magnitude of the values, once
+ * converted, lies in [1, 1000) when possible. The prefixed unit is the
+ * converter's toUnit(), and its prefix is stored in \a prefix if it isn't
+ * null. The prefixed unit is named and formatted with the prefix, eg. "kA"
+ * rather than "1000 A", when \a unit has a name or a symbol and \UU has
+ * none for the prefixed unit. No prefix is chosen, and the converter is an identity, when there
+ * are no finite values other than 0.
+ *
+ * Values are scanned once, for their largest finite magnitude; NaN values
+ * and infinities are ignored. \a unit should not already have a prefix.
+ * \sa prefixes()
  */
-UdUnit UdUnitSystem::addDimensionlessUnit(const QString &name, const QString &symbol)
+UdUnitConverter UdUnitSystem::autoPrefix(const UdUnit &unit, const qreal *values, qint64 count,
+                                         UdUnitPrefix *prefix) const
 {
-    Q_UNUSED(name);
-    Q_UNUSED(symbol);
-    return UdUnit();
+    return autoPrefix(unit, 0.0, largestMagnitude(values, count), prefix);
 }
 
 /*!
- * Adds a new unit to this unit-system.
- * This function returns XXX.
- * If \a name is not empty then this unit can then be retreived using
- * unitByName(), similary if \a symbol is not empty then this unit can then be
- * retreived using unitBySymbol().
+ * \overload
+ * Chooses the prefix for values ranging from \a minimum to \a maximum.
  */
-bool UdUnitSystem::addUnit(const UdUnit &unit, const QString &name, const QString &symbol)
+UdUnitConverter UdUnitSystem::autoPrefix(const UdUnit &unit, qreal minimum, qreal maximum,
+                                         UdUnitPrefix *prefix) const
 {
-    Q_UNUSED(unit);
-    Q_UNUSED(name);
-    Q_UNUSED(symbol);
-    return false;
+    const qreal bounds[] = { minimum, maximum };
+    const qreal magnitude = largestMagnitude(bounds, 2);
+    UdUnitPrefix best;
+    if (magnitude > 0.0 && unit.isValid()) {
+        UdUnitPrefix smallest;
+        bool found = magnitude >= 1.0;
+        for (const UdUnitPrefix &candidate: prefixes()) {
+            if (!isEngineeringPrefix(candidate.value()))
+                continue;
+            if (candidate.value() <= magnitude && (!found || candidate.value() > best.value())) {
+                best = candidate;
+                found = true;
+            }
+            if (candidate.value() < smallest.value())
+                smallest = candidate;
+        }
+        if (!found)
+            best = smallest;
+    }
+    if (prefix != nullptr)
+        *prefix = best;
+    if (best.isNull())
+        return UdUnitConverter(unit, unit);
+    // udunits2 formats the prefixed unit with its scale factor otherwise
+    UdUnit prefixed = unit.scaledBy(best.value());
+    if (prefixed.symbol().isEmpty() && !unit.symbol().isEmpty())
+        prefixed.m_prefixedSymbol = best.symbol() + unit.symbol();
+    if (prefixed.name().isEmpty() && !unit.name().isEmpty())
+        prefixed.m_prefixedName = best.name() + unit.name();
+    return UdUnitConverter(unit, prefixed);
 }
 
-
 /*!
  * \internal
  */
@@ -347,6 +1634,9 @@ UdUnit::UdUnit(ut_unit *unit, int status):
     m_unit(unit), m_errorStatus(status),
     m_type(NullUnit)
 {
+    if (m_unit == nullptr)
+        return;
+    QUD_INSTRUMENT_COUNT(UnitAllocations, 1);
     ut_accept_visitor(m_unit, &m_visitor, (void *)(this));
 }
 
@@ -354,7 +1644,7 @@ UdUnit::UdUnit(ut_unit *unit, int status):
  * Constructs an invalid unit.
  */
 UdUnit::UdUnit():
-    m_unit(nullptr),
+    m_unit(nullptr), m_errorStatus(UT_SUCCESS),
     m_type(NullUnit)
 {
 
@@ -365,9 +1655,16 @@ UdUnit::UdUnit():
  */
 UdUnit::UdUnit(const UdUnit &other):
     m_errorStatus(other.m_errorStatus),
-    m_type(NullUnit)
+    m_type(other.m_type),
+    m_prefixedName(other.m_prefixedName),
+    m_prefixedSymbol(other.m_prefixedSymbol)
 {
-    m_unit = ut_clone(other.m_unit);
+    QUD_INSTRUMENT_OPERATION(UnitCopy);
+    m_unit = nullptr;
+    if (other.m_unit != nullptr) {
+        m_unit = ut_clone(other.m_unit);
+        QUD_INSTRUMENT_COUNT(UnitAllocations, 1);
+    }
 }
 
 /*!
@@ -378,6 +1675,27 @@ UdUnit::~UdUnit()
     ut_free(m_unit);
 }
 
+/*!
+ * Assigns \a other to this unit and returns a reference to this unit.
+ */
+UdUnit &UdUnit::operator =(const UdUnit &other)
+{
+    QUD_INSTRUMENT_OPERATION(UnitCopy);
+    if (this == &other)
+        return *this;
+    ut_free(m_unit);
+    m_unit = nullptr;
+    if (other.m_unit != nullptr) {
+        m_unit = ut_clone(other.m_unit);
+        QUD_INSTRUMENT_COUNT(UnitAllocations, 1);
+    }
+    m_errorStatus = other.m_errorStatus;
+    m_type = other.m_type;
+    m_prefixedName = other.m_prefixedName;
+    m_prefixedSymbol = other.m_prefixedSymbol;
+    return *this;
+}
+
 /*!
  * Returns true if this unit is valid, false otherwise.
  */
@@ -386,6 +1704,16 @@ bool UdUnit::isValid() const
     return m_unit != nullptr;
 }
 
+/*!
+ * Returns the error that occurred while creating this unit, if any.
+ * An invalid unit which is not the result of an error, such as a default
+ * constructed one, has no error.
+ */
+UdError UdUnit::error() const
+{
+    return UdError::fromStatus(m_errorStatus);
+}
+
 /*!
  * Returns the unit-system this unit belongs to or an invalid unit-system if this
  * unit doesn't belong to any unit-system or if this unit is not valid (FIXME).
@@ -411,6 +1739,10 @@ UdUnit::UnitType UdUnit::type() const
  */
 QString UdUnit::name() const
 {
+    if (m_unit == nullptr)
+        return QString();
+    if (!m_prefixedName.isEmpty())
+        return m_prefixedName;
     return QString(ut_get_name(m_unit, UT_UTF8));
 }
 
@@ -420,6 +1752,10 @@ QString UdUnit::name() const
  */
 QString UdUnit::symbol() const
 {
+    if (m_unit == nullptr)
+        return QString();
+    if (!m_prefixedSymbol.isEmpty())
+        return m_prefixedSymbol;
     return QString(ut_get_symbol(m_unit, UT_UTF8));
 }
 
@@ -429,6 +1765,14 @@ QString UdUnit::symbol() const
  */
 QString UdUnit::format(FormatForm form, FormatOption option) const
 {
+    QUD_INSTRUMENT_OPERATION(UnitFormat);
+    if (m_unit == nullptr)
+        return QString();
+    if (form == ShortForm) {
+        const QString &prefixed = option == UseUnitName ? m_prefixedName : m_prefixedSymbol;
+        if (!prefixed.isEmpty())
+            return prefixed;
+    }
     static const int size = 256;
     char buffer[size + 1];
     int flags = UT_UTF8;
@@ -465,6 +1809,7 @@ bool UdUnit::isDimensionless() const
  */
 UdUnit UdUnit::scaledBy(qreal factor) const
 {
+    QUD_INSTRUMENT_OPERATION(UnitArithmetic);
     ut_set_status(UT_SUCCESS);
     ut_unit *unit = ut_scale(factor, m_unit);
     int status = ut_get_status();
@@ -481,6 +1826,7 @@ UdUnit UdUnit::scaledBy(qreal factor) const
  */
 UdUnit UdUnit::offsetBy(qreal offset) const
 {
+    QUD_INSTRUMENT_OPERATION(UnitArithmetic);
     ut_set_status(UT_SUCCESS);
     ut_unit *unit = ut_offset(m_unit, offset);
     int status = ut_get_status();
@@ -492,6 +1838,7 @@ UdUnit UdUnit::offsetBy(qreal offset) const
  */
 UdUnit UdUnit::offsetByTime(qreal origin) const
 {
+    QUD_INSTRUMENT_OPERATION(UnitArithmetic);
     ut_set_status(UT_SUCCESS);
     ut_unit *unit = ut_offset_by_time(m_unit, origin);
     int status = ut_get_status();
@@ -503,6 +1850,7 @@ UdUnit UdUnit::offsetByTime(qreal origin) const
  */
 UdUnit UdUnit::inverted() const
 {
+    QUD_INSTRUMENT_OPERATION(UnitArithmetic);
     ut_set_status(UT_SUCCESS);
     ut_unit *unit = ut_invert(m_unit);
     int status = ut_get_status();
@@ -514,6 +1862,7 @@ UdUnit UdUnit::inverted() const
  */
 UdUnit UdUnit::raisedBy(int power) const
 {
+    QUD_INSTRUMENT_OPERATION(UnitArithmetic);
     ut_set_status(UT_SUCCESS);
     ut_unit *unit = ut_raise(m_unit, power);
     int status = ut_get_status();
@@ -525,6 +1874,7 @@ UdUnit UdUnit::raisedBy(int power) const
  */
 UdUnit UdUnit::rootedBy(int root) const
 {
+    QUD_INSTRUMENT_OPERATION(UnitArithmetic);
     ut_set_status(UT_SUCCESS);
     ut_unit *unit = ut_root(m_unit, root);
     int status = ut_get_status();
@@ -542,6 +1892,7 @@ UdUnit UdUnit::rootedBy(int root) const
  */
 UdUnit UdUnit::toLogarithmic(qreal base) const
 {
+    QUD_INSTRUMENT_OPERATION(UnitArithmetic);
     ut_set_status(UT_SUCCESS);
     ut_unit *unit = ut_log(base, m_unit);
     int status = ut_get_status();
@@ -601,6 +1952,7 @@ UdUnit operator *(qreal lhs, const UdUnit &rhs)
  */
 UdUnit operator *(const UdUnit &lhs, const UdUnit &rhs)
 {
+    QUD_INSTRUMENT_OPERATION(UnitArithmetic);
     ut_set_status(UT_SUCCESS);
     ut_unit *unit = ut_multiply(lhs.m_unit, rhs.m_unit);
     int status = ut_get_status();
@@ -628,6 +1980,7 @@ UdUnit operator /(qreal lhs, const UdUnit &rhs)
  */
 UdUnit operator /(const UdUnit &lhs, const UdUnit &rhs)
 {
+    QUD_INSTRUMENT_OPERATION(UnitArithmetic);
     ut_set_status(UT_SUCCESS);
     ut_unit *unit = ut_divide(lhs.m_unit, rhs.m_unit);
     int status = ut_get_status();
@@ -639,6 +1992,7 @@ UdUnit operator /(const UdUnit &lhs, const UdUnit &rhs)
  */
 bool operator ==(const UdUnit &lhs, const UdUnit &rhs)
 {
+    QUD_INSTRUMENT_OPERATION(UnitCompare);
     return ut_compare(lhs.m_unit, rhs.m_unit) == 0;
 }
 
@@ -656,11 +2010,51 @@ bool operator ==(const UdUnit &lhs, const UdUnit &rhs)
  * Constructs a converter from \a from unit to \a to unit.
  */
 UdUnitConverter::UdUnitConverter(const UdUnit &from, const UdUnit &to):
-    m_from(from), m_to(to), m_converter(nullptr)
+    m_from(from), m_to(to), m_error(UT_SUCCESS),
+    m_form(NullForm), m_factor(1.0), m_rate(1.0), m_offset(0.0),
+    m_precision(DefaultPrecision), m_factorLow(0.0), m_offsetLow(0.0)
 {
+    QUD_INSTRUMENT_OPERATION(ConverterCreate);
+    if (m_from.m_unit == nullptr || m_to.m_unit == nullptr) {
+        m_error = UT_BAD_ARG;
+        return;
+    }
     ut_set_status(UT_SUCCESS);
-    m_converter = ut_get_converter(m_from.m_unit, m_to.m_unit);
-    //m_status = ut_get_status();
+    cv_converter *converter = ut_get_converter(m_from.m_unit, m_to.m_unit);
+    m_error = ut_get_status();
+    if (converter != nullptr) {
+        m_converter = QSharedPointer<cv_converter>(converter, cv_free);
+        QUD_INSTRUMENT_COUNT(ConverterAllocations, 1);
+    }
+    compile();
+}
+
+/*!
+ * \internal
+ * Constructs a converter from \a from unit to \a to unit using an already
+ * compiled conversion, no \UU converter is created.
+ */
+UdUnitConverter::UdUnitConverter(const UdUnit &from, const UdUnit &to, Form form,
+                                 qreal factor, qreal rate, qreal offset):
+    m_from(from), m_to(to),
+    m_error(form == NullForm ? UT_MEANINGLESS : UT_SUCCESS),
+    m_form(form), m_factor(factor), m_rate(rate), m_offset(offset),
+    m_precision(DefaultPrecision), m_factorLow(0.0), m_offsetLow(0.0)
+{
+
+}
+
+/*!
+ * Constructs a copy of \a other. The copy shares the \UU converter of
+ * \a other, if any, no converter is created.
+ */
+UdUnitConverter::UdUnitConverter(const UdUnitConverter &other):
+    m_from(other.m_from), m_to(other.m_to), m_converter(other.m_converter),
+    m_error(other.m_error), m_form(other.m_form), m_factor(other.m_factor), m_rate(other.m_rate),
+    m_offset(other.m_offset), m_precision(other.m_precision), m_factorLow(other.m_factorLow),
+    m_offsetLow(other.m_offsetLow)
+{
+    QUD_INSTRUMENT_OPERATION(ConverterCopy);
 }
 
 /*!
@@ -668,7 +2062,44 @@ UdUnitConverter::UdUnitConverter(const UdUnit &from, const UdUnit &to):
  */
 UdUnitConverter::~UdUnitConverter()
 {
-    cv_free(m_converter);
+}
+
+/*!
+ * Assigns \a other to this converter and returns a reference to this converter.
+ */
+UdUnitConverter &UdUnitConverter::operator =(const UdUnitConverter &other)
+{
+    QUD_INSTRUMENT_OPERATION(ConverterCopy);
+    if (this == &other)
+        return *this;
+    m_from = other.m_from;
+    m_to = other.m_to;
+    m_converter = other.m_converter;
+    m_error = other.m_error;
+    m_form = other.m_form;
+    m_factor = other.m_factor;
+    m_rate = other.m_rate;
+    m_offset = other.m_offset;
+    m_precision = other.m_precision;
+    m_factorLow = other.m_factorLow;
+    m_offsetLow = other.m_offsetLow;
+    return *this;
+}
+
+/*!
+ * Returns the unit this converter converts from.
+ */
+UdUnit UdUnitConverter::fromUnit() const
+{
+    return m_from;
+}
+
+/*!
+ * Returns the unit this converter converts to.
+ */
+UdUnit UdUnitConverter::toUnit() const
+{
+    return m_to;
 }
 
 /*!
@@ -677,7 +2108,110 @@ UdUnitConverter::~UdUnitConverter()
  */
 bool UdUnitConverter::isValid() const
 {
-    return m_converter != nullptr;
+    return m_form != NullForm;
+}
+
+/*!
+ * Returns the error that occurred while creating this converter, if any.
+ * For example, converting between units of different dimensions gives a
+ * UdError::MeaninglessError.
+ */
+UdError UdUnitConverter::error() const
+{
+    return UdError::fromStatus(m_error);
+}
+
+/*!
+ * \enum UdUnitConverter::Precision
+ * This enum type specifies how values are computed, trading accuracy for
+ * speed. Only affine conversions (scale and offset), and for
+ * FastFloatPrecision exponential and logarithmic conversions, are affected:
+ * \value DefaultPrecision
+ *        Values are computed in qreal, an affine conversion is a multiplication
+ *        followed by an addition, each of them rounded.
+ * \value FastFloatPrecision
+ *        Values are computed in single precision, which is about twice as fast
+ *        when converting arrays of float, with a relative error in the order
+ *        of 1e-7.
+ * \value FusedMultiplyAddPrecision
+ *        Affine conversions are computed with a fused multiply-add, rounded
+ *        once.
+ * \value CompensatedPrecision
+ *        Affine conversions are computed with error-free transformations of
+ *        the product and the sum, and with coefficients carrying extra
+ *        precision, derived from the definitions of the units in long double
+ *        arithmetic. The result is then as close to the conversion defined by
+ *        the unit-system as double precision allows, even when the scaled value
+ *        and the offset nearly cancel out, at the cost of a few more
+ *        operations per value. Where long double is no wider than double, the
+ *        coefficients carry no extra precision.
+ */
+
+/*!
+ * Returns the precision used by this converter. The default is
+ * DefaultPrecision.
+ */
+UdUnitConverter::Precision UdUnitConverter::precision() const
+{
+    return m_precision;
+}
+
+/*!
+ * Sets the \a precision used by this converter.
+ */
+void UdUnitConverter::setPrecision(Precision precision)
+{
+    m_precision = precision;
+    m_factorLow = 0.0;
+    m_offsetLow = 0.0;
+    if (m_precision == CompensatedPrecision && m_form == AffineForm)
+        compensate();
+}
+
+/*!
+ * Returns a converter from this converter's to unit to this converter's from unit.
+ *
+ * When this converter is affine (scale and offset), the reverse conversion is
+ * derived analytically from this converter and no \UU converter is created.
+ * Otherwise this function asks \UU for a new converter: the coefficients of
+ * exponential and logarithmic conversions are fitted to their \UU converter,
+ * which is more accurate than the inverse of the fitted coefficients. Those
+ * are only inverted for converters without units, as read by
+ * operator>>().
+ *
+ * If this converter is invalid, the returned converter is invalid too.
+ * The returned converter has the same precision() as this converter.
+ */
+UdUnitConverter UdUnitConverter::inverse() const
+{
+    QUD_INSTRUMENT_OPERATION(ConverterCreate);
+    const bool fitted = m_form == ExpForm || m_form == LogForm;
+    if (m_form == GenericForm || (fitted && m_from.isValid() && m_to.isValid())) {
+        UdUnitConverter result(m_to, m_from);
+        result.setPrecision(m_precision);
+        return result;
+    }
+    UdUnitConverter result(m_to, m_from, m_form, m_factor, m_rate, m_offset);
+    switch (m_form) {
+    case IdentityForm:
+        break;
+    case AffineForm:
+        result.m_factor = 1.0 / m_factor;
+        result.m_offset = -m_offset / m_factor;
+        break;
+    case ExpForm:
+        result.m_form = LogForm;
+        break;
+    case LogForm:
+        result.m_form = ExpForm;
+        break;
+    case NullForm:
+    default:
+        result.m_error = m_error;
+        break;
+    }
+    result.setPrecision(m_precision);
+    return result;
 }
 
 /*!
@@ -686,7 +2220,9 @@ bool UdUnitConverter::isValid() const
  */
 qreal UdUnitConverter::convert(qreal value)
 {
-    return cv_convert_double(m_converter, value);
+    QUD_INSTRUMENT_OPERATION(ConvertValue);
+    QUD_INSTRUMENT_COUNT(ConvertedValues, 1);
+    return evaluate(value);
 }
 
 /*!
@@ -695,8 +2231,10 @@ qreal UdUnitConverter::convert(qreal value)
  */
 QVector<qreal> UdUnitConverter::convert(const QVector<qreal> values)
 {
+    if (m_form == IdentityForm)
+        return values;
     QVector<qreal> result(values.size());
-    cv_convert_doubles(m_converter, values.data(), values.size(), result.data());
+    convert(values.constData(), result.data(), values.size());
     return result;
 }
 
@@ -707,6 +2245,719 @@ QVector<qreal> UdUnitConverter::convert(const QVector<qreal> values)
  */
 QVector<qreal> &UdUnitConverter::convert(QVector<qreal> &values)
 {
-    cv_convert_doubles(m_converter, values.data(), values.size(), values.data());
+    if (m_form == IdentityForm)
+        return values;
+    convert(values.constData(), values.data(), values.size());
     return values;
 }
+
+/*!
+ * \fn template <typename In, typename Out> void UdUnitConverter::convert(const In *values, Out *results, qint64 count) const
+ * \overload
+ * Converts the \a count values of type \c In pointed to by \a values to this
+ * converter's to unit and stores them as \c Out in \a results, without
+ * widening them to an intermediate array of qreal first.
+ * \c In can be any arithmetic type, \c Out any floating point type.
+ * For example, the following converts float samples to doubles:
+ * \code
+ * converter.convert(samples.constData(), results.data(), samples.size());
+ * \endcode
+ * \a values and \a results may point to the same array only if \c In and
+ * \c Out have the same size.
+ * If the converter is invalid, the behaviour is undefined.
+ */
+
+/*!
+ * \fn template <typename In, typename Out> void UdUnitConverter::convert(const In *values, Out *results, qint64 count, qreal rawScale, qreal rawOffset) const
+ * \overload
+ * Decodes the \a count raw values pointed to by \a values as
+ * \c{rawScale * value + rawOffset}, which is expressed in the converter's from
+ * unit, converts them to this converter's to unit and stores them in \a results.
+ *
+ * This is meant for packed data, such as NetCDF variables with
+ * \c scale_factor and \c add_offset attributes: when the conversion is
+ * affine, decoding and converting a value is a single multiply-add.
+ * \code
+ * // int16 counts of 0.01 K, to degree Celsius
+ * UdUnitConverter converter(kelvin, celsius);
+ * converter.convert(counts.constData(), temperatures.data(), counts.size(), 0.01, 0.0);
+ * \endcode
+ */
+
+/*!
+ * Converts the \a count values pointed to by \a values (which are expressed in
+ * the converter's from unit) to this converter's to unit and stores them in
+ * \a results. \a values and \a results may point to the same array.
+ * If the converter is invalid, the behaviour is undefined.
+ */
+void UdUnitConverter::convert(const qreal *values, qreal *results, qint64 count) const
+{
+    QUD_INSTRUMENT_OPERATION(ConvertArray);
+    QUD_INSTRUMENT_COUNT(ConvertedValues, count);
+    if (m_form == IdentityForm) {
+        if (values != results)
+            std::copy(values, values + count, results);
+    } else if (m_form == AffineForm) {
+        convert(values, results, count, 1.0, 0.0);
+    } else if (!m_converter.isNull()
+               && (m_precision != FastFloatPrecision || m_form == GenericForm)) {
+        // Only exponential and logarithmic forms have a single precision kernel
+        cv_convert_doubles(m_converter.data(), values, size_t(count), results);
+    } else {
+        for (qint64 i = 0; i < count; ++i)
+            results[i] = evaluate(values[i]);
+    }
+}
+
+/*!
+ * \enum UdUnitConverter::ValueFlag
+ * This enum type specifies the flags stored in the mask of a validated
+ * conversion:
+ * \value ValidValue
+ *        The value is valid.
+ * \value MissingValue
+ *        The value is NaN or equal to the fill value, its result is NaN.
+ * \value OutOfRangeValue
+ *        The value is out of the valid range, its result is converted as any
+ *        other value.
+ * \sa Validation
+ */
+
+/*!
+ * \class UdUnitConverter::Validation
+ * \brief The Validation struct describes how to validate values while they are converted.
+ *
+ * If \c hasFillValue is true, values equal to \c fillValue, which is
+ * expressed in the converter's from unit, are missing values. If \c hasRange
+ * is true, values outside [\c lower, \c upper] are out of range. \c lower and
+ * \c upper are expressed in \c rangeUnit, or in the converter's from unit if
+ * \c rangeUnit is invalid.
+ *
+ * For example, to convert temperatures in degree Fahrenheit to degree Celsius,
+ * with -9999 marking missing values, while flagging the values which are not
+ * physically possible:
+ * \code
+ * UdUnitConverter::Validation validation;
+ * validation.hasFillValue = true;
+ * validation.fillValue = -9999.0;
+ * validation.hasRange = true;
+ * validation.lower = 0.0;
+ * validation.upper = qInf();
+ * validation.rangeUnit = kelvin;
+ * QVector<quint8> mask(values.size());
+ * converter.convert(values.constData(), values.data(), values.size(), validation, mask.data());
+ * \endcode
+ * \sa ValueFlag
+ */
+
+/*!
+ * Constructs a validation with neither fill value nor range.
+ */
+UdUnitConverter::Validation::Validation():
+    hasFillValue(false), fillValue(0.0), hasRange(false), lower(0.0), upper(0.0)
+{
+
+}
+
+/*!
+ * \overload
+ * Converts the \a count values pointed to by \a values to this converter's
+ * to unit, stores them in \a results and validates them according to
+ * \a validation. Missing values are converted to NaN. If \a mask is not null,
+ * it receives the ValueFlag of each value.
+ *
+ * Values are validated before being converted, by blocks small enough to stay
+ * in cache, so that everything happens in a single pass over memory and
+ * \a values and \a results may point to the same array. The range bounds are
+ * converted to the from unit once, rather than converting each value to the
+ * range unit. Values converted exactly onto a bound may then be flagged as
+ * out of range, or not, depending on rounding.
+ *
+ * This function returns the number of valid values, or -1 if the range unit
+ * can't be converted to the from unit, in which case nothing is converted.
+ * If the converter is invalid, the behaviour is undefined.
+ */
+qint64 UdUnitConverter::convert(const qreal *values, qreal *results, qint64 count,
+                                const Validation &validation, quint8 *mask) const
+{
+    qreal lower = -qInf();
+    qreal upper = qInf();
+    if (validation.hasRange) {
+        lower = validation.lower;
+        upper = validation.upper;
+        if (validation.rangeUnit.isValid() && validation.rangeUnit != m_from) {
+            const UdUnitConverter toSource(validation.rangeUnit, m_from);
+            if (!toSource.isValid())
+                return -1;
+            lower = toSource.evaluate(lower);
+            upper = toSource.evaluate(upper);
+            if (lower > upper)
+                std::swap(lower, upper);
+        }
+    }
+    const bool hasFillValue = validation.hasFillValue;
+    const qreal fillValue = validation.fillValue;
+
+    const int bufferSize = 256;
+    quint8 flags[bufferSize];
+    qint64 validCount = 0;
+    for (qint64 begin = 0; begin < count; begin += bufferSize) {
+        const int size = int(qMin(count - begin, qint64(bufferSize)));
+        const qreal *blockValues = values + begin;
+        qreal *blockResults = results + begin;
+        int blockValidCount = 0;
+        for (int i = 0; i < size; ++i) {
+            const qreal value = blockValues[i];
+            const bool missing = value != value || (hasFillValue && value == fillValue);
+            const bool outOfRange = value < lower || value > upper;
+            flags[i] = missing ? quint8(MissingValue) : outOfRange ? quint8(OutOfRangeValue)
+                                                                   : quint8(ValidValue);
+            blockValidCount += flags[i] == ValidValue;
+        }
+        convert(blockValues, blockResults, size);
+        for (int i = 0; i < size; ++i) {
+            if (flags[i] == MissingValue)
+                blockResults[i] = qQNaN();
+        }
+        if (mask != nullptr)
+            std::copy(flags, flags + size, mask + begin);
+        validCount += blockValidCount;
+    }
+    return validCount;
+}
+
+/*!
+ * Converts the \a count values pointed to by \a values to this converter's to
+ * unit and stores them in \a results, as convert() does, without blocking
+ * the calling thread: values are converted on \a pool, or on the global
+ * thread pool if \a pool is null.
+ *
+ * Values are converted by blocks of 65536, progress is the number of blocks
+ * converted so far, and canceling the returned future stops the conversion
+ * after the current block, leaving the remaining results untouched.
+ * \a values and \a results must stay valid until the future is finished.
+ * The conversion uses a copy of this converter, which may be destroyed
+ * meanwhile.
+ */
+QFuture<void> UdUnitConverter::convertAsync(const qreal *values, qreal *results, qint64 count,
+                                            QThreadPool *pool) const
+{
+    const UdUnitConverter converter(*this);
+    return runAsync<void>(pool, [converter, values, results, count](QFutureInterface<void> &interface) {
+        const int blockCount = int((count + s_asyncBlockSize - 1) / s_asyncBlockSize);
+        interface.setProgressRange(0, blockCount);
+        for (int block = 0; block < blockCount && !interface.isCanceled(); ++block) {
+            const qint64 begin = block * s_asyncBlockSize;
+            converter.convert(values + begin, results + begin, qMin(s_asyncBlockSize, count - begin));
+            interface.setProgressValue(block + 1);
+        }
+    });
+}
+
+/*!
+ * \overload
+ * The result of the returned future is \a values converted to this
+ * converter's to unit. A canceled conversion has no result.
+ */
+QFuture<QVector<qreal> > UdUnitConverter::convertAsync(const QVector<qreal> &values,
+                                                       QThreadPool *pool) const
+{
+    const UdUnitConverter converter(*this);
+    return runAsync<QVector<qreal> >(pool, [converter, values](QFutureInterface<QVector<qreal> > &interface) {
+        const qint64 count = values.size();
+        const int blockCount = int((count + s_asyncBlockSize - 1) / s_asyncBlockSize);
+        QVector<qreal> results(values.size());
+        interface.setProgressRange(0, blockCount);
+        for (int block = 0; block < blockCount; ++block) {
+            if (interface.isCanceled())
+                return;
+            const qint64 begin = block * s_asyncBlockSize;
+            converter.convert(values.constData() + begin, results.data() + begin,
+                              qMin(s_asyncBlockSize, count - begin));
+            interface.setProgressValue(block + 1);
+        }
+        interface.reportResult(results);
+    });
+}
+
+/*!
+ * Returns the sum of the \a count values pointed to by \a values, converted
+ * to this converter's to unit, without storing the converted values.
+ *
+ * Like the other reductions, sum() runs in a single pass over \a values. When
+ * the conversion is affine, the values are reduced as they are and only the
+ * result is converted, otherwise values are converted in small blocks on the
+ * stack and reduced as they go. With CompensatedPrecision, values are summed
+ * with compensated (Neumaier) summation.
+ *
+ * NaN values make the sum NaN. If the converter is invalid, the behaviour is
+ * undefined.
+ * \sa mean(), precision()
+ */
+qreal UdUnitConverter::sum(const qreal *values, qint64 count) const
+{
+    if (m_form == IdentityForm || m_form == AffineForm) {
+        const qreal total = sourceSum(values, count);
+        const qreal n = qreal(count);
+        if (m_precision == CompensatedPrecision)
+            return std::fma(m_factor, total, m_offset * n) + (m_factorLow * total + m_offsetLow * n);
+        return m_factor * total + m_offset * n;
+    }
+    qreal total = 0.0;
+    qreal compensation = 0.0;
+    const bool compensated = m_precision == CompensatedPrecision;
+    forEachConverted(values, count, [&](const qreal *block, int size) {
+        const qreal part = sourceSum(block, size);
+        const qreal next = total + part;
+        if (compensated)
+            compensation += qAbs(total) >= qAbs(part) ? (total - next) + part : (part - next) + total;
+        total = next;
+    });
+    return total + compensation;
+}
+
+/*!
+ * Returns the mean of the \a count values pointed to by \a values, converted
+ * to this converter's to unit, or NaN if \a count is 0.
+ * \sa sum()
+ */
+qreal UdUnitConverter::mean(const qreal *values, qint64 count) const
+{
+    if (count <= 0)
+        return qQNaN();
+    if (m_form == IdentityForm || m_form == AffineForm) {
+        const qreal average = sourceSum(values, count) / qreal(count);
+        if (m_precision == CompensatedPrecision)
+            return evaluateCompensated(average);
+        return m_factor * average + m_offset;
+    }
+    return sum(values, count) / qreal(count);
+}
+
+/*!
+ * Returns the smallest of the \a count values pointed to by \a values,
+ * converted to this converter's to unit. NaN values are ignored, NaN is
+ * returned if there are no other values.
+ * \sa maximum(), sum()
+ */
+qreal UdUnitConverter::minimum(const qreal *values, qint64 count) const
+{
+    qreal lowest = qInf();
+    qreal highest = -qInf();
+    if (m_form == IdentityForm || m_form == AffineForm) {
+        sourceRange(values, count, &lowest, &highest);
+        if (lowest > highest)
+            return qQNaN();
+        return evaluate(m_factor >= 0.0 ? lowest : highest);
+    }
+    forEachConverted(values, count, [this, &lowest, &highest](const qreal *block, int size) {
+        sourceRange(block, size, &lowest, &highest);
+    });
+    return lowest > highest ? qQNaN() : lowest;
+}
+
+/*!
+ * Returns the largest of the \a count values pointed to by \a values,
+ * converted to this converter's to unit. NaN values are ignored, NaN is
+ * returned if there are no other values.
+ * \sa minimum(), sum()
+ */
+qreal UdUnitConverter::maximum(const qreal *values, qint64 count) const
+{
+    qreal lowest = qInf();
+    qreal highest = -qInf();
+    if (m_form == IdentityForm || m_form == AffineForm) {
+        sourceRange(values, count, &lowest, &highest);
+        if (lowest > highest)
+            return qQNaN();
+        return evaluate(m_factor >= 0.0 ? highest : lowest);
+    }
+    forEachConverted(values, count, [this, &lowest, &highest](const qreal *block, int size) {
+        sourceRange(block, size, &lowest, &highest);
+    });
+    return lowest > highest ? qQNaN() : highest;
+}
+
+/*!
+ * Returns the histogram of the \a count values pointed to by \a values,
+ * converted to this converter's to unit, over \a binCount bins of equal width
+ * between \a lower (included) and \a upper (excluded), both expressed in this
+ * converter's to unit. Values out of range and NaN values are not counted.
+ * An empty histogram is returned if \a binCount is not positive or if
+ * \a upper is not greater than \a lower.
+ *
+ * When the conversion is affine, the bin of each value is computed from the
+ * value as it is with a single multiply-add. Values converted exactly onto the
+ * edge of a bin may then be counted in the adjacent bin.
+ * \sa sum()
+ */
+QVector<qint64> UdUnitConverter::histogram(const qreal *values, qint64 count,
+                                           qreal lower, qreal upper, int binCount) const
+{
+    if (binCount <= 0 || !(upper > lower))
+        return QVector<qint64>();
+    QVector<qint64> bins(binCount, 0);
+    qint64 *data = bins.data();
+    const qreal width = (upper - lower) / binCount;
+    const qreal bound = qreal(binCount);
+    if (m_form == IdentityForm || m_form == AffineForm) {
+        // bin = (factor * value + offset - lower) / width
+        const qreal scale = m_factor / width;
+        const qreal shift = (m_offset - lower) / width;
+        for (qint64 i = 0; i < count; ++i) {
+            const qreal position = scale * values[i] + shift;
+            if (position >= 0.0 && position < bound)
+                ++data[int(position)];
+        }
+        return bins;
+    }
+    forEachConverted(values, count, [=](const qreal *block, int size) {
+        for (int i = 0; i < size; ++i) {
+            const qreal position = (block[i] - lower) / width;
+            if (position >= 0.0 && position < bound)
+                ++data[int(position)];
+        }
+    });
+    return bins;
+}
+
+/*!
+ * \internal
+ * Returns the sum of the \a count \a values, without converting them.
+ */
+qreal UdUnitConverter::sourceSum(const qreal *values, qint64 count) const
+{
+    if (m_precision == CompensatedPrecision) {
+        qreal total = 0.0;
+        qreal compensation = 0.0;
+        for (qint64 i = 0; i < count; ++i) {
+            const qreal value = values[i];
+            const qreal next = total + value;
+            if (qAbs(total) >= qAbs(value))
+                compensation += (total - next) + value;
+            else
+                compensation += (value - next) + total;
+            total = next;
+        }
+        return total + compensation;
+    }
+    // Independent partial sums, so that the additions can be pipelined
+    qreal partials[4] = { 0.0, 0.0, 0.0, 0.0 };
+    qint64 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        partials[0] += values[i];
+        partials[1] += values[i + 1];
+        partials[2] += values[i + 2];
+        partials[3] += values[i + 3];
+    }
+    for (; i < count; ++i)
+        partials[0] += values[i];
+    return (partials[0] + partials[1]) + (partials[2] + partials[3]);
+}
+
+/*!
+ * \internal
+ * Extends [\a minimum, \a maximum] to the range of the \a count \a values,
+ * without converting them. NaN values are ignored.
+ */
+void UdUnitConverter::sourceRange(const qreal *values, qint64 count,
+                                  qreal *minimum, qreal *maximum) const
+{
+    qreal lowest = *minimum;
+    qreal highest = *maximum;
+    for (qint64 i = 0; i < count; ++i) {
+        const qreal value = values[i];
+        lowest = value < lowest ? value : lowest;
+        highest = value > highest ? value : highest;
+    }
+    *minimum = lowest;
+    *maximum = highest;
+}
+
+/*!
+ * \internal
+ * Converts the \a count \a values by blocks on the stack and calls \a function
+ * with each block of converted values and its size.
+ */
+template <typename Function>
+void UdUnitConverter::forEachConverted(const qreal *values, qint64 count, Function function) const
+{
+    const int bufferSize = 256;
+    qreal buffer[bufferSize];
+    for (qint64 begin = 0; begin < count; begin += bufferSize) {
+        const int size = int(qMin(count - begin, qint64(bufferSize)));
+        convert(values + begin, buffer, size);
+        function(buffer, size);
+    }
+}
+
+/*!
+ * \internal
+ * Converts a single \a value using the compiled form if possible, the \UU
+ * converter otherwise.
+ */
+qreal UdUnitConverter::evaluate(qreal value) const
+{
+    if (m_precision == FastFloatPrecision) {
+        const float x = float(value);
+        switch (m_form) {
+        case AffineForm:
+            return float(m_factor) * x + float(m_offset);
+        case ExpForm:
+            return float(m_factor) * std::exp(float(m_rate) * x) + float(m_offset);
+        case LogForm:
+            return std::log((x - float(m_offset)) / float(m_factor)) / float(m_rate);
+        default:
+            break;
+        }
+    }
+    switch (m_form) {
+    case IdentityForm:
+        return value;
+    case AffineForm:
+        if (m_precision == CompensatedPrecision)
+            return evaluateCompensated(value);
+        if (m_precision == FusedMultiplyAddPrecision)
+            return std::fma(m_factor, value, m_offset);
+        return m_factor * value + m_offset;
+    case ExpForm:
+        if (m_converter.isNull())
+            return m_factor * std::exp(m_rate * value) + m_offset;
+        break;
+    case LogForm:
+        if (m_converter.isNull())
+            return std::log((value - m_offset) / m_factor) / m_rate;
+        break;
+    default:
+        break;
+    }
+    return cv_convert_double(m_converter.data(), value);
+}
+
+namespace {
+
+// Relative tolerance used to accept a compiled form against the \UU converter
+const qreal s_affineTolerance = 1e-12;
+const qreal s_transcendentalTolerance = 1e-9;
+
+// scale is the magnitude of the terms that make up expected, so that results
+// suffering from cancellation (eg. log(1)) are not rejected.
+bool matches(qreal expected, qreal actual, qreal tolerance, qreal scale)
+{
+    if (!std::isfinite(expected) || !std::isfinite(actual))
+        return false;
+    const qreal magnitude = qMax(qMax(qAbs(expected), qAbs(actual)), qMax(scale, qreal(1e-300)));
+    return qAbs(expected - actual) <= tolerance * magnitude;
+}
+
+}
+
+/*!
+ * \internal
+ * Probes the \UU converter to find out if the conversion is affine,
+ * exponential or logarithmic and if so extracts its coefficients.
+ *
+ * Probes are checked against the \UU converter at extra points, the
+ * generic form is used if anything doesn't fit.
+ */
+void UdUnitConverter::compile()
+{
+    m_form = NullForm;
+    m_factor = 1.0;
+    m_rate = 1.0;
+    m_offset = 0.0;
+    if (m_converter.isNull())
+        return;
+
+    const cv_converter *cv = m_converter.data();
+
+    // Affine: y = a*x + c, c is y(0), a is recovered exactly by probing at a
+    // power of two large enough for c to vanish in the rounding of a*x
+    const qreal y0 = cv_convert_double(cv, 0.0);
+    const qreal y1 = cv_convert_double(cv, 1.0);
+    if (std::isfinite(y0) && std::isfinite(y1) && y1 != y0) {
+        qreal factor = y1;
+        if (y0 != 0.0) {
+            int exponent = 0;
+            std::frexp(qAbs(y0) / qAbs(y1 - y0), &exponent);
+            const qreal x = std::ldexp(1.0, qMax(exponent, 0) + 56);
+            factor = cv_convert_double(cv, x) / x;
+        }
+        const qreal offset = y0;
+        const qreal probes[] = { 1.0, -3.0, 0.5, 1000.0 };
+        bool affine = std::isfinite(factor) && factor != 0.0;
+        for (qreal x: probes) {
+            if (!affine)
+                break;
+            affine = matches(cv_convert_double(cv, x), factor * x + offset,
+                             s_affineTolerance, qAbs(factor * x) + qAbs(offset));
+        }
+        if (affine) {
+            m_form = (factor == 1.0 && offset == 0.0) ? IdentityForm : AffineForm;
+            m_factor = factor;
+            m_offset = offset;
+            return;
+        }
+    }
+
+    // Exponential: y = a*exp(k*x) + c
+    const qreal y2 = cv_convert_double(cv, 2.0);
+    if (std::isfinite(y0) && std::isfinite(y1) && std::isfinite(y2) && y1 != y0) {
+        const qreal ratio = (y2 - y1) / (y1 - y0);
+        if (ratio > 0.0 && ratio != 1.0) {
+            const qreal rate = std::log(ratio);
+            const qreal factor = (y1 - y0) / (ratio - 1.0);
+            qreal offset = y0 - factor;
+            if (qAbs(offset) <= s_affineTolerance * qAbs(factor))
+                offset = 0.0;
+            const qreal probes[] = { -1.0, 0.5, 3.0 };
+            bool exponential = true;
+            for (qreal x: probes) {
+                if (!exponential)
+                    break;
+                const qreal term = factor * std::exp(rate * x);
+                exponential = matches(cv_convert_double(cv, x), term + offset,
+                                      s_transcendentalTolerance, qAbs(term) + qAbs(offset));
+            }
+            if (exponential) {
+                m_form = ExpForm;
+                m_factor = factor;
+                m_rate = rate;
+                m_offset = offset;
+                return;
+            }
+        }
+    }
+
+    // Logarithmic: y = log(x/a)/k
+    const qreal y10 = cv_convert_double(cv, 10.0);
+    if (std::isfinite(y1) && std::isfinite(y10) && y10 != y1) {
+        const qreal rate = std::log(10.0) / (y10 - y1);
+        const qreal factor = std::exp(-rate * y1);
+        const qreal probes[] = { 100.0, 0.5, 1e-3, 7.0 };
+        bool logarithmic = std::isfinite(factor) && factor > 0.0;
+        for (qreal x: probes) {
+            if (!logarithmic)
+                break;
+            logarithmic = matches(cv_convert_double(cv, x),
+                                  std::log(x / factor) / rate,
+                                  s_transcendentalTolerance, qAbs(1.0 / rate));
+        }
+        if (logarithmic) {
+            m_form = LogForm;
+            m_factor = factor;
+            m_rate = rate;
+            m_offset = 0.0;
+            return;
+        }
+    }
+
+    m_form = GenericForm;
+}
+
+/*!
+ * \internal
+ * Computes the low order parts of the affine coefficients from the scales and
+ * offsets of the units, in long double. They are left to zero if the units
+ * can't be decomposed or if their definitions don't match the coefficients.
+ */
+void UdUnitConverter::compensate()
+{
+    const UdCompactUnit from(m_from);
+    const UdCompactUnit to(m_to);
+    if (!from.hasSameDimension(to))
+        return;
+
+    // value in base units = scale * (value + offset)
+    typedef long double Extended;
+    const Extended factor = Extended(from.scale()) / Extended(to.scale());
+    const Extended offset = Extended(from.scale()) * Extended(from.offset()) / Extended(to.scale())
+            - Extended(to.offset());
+    const qreal factorLow = qreal(factor - Extended(m_factor));
+    const qreal offsetLow = qreal(offset - Extended(m_offset));
+    const qreal magnitude = qAbs(m_factor) + qAbs(m_offset);
+    if (!std::isfinite(factorLow) || !std::isfinite(offsetLow)
+            || qAbs(factorLow) > s_affineTolerance * qAbs(m_factor)
+            || qAbs(offsetLow) > s_affineTolerance * magnitude)
+        return;
+    m_factorLow = factorLow;
+    m_offsetLow = offsetLow;
+}
+
+/*!
+ * \relates UdUnitConverter
+ * Writes the compiled form of \a converter to \a stream: its kind of
+ * conversion, precision and coefficients, bit for bit. Writing doesn't
+ * allocate any memory besides what \a stream needs.
+ *
+ * Converters which only \UU can evaluate, eg. between timestamp units with
+ * different calendars, are written as invalid converters.
+ */
+QDataStream &operator <<(QDataStream &stream, const UdUnitConverter &converter)
+{
+    UdUnitConverter::Form form = converter.m_form;
+    int error = converter.m_error;
+    if (form == UdUnitConverter::GenericForm) {
+        form = UdUnitConverter::NullForm;
+        error = UT_MEANINGLESS;
+    }
+    stream << s_streamVersion << quint8(form) << quint8(converter.m_precision) << quint8(error);
+    writeReal(stream, converter.m_factor);
+    writeReal(stream, converter.m_rate);
+    writeReal(stream, converter.m_offset);
+    writeReal(stream, converter.m_factorLow);
+    writeReal(stream, converter.m_offsetLow);
+    return stream;
+}
+
+/*!
+ * \relates UdUnitConverter
+ * Reads a converter written by operator<<() from \a stream into
+ * \a converter, which then converts values exactly as the written converter
+ * did, without any \UU unit-system: reading a converter neither allocates
+ * memory nor requires a unit database.
+ *
+ * The units of the read converter are unknown, its fromUnit() and toUnit()
+ * are invalid. If the record is corrupted or of an unknown version,
+ * \a converter is left unchanged and the status of \a stream is set to
+ * QDataStream::ReadCorruptData.
+ */
+QDataStream &operator >>(QDataStream &stream, UdUnitConverter &converter)
+{
+    quint8 version = 0;
+    stream >> version;
+    if (stream.status() != QDataStream::Ok)
+        return stream;
+    if (version != s_streamVersion) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return stream;
+    }
+    quint8 form = 0;
+    quint8 precision = 0;
+    quint8 error = 0;
+    stream >> form >> precision >> error;
+    const qreal factor = readReal(stream);
+    const qreal rate = readReal(stream);
+    const qreal offset = readReal(stream);
+    const qreal factorLow = readReal(stream);
+    const qreal offsetLow = readReal(stream);
+    if (stream.status() != QDataStream::Ok)
+        return stream;
+    if (form >= UdUnitConverter::GenericForm || precision > UdUnitConverter::CompensatedPrecision) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return stream;
+    }
+
+    converter.m_converter.clear();
+    converter.m_from = UdUnit();
+    converter.m_to = UdUnit();
+    converter.m_form = UdUnitConverter::Form(form);
+    converter.m_error = error;
+    converter.m_precision = UdUnitConverter::Precision(precision);
+    converter.m_factor = factor;
+    converter.m_rate = rate;
+    converter.m_offset = offset;
+    converter.m_factorLow = factorLow;
+    converter.m_offsetLow = offsetLow;
+    return stream;
+}
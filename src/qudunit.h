@@ -2,18 +2,32 @@
 #define QUDUNIT_H
 
 #include "qudunit_global.h"
+#include "quderror.h"
 
+#include <QFuture>
+#include <QHash>
 #include <QMetaType>
+#include <QReadWriteLock>
+#include <QSharedPointer>
 #include <QString>
 #include <QVector>
 #include <QMap>
 
 #include <udunits2.h>
 
+#include <cmath>
+#include <type_traits>
+
+class QDataStream;
+class QStringList;
+class QThreadPool;
+
 class UdUnitSystem;
 class UdUnitPrefix;
 class UdUnit;
 class UdUnitConverter;
+class UdUnitTable;
+class UdIdentifierIndex;
 
 class QUDUNITSHARED_EXPORT UdUnit {
 public:
@@ -40,7 +54,10 @@ public:
     UdUnit(const UdUnit &other);
     ~UdUnit();
 
+    UdUnit &operator =(const UdUnit &other);
+
     bool isValid() const;
+    UdError error() const;
     UdUnitSystem system();
     UnitType type() const;
     QString name() const;
@@ -79,6 +96,7 @@ public:
     { return !(lhs == rhs); }
 
     // operations for scale, offset, invert, raise, root, log
+    // (see UdUnitBuilder for lazily evaluated ones)
     friend UdUnit operator *(const UdUnit &lhs, const UdUnit &rhs);
     friend UdUnit operator *(const UdUnit &lhs, qreal rhs);
     friend UdUnit operator *(qreal lhs, const UdUnit &rhs);
@@ -101,6 +119,9 @@ public:
 private:
     friend class UdUnitSystem;
     friend class UdUnitConverter;
+    friend class UdCompactUnit;
+    friend class UdConcurrentUnitSystem;
+    friend class UdUnitTranslator;
     UdUnit(ut_unit *unit, int status);
 
     static ut_visitor m_visitor;
@@ -116,6 +137,10 @@ private:
     ut_unit *m_unit;
     int m_errorStatus;
     UnitType m_type;
+    // Identifiers of a prefixed unit \UU has no mapping for, set by
+    // UdUnitSystem::autoPrefix()
+    QString m_prefixedName;
+    QString m_prefixedSymbol;
 };
 
 Q_DECLARE_METATYPE(UdUnit::UnitType);
@@ -124,26 +149,203 @@ Q_DECLARE_METATYPE(UdUnit::UnitType);
 class QUDUNITSHARED_EXPORT UdUnitConverter {
 
 public:
+    enum Precision {
+        DefaultPrecision = 0,
+        FastFloatPrecision,
+        FusedMultiplyAddPrecision,
+        CompensatedPrecision
+    };
+
+    enum ValueFlag {
+        ValidValue = 0x0,
+        MissingValue = 0x1,
+        OutOfRangeValue = 0x2
+    };
+
+    struct Validation {
+        Validation();
+
+        bool hasFillValue;
+        qreal fillValue;
+        bool hasRange;
+        qreal lower;
+        qreal upper;
+        UdUnit rangeUnit;
+    };
+
     UdUnitConverter(const UdUnit &from, const UdUnit &to);
+    UdUnitConverter(const UdUnitConverter &other);
     ~UdUnitConverter();
 
+    UdUnitConverter &operator =(const UdUnitConverter &other);
+
     UdUnit fromUnit() const;
     UdUnit toUnit() const;
 
     bool isValid() const;
+    UdError error() const;
+    Precision precision() const;
+    void setPrecision(Precision precision);
+    UdUnitConverter inverse() const;
     qreal convert(qreal value);
     QVector<qreal> convert(const QVector<qreal> values);
     QVector<qreal> &convert(QVector<qreal> &values);
+    void convert(const qreal *values, qreal *results, qint64 count) const;
+    qint64 convert(const qreal *values, qreal *results, qint64 count,
+                   const Validation &validation, quint8 *mask = nullptr) const;
+    QFuture<void> convertAsync(const qreal *values, qreal *results, qint64 count,
+                               QThreadPool *pool = nullptr) const;
+    QFuture<QVector<qreal> > convertAsync(const QVector<qreal> &values,
+                                          QThreadPool *pool = nullptr) const;
+    template <typename In, typename Out>
+    void convert(const In *values, Out *results, qint64 count) const;
+    template <typename In, typename Out>
+    void convert(const In *values, Out *results, qint64 count,
+                 qreal rawScale, qreal rawOffset) const;
+
+    qreal sum(const qreal *values, qint64 count) const;
+    qreal mean(const qreal *values, qint64 count) const;
+    qreal minimum(const qreal *values, qint64 count) const;
+    qreal maximum(const qreal *values, qint64 count) const;
+    QVector<qint64> histogram(const qreal *values, qint64 count,
+                              qreal lower, qreal upper, int binCount) const;
 
     // TODO:
     static bool canConvert(const UdUnit &from, const UdUnit &to);
 
 private:
+    friend class UdConversionMatrix;
+    friend QUDUNITSHARED_EXPORT QDataStream &operator <<(QDataStream &stream,
+                                                         const UdUnitConverter &converter);
+    friend QUDUNITSHARED_EXPORT QDataStream &operator >>(QDataStream &stream,
+                                                         UdUnitConverter &converter);
+
+    // Compiled form of the conversion, y = f(x):
+    //  - AffineForm: y = factor * x + offset
+    //  - ExpForm:    y = factor * exp(rate * x) + offset
+    //  - LogForm:    y = log((x - offset) / factor) / rate
+    //  - GenericForm: only m_converter can do it
+    enum Form {
+        NullForm = 0,
+        IdentityForm,
+        AffineForm,
+        ExpForm,
+        LogForm,
+        GenericForm
+    };
+
+    UdUnitConverter(const UdUnit &from, const UdUnit &to, Form form,
+                    qreal factor, qreal rate, qreal offset);
+    void compile();
+    void compensate();
+    qreal evaluate(qreal value) const;
+    qreal sourceSum(const qreal *values, qint64 count) const;
+    void sourceRange(const qreal *values, qint64 count, qreal *minimum, qreal *maximum) const;
+    template <typename Function>
+    void forEachConverted(const qreal *values, qint64 count, Function function) const;
+    inline qreal evaluateCompensated(qreal value) const;
+
     UdUnit m_from;
     UdUnit m_to;
-    cv_converter *m_converter;
+    // Shared by copies, \UU converters are immutable once created
+    QSharedPointer<cv_converter> m_converter;
+    int m_error;
+    Form m_form;
+    qreal m_factor;
+    qreal m_rate;
+    qreal m_offset;
+    Precision m_precision;
+    // Low order parts of m_factor and m_offset, for CompensatedPrecision
+    qreal m_factorLow;
+    qreal m_offsetLow;
 };
 
+Q_DECLARE_METATYPE(UdUnitConverter::Precision);
+
+QUDUNITSHARED_EXPORT QDataStream &operator <<(QDataStream &stream, const UdUnitConverter &converter);
+QUDUNITSHARED_EXPORT QDataStream &operator >>(QDataStream &stream, UdUnitConverter &converter);
+
+inline qreal UdUnitConverter::evaluateCompensated(qreal value) const
+{
+    // Error-free product and sum, their rounding errors and the low order
+    // parts of the coefficients are added back at the end
+    const qreal product = m_factor * value;
+    const qreal productError = std::fma(m_factor, value, -product);
+    const qreal sum = product + m_offset;
+    const qreal virtualOffset = sum - product;
+    const qreal sumError = (product - (sum - virtualOffset)) + (m_offset - virtualOffset);
+    return sum + (productError + sumError + std::fma(m_factorLow, value, m_offsetLow));
+}
+
+template <typename In, typename Out>
+inline void UdUnitConverter::convert(const In *values, Out *results, qint64 count) const
+{
+    convert(values, results, count, 1.0, 0.0);
+}
+
+template <typename In, typename Out>
+void UdUnitConverter::convert(const In *values, Out *results, qint64 count,
+                              qreal rawScale, qreal rawOffset) const
+{
+    static_assert(std::is_arithmetic<In>::value, "Input values must be of an arithmetic type");
+    static_assert(std::is_floating_point<Out>::value, "Results must be of a floating point type");
+
+    // Decoding and affine conversions fold into a single multiply-add
+    if (m_form == AffineForm && m_precision == CompensatedPrecision) {
+        for (qint64 i = 0; i < count; ++i)
+            results[i] = Out(evaluateCompensated(rawScale * qreal(values[i]) + rawOffset));
+        return;
+    }
+    if (m_form == IdentityForm || m_form == AffineForm) {
+        const qreal factor = m_factor * rawScale;
+        const qreal offset = m_factor * rawOffset + m_offset;
+        if (m_form == AffineForm && m_precision == FastFloatPrecision) {
+            const float floatFactor = float(factor);
+            const float floatOffset = float(offset);
+            for (qint64 i = 0; i < count; ++i)
+                results[i] = Out(floatFactor * float(values[i]) + floatOffset);
+        } else if (m_form == AffineForm && m_precision == FusedMultiplyAddPrecision) {
+            for (qint64 i = 0; i < count; ++i)
+                results[i] = Out(std::fma(factor, qreal(values[i]), offset));
+        } else {
+            for (qint64 i = 0; i < count; ++i)
+                results[i] = Out(factor * qreal(values[i]) + offset);
+        }
+        return;
+    }
+
+    const int bufferSize = 256;
+    qreal buffer[bufferSize];
+    for (qint64 begin = 0; begin < count; begin += bufferSize) {
+        const int size = int(qMin(count - begin, qint64(bufferSize)));
+        for (int i = 0; i < size; ++i)
+            buffer[i] = rawScale * qreal(values[begin + i]) + rawOffset;
+        convert(buffer, buffer, size);
+        for (int i = 0; i < size; ++i)
+            results[begin + i] = Out(buffer[i]);
+    }
+}
+
+class QUDUNITSHARED_EXPORT UdUnitPrefix
+{
+public:
+    inline UdUnitPrefix(): m_value(1.0) {}
+    inline UdUnitPrefix(const QString &name, const QString &symbol, qreal value):
+        m_name(name), m_symbol(symbol), m_value(value) {}
+
+    inline bool isNull() const { return m_name.isEmpty() && m_symbol.isEmpty(); }
+    inline QString name() const { return m_name; }
+    inline QString symbol() const { return m_symbol; }
+    inline qreal value() const { return m_value; }
+
+private:
+    QString m_name;
+    QString m_symbol;
+    qreal m_value;
+};
+
+Q_DECLARE_TYPEINFO(UdUnitPrefix, Q_MOVABLE_TYPE);
+
 // TODO: Allow to specify XML path
 //       either at construct time or maybe as a property
 // TODO: Should we parse the files to offer enumeration service?
@@ -161,32 +363,89 @@ public:
     ~UdUnitSystem();
 
     static UdUnitSystem *loadDatabase(const QString &pathname = QString());
+    static QFuture<UdUnitSystem *> loadDatabaseAsync(const QString &pathname = QString(),
+                                                     QThreadPool *pool = nullptr);
+    static UdUnitSystem *loadTable(const UdUnitTable &table);
+    static UdUnitSystem *loadBuiltinDatabase();
 
     UdUnit unitByName(const QString &name) const;
+    UdUnit unitByName(const QByteArray &name) const;
+    UdUnit unitByName(const char *name, int size = -1) const;
+    UdUnit unitByName(QLatin1String name) const;
     UdUnit unitBySymbol(const QString &symbol) const;
+    UdUnit unitBySymbol(const QByteArray &symbol) const;
+    UdUnit unitBySymbol(const char *symbol, int size = -1) const;
+    UdUnit unitBySymbol(QLatin1String symbol) const;
     UdUnit dimensionLessUnitOne() const;
     UdUnit unitFromString(const QString &text) const;
+    UdUnit unitFromString(const QByteArray &text) const;
+    UdUnit unitFromString(const char *text, int size = -1) const;
+    UdUnit unitFromString(QLatin1String text) const;
+    QFuture<UdUnit> parseAsync(const QStringList &texts, QThreadPool *pool = nullptr) const;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    UdUnit unitByName(QStringView name) const;
+    UdUnit unitBySymbol(QStringView symbol) const;
+    UdUnit unitFromString(QStringView text) const;
+#endif
 
-    bool isValid();
+    bool isValid() const;
+    UdError error() const;
     QString errorMessage() const;
 
+    QString canonicalForm(const UdUnit &unit) const;
+    QString canonicalForm(const QString &text) const;
+    quint64 canonicalKey(const UdUnit &unit) const;
+    quint64 canonicalKey(const QString &text) const;
+
+    quint64 fingerprint() const;
+    void writeUnit(QDataStream &stream, const UdUnit &unit) const;
+    UdUnit readUnit(QDataStream &stream) const;
+
     QString databasePath() const;
     DatabaseOrigin databaseOrigin() const;
 
     UdUnit addBaseUnit(const QString &name, const QString &symbol);
     UdUnit addDimensionlessUnit(const QString &name, const QString &symbol);
     bool addUnit(const UdUnit &unit, const QString &name, const QString &symbol);
-    bool addPrefix(const QString &name, const QString &symbol);
+    bool addPrefix(const QString &name, const QString &symbol, qreal value);
+
+    QVector<UdUnitPrefix> prefixes() const;
+    UdUnitConverter autoPrefix(const UdUnit &unit, const qreal *values, qint64 count,
+                               UdUnitPrefix *prefix = nullptr) const;
+    UdUnitConverter autoPrefix(const UdUnit &unit, qreal minimum, qreal maximum,
+                               UdUnitPrefix *prefix = nullptr) const;
 
 private:
     friend class UdUnit;
+    friend class UdConcurrentUnitSystem;
+    friend class UdUnitTranslator;
     UdUnitSystem(ut_system *system, ut_status status);
     UdUnitSystem(const UdUnitSystem &other);
+    UdUnit findByName(const char *name) const;
+    UdUnit findBySymbol(const char *symbol) const;
+    UdUnit parse(const char *text, ut_encoding encoding) const;
+    int registerUnit(const ut_unit *unit, const QString &name, const QString &symbol);
+    int registerPrefix(const QString &name, const QString &symbol, qreal value);
+    int indexUnit(const ut_unit *unit) const;
+    struct CanonicalUnit;
+    CanonicalUnit canonicalize(const UdUnit &unit) const;
+    CanonicalUnit canonicalize(const QString &text) const;
     ut_system *m_system;
     int m_error;
-    QString m_errorMessage;
+    // Guards the caches const functions fill on first use, so that they can
+    // be called concurrently
+    mutable QReadWriteLock m_cacheLock;
+    // Canonical units by unit string, created on first use
+    mutable QHash<QString, CanonicalUnit> *m_canonicalCache;
+    // Computed on first use, 0 until then
+    mutable quint64 m_fingerprint;
+    // Identifier index of the table loaded with loadTable(), if any
+    struct TableIndex;
+    TableIndex *m_tableIndex;
+    // Registered and already looked up identifiers, created on first use
+    mutable UdIdentifierIndex *m_identifierIndex;
+    // SI prefixes defined by this unit-system, created on first use
+    mutable QVector<UdUnitPrefix> *m_prefixes;
 };
 
-
-
 #endif // QUDUNIT_H
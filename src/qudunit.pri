@@ -0,0 +1,46 @@
+#-------------------------------------------------
+#
+# Sources of the qudunit library, also compiled into tools/udgentable, which
+# generates the builtin unit table before the library is built
+#
+#-------------------------------------------------
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/qudunit.cpp \
+    $$PWD/qudunitstreamconverter.cpp \
+    $$PWD/qudunitfileconverter.cpp \
+    $$PWD/qudcompactunit.cpp \
+    $$PWD/qudunitbuilder.cpp \
+    $$PWD/qudinstrumentation.cpp \
+    $$PWD/quderror.cpp \
+    $$PWD/qudconcurrentunitsystem.cpp \
+    $$PWD/qudquantityarray.cpp \
+    $$PWD/qudunittranslator.cpp \
+    $$PWD/qudconversionmatrix.cpp \
+    $$PWD/qudunittable.cpp \
+    $$PWD/qudidentifierindex.cpp \
+    $$PWD/qudsharedunittable.cpp \
+    $$PWD/qudrecordconverter.cpp
+
+HEADERS += \
+    $$PWD/qudunit.h \
+    $$PWD/qudunit_global.h \
+    $$PWD/qudunitstreamconverter.h \
+    $$PWD/qudunitfileconverter.h \
+    $$PWD/qudcompactunit.h \
+    $$PWD/qudunitbuilder.h \
+    $$PWD/qudinstrumentation.h \
+    $$PWD/qudinstrumentation_p.h \
+    $$PWD/quderror.h \
+    $$PWD/qudconcurrentunitsystem.h \
+    $$PWD/qudquantityarray.h \
+    $$PWD/qudunittranslator.h \
+    $$PWD/qudconversionmatrix.h \
+    $$PWD/qudunittable.h \
+    $$PWD/qudunittable_p.h \
+    $$PWD/qudidentifierindex_p.h \
+    $$PWD/qudsharedunittable.h \
+    $$PWD/qudrecordconverter.h
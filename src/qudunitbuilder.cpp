@@ -0,0 +1,272 @@
+#include "qudunitbuilder.h"
+
+/*!
+ * \class UdUnitBuilder
+ * \ingroup index
+ * \preliminary
+ * \brief The UdUnitBuilder class evaluates UdUnit expressions lazily.
+ *
+ * Each arithmetic operation on UdUnit creates a new \UU unit, so that an
+ * expression like the following one allocates four intermediate units:
+ * \code
+ * UdUnit unit = a * b / c.raisedBy(2) * 1000.0;
+ * \endcode
+ *
+ * A builder evaluates the same operators lazily: operands are decomposed
+ * into UdCompactUnit objects, scale factors are folded and powers of the
+ * same base units are combined without any call into \UU. The product of
+ * the powers of the base units is created once per unit-system and reused,
+ * so converting the builder to a UdUnit usually allocates a single unit.
+ * Wrapping the first operand is enough, operators taking a builder and a
+ * UdUnit return a builder:
+ * \code
+ * UdUnit unit = UdUnitBuilder(a) * b / UdUnitBuilder(c).raisedBy(2) * 1000.0;
+ * UdUnitConverter converter(UdUnitBuilder(a) * a * a, UdUnitBuilder(b).raisedBy(3));
+ * \endcode
+ *
+ * Operands that cannot be represented by a UdCompactUnit (logarithmic and
+ * timestamp units) are evaluated eagerly, as are the operations UdCompactUnit
+ * cannot represent: the result is the same as with the UdUnit operators.
+ *
+ * Note that UdUnit member functions, such as UdUnit::raisedBy(), are always
+ * evaluated eagerly, use the UdUnitBuilder ones instead to keep an expression
+ * lazy.
+ *
+ * A builder refers to the unit-system of its operands, and so must not
+ * outlive it.
+ *
+ * \sa UdUnit, UdCompactUnit
+ */
+
+/*!
+ * Constructs a builder from \a unit.
+ */
+UdUnitBuilder::UdUnitBuilder(const UdUnit &unit):
+    m_compact(unit)
+{
+    if (!m_compact.isValid())
+        m_unit = unit;
+}
+
+/*!
+ * \internal
+ */
+UdUnitBuilder::UdUnitBuilder(const UdCompactUnit &compact):
+    m_compact(compact)
+{
+
+}
+
+/*!
+ * Returns true if the unit built is valid.
+ */
+bool UdUnitBuilder::isValid() const
+{
+    return isLazy() || m_unit.isValid();
+}
+
+/*!
+ * Returns true if the unit built has not been evaluated yet, false if it had
+ * to be evaluated by \UU.
+ */
+bool UdUnitBuilder::isLazy() const
+{
+    return m_compact.isValid();
+}
+
+/*!
+ * Returns true if the unit built is dimensionless.
+ * A lazy builder doesn't need to be evaluated to answer.
+ */
+bool UdUnitBuilder::isDimensionless() const
+{
+    if (isLazy())
+        return m_compact.isDimensionless();
+    return m_unit.isDimensionless();
+}
+
+/*!
+ * Evaluates the expression and returns the resulting unit.
+ */
+UdUnit UdUnitBuilder::toUnit() const
+{
+    if (isLazy())
+        return m_compact.toUnit();
+    return m_unit;
+}
+
+/*!
+ * \fn UdUnitBuilder::operator UdUnit() const
+ * Evaluates the expression and returns the resulting unit.
+ * \sa toUnit()
+ */
+
+/*!
+ * Returns a builder for this unit scaled by \a factor.
+ * \sa UdUnit::scaledBy()
+ */
+UdUnitBuilder UdUnitBuilder::scaledBy(qreal factor) const
+{
+    if (isLazy()) {
+        const UdCompactUnit result = m_compact.scaledBy(factor);
+        if (result.isValid())
+            return UdUnitBuilder(result);
+    }
+    return UdUnitBuilder(toUnit().scaledBy(factor));
+}
+
+/*!
+ * Returns a builder for this unit offset by \a offset.
+ * \sa UdUnit::offsetBy()
+ */
+UdUnitBuilder UdUnitBuilder::offsetBy(qreal offset) const
+{
+    if (isLazy()) {
+        const UdCompactUnit result = m_compact.offsetBy(offset);
+        if (result.isValid())
+            return UdUnitBuilder(result);
+    }
+    return UdUnitBuilder(toUnit().offsetBy(offset));
+}
+
+/*!
+ * Returns a builder for the inverse of this unit.
+ * \sa UdUnit::inverted()
+ */
+UdUnitBuilder UdUnitBuilder::inverted() const
+{
+    if (isLazy()) {
+        const UdCompactUnit result = m_compact.inverted();
+        if (result.isValid())
+            return UdUnitBuilder(result);
+    }
+    return UdUnitBuilder(toUnit().inverted());
+}
+
+/*!
+ * Returns a builder for this unit raised by \a power.
+ * \sa UdUnit::raisedBy()
+ */
+UdUnitBuilder UdUnitBuilder::raisedBy(int power) const
+{
+    if (isLazy()) {
+        const UdCompactUnit result = m_compact.raisedBy(power);
+        if (result.isValid())
+            return UdUnitBuilder(result);
+    }
+    return UdUnitBuilder(toUnit().raisedBy(power));
+}
+
+/*!
+ * Returns a builder for the \a root root of this unit.
+ * \sa UdUnit::rootedBy()
+ */
+UdUnitBuilder UdUnitBuilder::rootedBy(int root) const
+{
+    if (isLazy()) {
+        const UdCompactUnit result = m_compact.rootedBy(root);
+        if (result.isValid())
+            return UdUnitBuilder(result);
+    }
+    return UdUnitBuilder(toUnit().rootedBy(root));
+}
+
+/*!
+ * \relates UdUnitBuilder
+ * Returns a builder for the product of \a lhs and \a rhs.
+ */
+UdUnitBuilder operator *(const UdUnitBuilder &lhs, const UdUnitBuilder &rhs)
+{
+    if (lhs.isLazy() && rhs.isLazy()) {
+        const UdCompactUnit result = lhs.m_compact * rhs.m_compact;
+        if (result.isValid())
+            return UdUnitBuilder(result);
+    }
+    return UdUnitBuilder(lhs.toUnit() * rhs.toUnit());
+}
+
+/*!
+ * \relates UdUnitBuilder
+ * Returns a builder for \a lhs scaled by \a rhs.
+ */
+UdUnitBuilder operator *(const UdUnitBuilder &lhs, qreal rhs)
+{
+    return lhs.scaledBy(rhs);
+}
+
+/*!
+ * \relates UdUnitBuilder
+ * Returns a builder for \a rhs scaled by \a lhs.
+ */
+UdUnitBuilder operator *(qreal lhs, const UdUnitBuilder &rhs)
+{
+    return rhs.scaledBy(lhs);
+}
+
+/*!
+ * \relates UdUnitBuilder
+ * Returns a builder for the quotient of \a lhs and \a rhs.
+ */
+UdUnitBuilder operator /(const UdUnitBuilder &lhs, const UdUnitBuilder &rhs)
+{
+    if (lhs.isLazy() && rhs.isLazy()) {
+        const UdCompactUnit result = lhs.m_compact / rhs.m_compact;
+        if (result.isValid())
+            return UdUnitBuilder(result);
+    }
+    return UdUnitBuilder(lhs.toUnit() / rhs.toUnit());
+}
+
+/*!
+ * \relates UdUnitBuilder
+ * Returns a builder for \a lhs scaled by the inverse of \a rhs.
+ */
+UdUnitBuilder operator /(const UdUnitBuilder &lhs, qreal rhs)
+{
+    return lhs.scaledBy(1/rhs);
+}
+
+/*!
+ * \relates UdUnitBuilder
+ * Returns a builder for the inverse of \a rhs scaled by \a lhs.
+ */
+UdUnitBuilder operator /(qreal lhs, const UdUnitBuilder &rhs)
+{
+    return rhs.inverted().scaledBy(lhs);
+}
+
+/*!
+ * \relates UdUnitBuilder
+ * Returns a builder for \a lhs offset by \a rhs.
+ */
+UdUnitBuilder operator +(const UdUnitBuilder &lhs, qreal rhs)
+{
+    return lhs.offsetBy(rhs);
+}
+
+/*!
+ * \relates UdUnitBuilder
+ * Returns a builder for \a rhs offset by \a lhs.
+ */
+UdUnitBuilder operator +(qreal lhs, const UdUnitBuilder &rhs)
+{
+    return rhs.offsetBy(lhs);
+}
+
+/*!
+ * \relates UdUnitBuilder
+ * Returns a builder for \a lhs offset by the opposite of \a rhs.
+ */
+UdUnitBuilder operator -(const UdUnitBuilder &lhs, qreal rhs)
+{
+    return lhs.offsetBy(-rhs);
+}
+
+/*!
+ * \relates UdUnitBuilder
+ * Returns a builder for \a rhs offset by the opposite of \a lhs.
+ */
+UdUnitBuilder operator -(qreal lhs, const UdUnitBuilder &rhs)
+{
+    return rhs.offsetBy(-lhs);
+}
@@ -0,0 +1,72 @@
+#ifndef QUDUNITBUILDER_H
+#define QUDUNITBUILDER_H
+
+#include "qudunit_global.h"
+#include "qudunit.h"
+#include "qudcompactunit.h"
+
+class QUDUNITSHARED_EXPORT UdUnitBuilder
+{
+public:
+    UdUnitBuilder(const UdUnit &unit);
+
+    bool isValid() const;
+    bool isLazy() const;
+    bool isDimensionless() const;
+
+    UdUnit toUnit() const;
+    inline operator UdUnit() const
+    { return toUnit(); }
+
+    UdUnitBuilder scaledBy(qreal factor) const;
+    UdUnitBuilder offsetBy(qreal offset) const;
+    UdUnitBuilder inverted() const;
+    UdUnitBuilder raisedBy(int power) const;
+    UdUnitBuilder rootedBy(int root) const;
+
+private:
+    friend QUDUNITSHARED_EXPORT UdUnitBuilder operator *(const UdUnitBuilder &lhs, const UdUnitBuilder &rhs);
+    friend QUDUNITSHARED_EXPORT UdUnitBuilder operator /(const UdUnitBuilder &lhs, const UdUnitBuilder &rhs);
+
+    explicit UdUnitBuilder(const UdCompactUnit &compact);
+
+    // Either a lazily combined compact unit, or, for units that cannot be
+    // represented by one (logarithmic and timestamp units), an evaluated unit.
+    UdCompactUnit m_compact;
+    UdUnit m_unit;
+};
+
+QUDUNITSHARED_EXPORT UdUnitBuilder operator *(const UdUnitBuilder &lhs, const UdUnitBuilder &rhs);
+QUDUNITSHARED_EXPORT UdUnitBuilder operator *(const UdUnitBuilder &lhs, qreal rhs);
+QUDUNITSHARED_EXPORT UdUnitBuilder operator *(qreal lhs, const UdUnitBuilder &rhs);
+QUDUNITSHARED_EXPORT UdUnitBuilder operator /(const UdUnitBuilder &lhs, const UdUnitBuilder &rhs);
+QUDUNITSHARED_EXPORT UdUnitBuilder operator /(const UdUnitBuilder &lhs, qreal rhs);
+QUDUNITSHARED_EXPORT UdUnitBuilder operator /(qreal lhs, const UdUnitBuilder &rhs);
+QUDUNITSHARED_EXPORT UdUnitBuilder operator +(const UdUnitBuilder &lhs, qreal rhs);
+QUDUNITSHARED_EXPORT UdUnitBuilder operator +(qreal lhs, const UdUnitBuilder &rhs);
+QUDUNITSHARED_EXPORT UdUnitBuilder operator -(const UdUnitBuilder &lhs, qreal rhs);
+QUDUNITSHARED_EXPORT UdUnitBuilder operator -(qreal lhs, const UdUnitBuilder &rhs);
+
+inline UdUnitBuilder operator *(const UdUnitBuilder &lhs, const UdUnit &rhs)
+{ return lhs * UdUnitBuilder(rhs); }
+inline UdUnitBuilder operator *(const UdUnit &lhs, const UdUnitBuilder &rhs)
+{ return UdUnitBuilder(lhs) * rhs; }
+inline UdUnitBuilder operator /(const UdUnitBuilder &lhs, const UdUnit &rhs)
+{ return lhs / UdUnitBuilder(rhs); }
+inline UdUnitBuilder operator /(const UdUnit &lhs, const UdUnitBuilder &rhs)
+{ return UdUnitBuilder(lhs) / rhs; }
+
+inline bool operator ==(const UdUnitBuilder &lhs, const UdUnitBuilder &rhs)
+{ return lhs.toUnit() == rhs.toUnit(); }
+inline bool operator ==(const UdUnitBuilder &lhs, const UdUnit &rhs)
+{ return lhs.toUnit() == rhs; }
+inline bool operator ==(const UdUnit &lhs, const UdUnitBuilder &rhs)
+{ return lhs == rhs.toUnit(); }
+inline bool operator !=(const UdUnitBuilder &lhs, const UdUnitBuilder &rhs)
+{ return !(lhs == rhs); }
+inline bool operator !=(const UdUnitBuilder &lhs, const UdUnit &rhs)
+{ return !(lhs == rhs); }
+inline bool operator !=(const UdUnit &lhs, const UdUnitBuilder &rhs)
+{ return !(lhs == rhs); }
+
+#endif // QUDUNITBUILDER_H
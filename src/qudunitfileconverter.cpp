@@ -0,0 +1,369 @@
+#include "qudunitfileconverter.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QVector>
+#include <QtConcurrent>
+#include <QtEndian>
+
+#include <cstring>
+
+/*!
+ * \class UdUnitFileConverter
+ * \ingroup index
+ * \preliminary
+ * \brief The UdUnitFileConverter class converts raw binary arrays stored in files.
+ *
+ * A file converter converts files made of contiguous little-endian IEEE 754
+ * samples (see SampleType) using a UdUnitConverter.
+ * Files are memory-mapped, so that the whole content is never read into memory,
+ * and samples are converted in parallel, chunkSize() samples at a time,
+ * using the global QThreadPool.
+ *
+ * The input file can be converted into another file (see convert()), possibly
+ * changing the sample type, or in place (see convertInPlace()).
+ *
+ * After each conversion, sampleCount(), byteCount(), elapsed() and throughput()
+ * report on the work done.
+ *
+ * For example, the following converts a float32 grid from kelvin to degree
+ * Celsius:
+ * \code
+ * UdUnitFileConverter converter(UdUnitConverter(kelvin, celsius));
+ * converter.setInputType(UdUnitFileConverter::Float32);
+ * converter.setOutputType(UdUnitFileConverter::Float32);
+ * if (!converter.convert("grid-K.f32", "grid-degC.f32"))
+ *     qWarning() << converter.errorString();
+ * \endcode
+ * \sa UdUnitConverter, UdUnitStreamConverter
+ */
+
+/*!
+ * \enum UdUnitFileConverter::SampleType
+ * This enum type specifies the encoding of samples in a file:
+ * \value Float32
+ *        Little-endian IEEE 754 single precision.
+ * \value Float64
+ *        Little-endian IEEE 754 double precision.
+ */
+
+namespace {
+
+const qint64 s_defaultChunkSize = 1 << 18;
+
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+// Samples are converted through a buffer of this size on big-endian hosts
+const int s_bufferSize = 1024;
+
+qreal loadSample(const uchar *data, UdUnitFileConverter::SampleType type)
+{
+    if (type == UdUnitFileConverter::Float32) {
+        const quint32 bits = qFromLittleEndian<quint32>(data);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    const quint64 bits = qFromLittleEndian<quint64>(data);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void storeSample(qreal value, uchar *data, UdUnitFileConverter::SampleType type)
+{
+    if (type == UdUnitFileConverter::Float32) {
+        const float single = float(value);
+        quint32 bits;
+        std::memcpy(&bits, &single, sizeof(bits));
+        qToLittleEndian<quint32>(bits, data);
+        return;
+    }
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    qToLittleEndian<quint64>(bits, data);
+}
+#endif
+
+}
+
+/*!
+ * Constructs a file converter using \a converter.
+ * Both input and output sample types are Float64 by default.
+ */
+UdUnitFileConverter::UdUnitFileConverter(const UdUnitConverter &converter):
+    m_converter(converter), m_inputType(Float64), m_outputType(Float64),
+    m_chunkSize(s_defaultChunkSize), m_sampleCount(0), m_byteCount(0), m_elapsed(0)
+{
+
+}
+
+/*!
+ * Destroys the file converter.
+ */
+UdUnitFileConverter::~UdUnitFileConverter()
+{
+
+}
+
+/*!
+ * Sets the sample \a type of input files.
+ */
+void UdUnitFileConverter::setInputType(SampleType type)
+{
+    m_inputType = type;
+}
+
+/*!
+ * Returns the sample type of input files.
+ */
+UdUnitFileConverter::SampleType UdUnitFileConverter::inputType() const
+{
+    return m_inputType;
+}
+
+/*!
+ * Sets the sample \a type of output files.
+ */
+void UdUnitFileConverter::setOutputType(SampleType type)
+{
+    m_outputType = type;
+}
+
+/*!
+ * Returns the sample type of output files.
+ */
+UdUnitFileConverter::SampleType UdUnitFileConverter::outputType() const
+{
+    return m_outputType;
+}
+
+/*!
+ * Sets to \a samples the number of samples converted by each parallel task.
+ */
+void UdUnitFileConverter::setChunkSize(qint64 samples)
+{
+    m_chunkSize = qMax(samples, qint64(1));
+}
+
+/*!
+ * Returns the number of samples converted by each parallel task.
+ */
+qint64 UdUnitFileConverter::chunkSize() const
+{
+    return m_chunkSize;
+}
+
+/*!
+ * Converts the samples of the file \a inputPath and writes them to the file
+ * \a outputPath, which is created or truncated.
+ * If \a outputPath is the input file, it is converted in place instead, see
+ * convertInPlace().
+ * Returns true on success, false otherwise, see errorString().
+ */
+bool UdUnitFileConverter::convert(const QString &inputPath, const QString &outputPath)
+{
+    // Truncating the output would destroy the input before it is mapped
+    const QString canonicalInput = QFileInfo(inputPath).canonicalFilePath();
+    if (!canonicalInput.isEmpty() && canonicalInput == QFileInfo(outputPath).canonicalFilePath())
+        return convertInPlace(inputPath);
+
+    m_errorString.clear();
+    m_sampleCount = m_byteCount = m_elapsed = 0;
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile input(inputPath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        m_errorString = input.errorString();
+        return false;
+    }
+    const qint64 count = input.size() / sampleSize(m_inputType);
+    if (count * sampleSize(m_inputType) != input.size()) {
+        m_errorString = QStringLiteral("Input file size is not a multiple of the sample size");
+        return false;
+    }
+
+    QFile output(outputPath);
+    if (!output.open(QIODevice::ReadWrite | QIODevice::Truncate)
+            || !output.resize(count * sampleSize(m_outputType))) {
+        m_errorString = output.errorString();
+        return false;
+    }
+    if (count == 0)
+        return true;
+
+    const uchar *source = input.map(0, input.size());
+    uchar *destination = output.map(0, output.size());
+    if (source == nullptr || destination == nullptr) {
+        m_errorString = source == nullptr ? input.errorString() : output.errorString();
+        return false;
+    }
+    const bool result = convertMapped(source, destination, count);
+    output.unmap(destination);
+    input.unmap(const_cast<uchar *>(source));
+    m_byteCount = input.size() + output.size();
+    m_elapsed = timer.nsecsElapsed();
+    return result;
+}
+
+/*!
+ * Converts the samples of the file \a path in place.
+ * Input and output sample types have to be the same.
+ * Returns true on success, false otherwise, see errorString().
+ */
+bool UdUnitFileConverter::convertInPlace(const QString &path)
+{
+    m_errorString.clear();
+    m_sampleCount = m_byteCount = m_elapsed = 0;
+    if (m_inputType != m_outputType) {
+        m_errorString = QStringLiteral("In place conversion requires identical sample types");
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadWrite)) {
+        m_errorString = file.errorString();
+        return false;
+    }
+    const qint64 count = file.size() / sampleSize(m_inputType);
+    if (count * sampleSize(m_inputType) != file.size()) {
+        m_errorString = QStringLiteral("File size is not a multiple of the sample size");
+        return false;
+    }
+    if (count == 0)
+        return true;
+
+    uchar *data = file.map(0, file.size());
+    if (data == nullptr) {
+        m_errorString = file.errorString();
+        return false;
+    }
+    const bool result = convertMapped(data, data, count);
+    file.unmap(data);
+    m_byteCount = 2 * file.size();
+    m_elapsed = timer.nsecsElapsed();
+    return result;
+}
+
+/*!
+ * Returns the number of samples converted by the last conversion.
+ */
+qint64 UdUnitFileConverter::sampleCount() const
+{
+    return m_sampleCount;
+}
+
+/*!
+ * Returns the number of bytes read and written by the last conversion.
+ */
+qint64 UdUnitFileConverter::byteCount() const
+{
+    return m_byteCount;
+}
+
+/*!
+ * Returns the duration of the last conversion, in nanoseconds, including
+ * opening and mapping the files.
+ */
+qint64 UdUnitFileConverter::elapsed() const
+{
+    return m_elapsed;
+}
+
+/*!
+ * Returns the throughput of the last conversion, in bytes (read and written)
+ * per second.
+ */
+qreal UdUnitFileConverter::throughput() const
+{
+    if (m_elapsed <= 0)
+        return 0.0;
+    return qreal(m_byteCount) * 1e9 / qreal(m_elapsed);
+}
+
+/*!
+ * Returns a description of the last error that occured.
+ */
+QString UdUnitFileConverter::errorString() const
+{
+    return m_errorString;
+}
+
+/*!
+ * \internal
+ * Splits the \a count samples in chunks and converts them in parallel from
+ * \a input to \a output.
+ */
+bool UdUnitFileConverter::convertMapped(const uchar *input, uchar *output, qint64 count)
+{
+    if (!m_converter.isValid()) {
+        m_errorString = QStringLiteral("Invalid converter");
+        return false;
+    }
+    QVector<qint64> chunks;
+    chunks.reserve(int(count / m_chunkSize + 1));
+    for (qint64 begin = 0; begin < count; begin += m_chunkSize)
+        chunks.append(begin);
+    QtConcurrent::blockingMap(chunks, [this, input, output, count](const qint64 &begin) {
+        convertChunk(input, output, begin, qMin(begin + m_chunkSize, count));
+    });
+    m_sampleCount = count;
+    return true;
+}
+
+/*!
+ * \internal
+ * Converts samples from \a begin to \a end (excluded). On little-endian
+ * hosts, samples are converted directly in the mapped memory, otherwise they
+ * go through a small buffer.
+ */
+void UdUnitFileConverter::convertChunk(const uchar *input, uchar *output,
+                                       qint64 begin, qint64 end) const
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    if (m_inputType == Float64)
+        convertNative(reinterpret_cast<const double *>(input) + begin, output, begin, end - begin);
+    else
+        convertNative(reinterpret_cast<const float *>(input) + begin, output, begin, end - begin);
+#else
+    const int inputSize = sampleSize(m_inputType);
+    const int outputSize = sampleSize(m_outputType);
+    qreal buffer[s_bufferSize];
+    for (qint64 index = begin; index < end; index += s_bufferSize) {
+        const int count = int(qMin(end - index, qint64(s_bufferSize)));
+        const uchar *source = input + index * inputSize;
+        for (int i = 0; i < count; ++i, source += inputSize)
+            buffer[i] = loadSample(source, m_inputType);
+        m_converter.convert(buffer, buffer, count);
+        uchar *destination = output + index * outputSize;
+        for (int i = 0; i < count; ++i, destination += outputSize)
+            storeSample(buffer[i], destination, m_outputType);
+    }
+#endif
+}
+
+/*!
+ * \internal
+ * Converts \a count native samples from \a source to \a output, starting at
+ * sample \a begin.
+ */
+template <typename In>
+void UdUnitFileConverter::convertNative(const In *source, uchar *output,
+                                        qint64 begin, qint64 count) const
+{
+    if (m_outputType == Float64)
+        m_converter.convert(source, reinterpret_cast<double *>(output) + begin, count);
+    else
+        m_converter.convert(source, reinterpret_cast<float *>(output) + begin, count);
+}
+
+/*!
+ * \internal
+ */
+int UdUnitFileConverter::sampleSize(SampleType type)
+{
+    return type == Float32 ? 4 : 8;
+}
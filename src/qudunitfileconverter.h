@@ -0,0 +1,53 @@
+#ifndef QUDUNITFILECONVERTER_H
+#define QUDUNITFILECONVERTER_H
+
+#include "qudunit_global.h"
+#include "qudunit.h"
+
+#include <QString>
+
+class QUDUNITSHARED_EXPORT UdUnitFileConverter
+{
+public:
+    enum SampleType {
+        Float32 = 0,
+        Float64
+    };
+
+    explicit UdUnitFileConverter(const UdUnitConverter &converter);
+    ~UdUnitFileConverter();
+
+    void setInputType(SampleType type);
+    SampleType inputType() const;
+    void setOutputType(SampleType type);
+    SampleType outputType() const;
+    void setChunkSize(qint64 samples);
+    qint64 chunkSize() const;
+
+    bool convert(const QString &inputPath, const QString &outputPath);
+    bool convertInPlace(const QString &path);
+
+    qint64 sampleCount() const;
+    qint64 byteCount() const;
+    qint64 elapsed() const;
+    qreal throughput() const;
+    QString errorString() const;
+
+private:
+    bool convertMapped(const uchar *input, uchar *output, qint64 count);
+    void convertChunk(const uchar *input, uchar *output, qint64 begin, qint64 end) const;
+    template <typename In>
+    void convertNative(const In *source, uchar *output, qint64 begin, qint64 count) const;
+    static int sampleSize(SampleType type);
+
+    UdUnitConverter m_converter;
+    SampleType m_inputType;
+    SampleType m_outputType;
+    qint64 m_chunkSize;
+    qint64 m_sampleCount;
+    qint64 m_byteCount;
+    qint64 m_elapsed;
+    QString m_errorString;
+};
+
+#endif // QUDUNITFILECONVERTER_H
@@ -0,0 +1,738 @@
+#include "qudunitstreamconverter.h"
+
+#include <QIODevice>
+#include <QtConcurrent>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+/*!
+ * \class UdUnitStreamConverter
+ * \ingroup index
+ * \preliminary
+ * \brief The UdUnitStreamConverter class converts numeric fields of a record
+ * stream chunk by chunk.
+ *
+ * A stream converter reads records from an input QIODevice (pull interface,
+ * see convert()) or from data handed over by the caller (push interface, see
+ * start(), write() and finish()), converts the configured fields with their
+ * UdUnitConverter and writes the records to an output QIODevice.
+ * Everything but the converted fields is written out unchanged.
+ *
+ * Two record formats are supported:
+ * \list
+ *  \li DelimitedText: one record per line, fields separated by delimiter().
+ *      Fields are selected by their column index. The first headerLineCount()
+ *      lines are passed through unchanged, as are fields that don't parse as
+ *      a number (see invalidFieldCount()).
+ *  \li BinaryRecords: fixed size records of recordSize() bytes. Fields are
+ *      selected by their byte offset within the record and their FieldType.
+ *      Converted values are written back in place, using the same type and
+ *      byteOrder(). Integer fields are rounded and saturated.
+ * \endlist
+ *
+ * Memory usage is bounded by two chunks of chunkSize() bytes: while one
+ * chunk is being converted on a worker thread, the next one is being filled.
+ * Records spanning two chunks are carried over to the next chunk, a record
+ * (or a text line) can't be larger than a chunk.
+ *
+ * For example, the following converts the second column of a CSV file from
+ * kelvin to degree Celsius:
+ * \code
+ * UdUnitStreamConverter stream(UdUnitStreamConverter::DelimitedText);
+ * stream.setHeaderLineCount(1);
+ * stream.addField(1, UdUnitConverter(kelvin, celsius));
+ * stream.convert(&input, &output);
+ * \endcode
+ * \sa UdUnitConverter
+ */
+
+/*!
+ * \enum UdUnitStreamConverter::RecordFormat
+ * This enum type specifies how records are laid out in the stream:
+ * \value DelimitedText
+ *        One record per line, fields separated by a delimiter character.
+ * \value BinaryRecords
+ *        Fixed size binary records.
+ */
+
+/*!
+ * \enum UdUnitStreamConverter::FieldType
+ * This enum type specifies how a binary field is encoded:
+ * \value Float32
+ *        IEEE 754 single precision.
+ * \value Float64
+ *        IEEE 754 double precision.
+ * \value Int16
+ *        Signed 16 bits integer.
+ * \value Int32
+ *        Signed 32 bits integer.
+ */
+
+/*!
+ * \enum UdUnitStreamConverter::ByteOrder
+ * This enum type specifies the byte order of binary fields:
+ * \value LittleEndian
+ * \value BigEndian
+ */
+
+namespace {
+
+const int s_defaultChunkSize = 1 << 20;
+
+template <typename T>
+T loadField(const char *data, UdUnitStreamConverter::ByteOrder order)
+{
+    return order == UdUnitStreamConverter::LittleEndian ? qFromLittleEndian<T>(data)
+                                                        : qFromBigEndian<T>(data);
+}
+
+template <typename T>
+void storeField(T value, char *data, UdUnitStreamConverter::ByteOrder order)
+{
+    if (order == UdUnitStreamConverter::LittleEndian)
+        qToLittleEndian<T>(value, data);
+    else
+        qToBigEndian<T>(value, data);
+}
+
+qreal decode(const char *data, UdUnitStreamConverter::FieldType type,
+             UdUnitStreamConverter::ByteOrder order)
+{
+    switch (type) {
+    case UdUnitStreamConverter::Float32: {
+        const quint32 bits = loadField<quint32>(data, order);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    case UdUnitStreamConverter::Float64: {
+        const quint64 bits = loadField<quint64>(data, order);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    case UdUnitStreamConverter::Int16:
+        return loadField<qint16>(data, order);
+    case UdUnitStreamConverter::Int32:
+        return loadField<qint32>(data, order);
+    }
+    return 0.0;
+}
+
+template <typename T>
+T saturate(qreal value)
+{
+    if (qIsNaN(value))
+        return 0;
+    if (value <= qreal(std::numeric_limits<T>::min()))
+        return std::numeric_limits<T>::min();
+    if (value >= qreal(std::numeric_limits<T>::max()))
+        return std::numeric_limits<T>::max();
+    return T(qRound64(value));
+}
+
+void encode(qreal value, char *data, UdUnitStreamConverter::FieldType type,
+            UdUnitStreamConverter::ByteOrder order)
+{
+    switch (type) {
+    case UdUnitStreamConverter::Float32: {
+        const float single = float(value);
+        quint32 bits;
+        std::memcpy(&bits, &single, sizeof(bits));
+        storeField<quint32>(bits, data, order);
+        break;
+    }
+    case UdUnitStreamConverter::Float64: {
+        quint64 bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        storeField<quint64>(bits, data, order);
+        break;
+    }
+    case UdUnitStreamConverter::Int16:
+        storeField<qint16>(saturate<qint16>(value), data, order);
+        break;
+    case UdUnitStreamConverter::Int32:
+        storeField<qint32>(saturate<qint32>(value), data, order);
+        break;
+    }
+}
+
+// Capacity of the buffer text fields are copied to, to be null-terminated
+// before parsing
+const int s_numberCapacity = 64;
+
+inline bool isAsciiSpace(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Returns the end of the line starting at data, and stores the end of its
+// fields, before any carriage return, and the start of the next line
+const char *splitLine(const char *data, const char *end, const char **fieldsEnd,
+                      const char **next)
+{
+    const char *newline = static_cast<const char *>(std::memchr(data, '\n', size_t(end - data)));
+    const char *lineEnd = newline != nullptr ? newline : end;
+    *next = newline != nullptr ? newline + 1 : end;
+    *fieldsEnd = lineEnd > data && lineEnd[-1] == '\r' ? lineEnd - 1 : lineEnd;
+    return lineEnd;
+}
+
+// Returns the end of the field starting at field
+inline const char *findDelimiter(const char *field, const char *fieldsEnd, char delimiter)
+{
+    const char *found = static_cast<const char *>(
+                std::memchr(field, delimiter, size_t(fieldsEnd - field)));
+    return found != nullptr ? found : fieldsEnd;
+}
+
+// Parses the number from first to last, surrounded by whitespace or not,
+// through buffer
+qreal parseNumber(const char *first, const char *last, QByteArray &buffer, bool *ok)
+{
+    while (first < last && isAsciiSpace(*first))
+        ++first;
+    while (last > first && isAsciiSpace(last[-1]))
+        --last;
+    buffer.resize(0);
+    buffer.append(first, int(last - first));
+    const qreal value = buffer.toDouble(ok);
+    return *ok ? value : 0.0;
+}
+
+int fieldSize(UdUnitStreamConverter::FieldType type)
+{
+    switch (type) {
+    case UdUnitStreamConverter::Float32:
+    case UdUnitStreamConverter::Int32:
+        return 4;
+    case UdUnitStreamConverter::Float64:
+        return 8;
+    case UdUnitStreamConverter::Int16:
+        return 2;
+    }
+    return 0;
+}
+
+}
+
+/*!
+ * Constructs a stream converter for records laid out according to \a format.
+ */
+UdUnitStreamConverter::UdUnitStreamConverter(RecordFormat format):
+    m_format(format), m_delimiter(','), m_headerLineCount(0), m_headerLinesLeft(0),
+    m_precision(15), m_recordSize(0), m_byteOrder(LittleEndian),
+    m_chunkSize(s_defaultChunkSize), m_output(nullptr), m_fillIndex(0),
+    m_pendingIndex(-1), m_recordCount(0), m_invalidFieldCount(0)
+{
+
+}
+
+/*!
+ * Destroys the stream converter, waiting for any chunk still being converted.
+ * Data not yet flushed with finish() is lost.
+ */
+UdUnitStreamConverter::~UdUnitStreamConverter()
+{
+    m_pending.waitForFinished();
+}
+
+/*!
+ * Returns the record format this stream converter has been constructed with.
+ */
+UdUnitStreamConverter::RecordFormat UdUnitStreamConverter::recordFormat() const
+{
+    return m_format;
+}
+
+/*!
+ * Sets the field \a delimiter for delimited text records, default is a comma.
+ */
+void UdUnitStreamConverter::setDelimiter(char delimiter)
+{
+    m_delimiter = delimiter;
+}
+
+/*!
+ * Returns the field delimiter for delimited text records.
+ */
+char UdUnitStreamConverter::delimiter() const
+{
+    return m_delimiter;
+}
+
+/*!
+ * Sets to \a count the number of leading lines which are passed through
+ * unchanged, default is 0.
+ */
+void UdUnitStreamConverter::setHeaderLineCount(int count)
+{
+    m_headerLineCount = qMax(count, 0);
+}
+
+/*!
+ * Returns the number of leading lines which are passed through unchanged.
+ */
+int UdUnitStreamConverter::headerLineCount() const
+{
+    return m_headerLineCount;
+}
+
+/*!
+ * Sets to \a precision the number of significant digits used to write
+ * converted text fields, default is 15.
+ */
+void UdUnitStreamConverter::setPrecision(int precision)
+{
+    m_precision = precision;
+}
+
+/*!
+ * Returns the number of significant digits used to write converted text fields.
+ */
+int UdUnitStreamConverter::precision() const
+{
+    return m_precision;
+}
+
+/*!
+ * Adds a delimited text field at \a column (counting from 0) to be converted
+ * using \a converter.
+ */
+void UdUnitStreamConverter::addField(int column, const UdUnitConverter &converter)
+{
+    Q_ASSERT(m_format == DelimitedText);
+    if (column < 0)
+        return;
+    if (column >= m_columnFields.size())
+        m_columnFields.resize(column + 1);
+    m_fields.append(Field(column, Float64, converter));
+    m_columnFields[column] = m_fields.size();
+}
+
+/*!
+ * Sets to \a size the size in bytes of binary records.
+ */
+void UdUnitStreamConverter::setRecordSize(int size)
+{
+    m_recordSize = size;
+}
+
+/*!
+ * Returns the size in bytes of binary records.
+ */
+int UdUnitStreamConverter::recordSize() const
+{
+    return m_recordSize;
+}
+
+/*!
+ * Sets the byte \a order of binary fields, default is LittleEndian.
+ */
+void UdUnitStreamConverter::setByteOrder(ByteOrder order)
+{
+    m_byteOrder = order;
+}
+
+/*!
+ * Returns the byte order of binary fields.
+ */
+UdUnitStreamConverter::ByteOrder UdUnitStreamConverter::byteOrder() const
+{
+    return m_byteOrder;
+}
+
+/*!
+ * Adds a binary field of \a type at byte \a offset within the record to be
+ * converted using \a converter.
+ */
+void UdUnitStreamConverter::addField(int offset, FieldType type, const UdUnitConverter &converter)
+{
+    Q_ASSERT(m_format == BinaryRecords);
+    if (offset < 0)
+        return;
+    m_fields.append(Field(offset, type, converter));
+}
+
+/*!
+ * Sets to \a size the size in bytes of the chunks the stream is processed by,
+ * default is 1 MiB. Two chunks are allocated while streaming.
+ */
+void UdUnitStreamConverter::setChunkSize(int size)
+{
+    m_chunkSize = qMax(size, 1);
+}
+
+/*!
+ * Returns the size in bytes of the chunks the stream is processed by.
+ */
+int UdUnitStreamConverter::chunkSize() const
+{
+    return m_chunkSize;
+}
+
+/*!
+ * Reads all the records available from \a input until the end of the stream,
+ * converts them and writes them to \a output.
+ * Returns true on success, false otherwise, see errorString().
+ */
+bool UdUnitStreamConverter::convert(QIODevice *input, QIODevice *output)
+{
+    if (input == nullptr || !input->isReadable()) {
+        setError(QStringLiteral("Input device is not readable"));
+        return false;
+    }
+    if (!start(output))
+        return false;
+
+    forever {
+        Chunk &chunk = m_chunks[m_fillIndex];
+        const int used = chunk.input.size();
+        chunk.input.resize(m_chunkSize);
+        const qint64 count = input->read(chunk.input.data() + used, m_chunkSize - used);
+        chunk.input.resize(used + int(qMax(count, qint64(0))));
+        if (count < 0) {
+            setError(input->errorString());
+            return false;
+        }
+        if (chunk.input.size() == m_chunkSize) {
+            if (!dispatch(false))
+                return false;
+            continue;
+        }
+        if (count == 0 && (!input->isSequential() || input->atEnd()
+                           || !input->waitForReadyRead(-1)))
+            break;
+    }
+    return finish();
+}
+
+/*!
+ * Starts a push conversion writing converted records to \a output.
+ * Returns true on success, false otherwise, see errorString().
+ * \sa write(), finish()
+ */
+bool UdUnitStreamConverter::start(QIODevice *output)
+{
+    m_pending.waitForFinished();
+    m_errorString.clear();
+    m_recordCount = 0;
+    m_invalidFieldCount = 0;
+    m_headerLinesLeft = m_headerLineCount;
+    m_fillIndex = 0;
+    m_pendingIndex = -1;
+
+    if (m_format == BinaryRecords) {
+        if (m_recordSize <= 0 || m_recordSize > m_chunkSize) {
+            setError(QStringLiteral("Invalid record size"));
+            return false;
+        }
+        for (const Field &field: m_fields) {
+            if (field.position + fieldSize(field.type) > m_recordSize) {
+                setError(QStringLiteral("Field out of record bounds"));
+                return false;
+            }
+        }
+    }
+    if (output == nullptr || !output->isWritable()) {
+        setError(QStringLiteral("Output device is not writable"));
+        return false;
+    }
+    m_output = output;
+
+    for (Chunk &chunk: m_chunks) {
+        chunk.input.reserve(m_chunkSize);
+        chunk.input.resize(0);
+        chunk.output.resize(0);
+        chunk.recordCount = 0;
+        chunk.invalidFieldCount = 0;
+    }
+    return true;
+}
+
+/*!
+ * Pushes \a size bytes of input records pointed to by \a data.
+ * Records don't have to be aligned on \a data boundaries.
+ * Returns true on success, false otherwise, see errorString().
+ * \sa start(), finish()
+ */
+bool UdUnitStreamConverter::write(const char *data, qint64 size)
+{
+    if (m_output == nullptr) {
+        setError(QStringLiteral("Conversion not started"));
+        return false;
+    }
+    while (size > 0) {
+        Chunk &chunk = m_chunks[m_fillIndex];
+        const int count = int(qMin(size, qint64(m_chunkSize - chunk.input.size())));
+        chunk.input.append(data, count);
+        data += count;
+        size -= count;
+        if (chunk.input.size() == m_chunkSize && !dispatch(false))
+            return false;
+    }
+    return true;
+}
+
+/*!
+ * \overload
+ */
+bool UdUnitStreamConverter::write(const QByteArray &data)
+{
+    return write(data.constData(), data.size());
+}
+
+/*!
+ * Converts the remaining records and waits for all of them to be written.
+ * Returns true on success, false otherwise, see errorString().
+ * \sa start(), write()
+ */
+bool UdUnitStreamConverter::finish()
+{
+    if (m_output == nullptr) {
+        setError(QStringLiteral("Conversion not started"));
+        return false;
+    }
+    bool result = true;
+    if (!m_chunks[m_fillIndex].input.isEmpty())
+        result = dispatch(true);
+    result = collect() && result;
+    m_output = nullptr;
+    return result;
+}
+
+/*!
+ * Returns the number of records converted so far.
+ */
+qint64 UdUnitStreamConverter::recordCount() const
+{
+    return m_recordCount;
+}
+
+/*!
+ * Returns the number of text fields which have been passed through unchanged
+ * because they couldn't be parsed as a number.
+ */
+qint64 UdUnitStreamConverter::invalidFieldCount() const
+{
+    return m_invalidFieldCount;
+}
+
+/*!
+ * Returns a description of the last error that occured.
+ */
+QString UdUnitStreamConverter::errorString() const
+{
+    return m_errorString;
+}
+
+/*!
+ * \internal
+ * Returns the number of bytes of \a data made of complete records.
+ */
+int UdUnitStreamConverter::completeLength(const QByteArray &data) const
+{
+    if (m_format == BinaryRecords)
+        return data.size() - data.size() % m_recordSize;
+    const int index = data.lastIndexOf('\n');
+    return index + 1;
+}
+
+/*!
+ * \internal
+ * Hands over the complete records of the chunk being filled to a worker thread,
+ * the incomplete trailing record is carried over to the other chunk which then
+ * becomes the one being filled. If \a final is true, the chunk is expected to
+ * contain only complete records.
+ */
+bool UdUnitStreamConverter::dispatch(bool final)
+{
+    Chunk &chunk = m_chunks[m_fillIndex];
+    int complete = completeLength(chunk.input);
+    if (final) {
+        if (complete != chunk.input.size() && m_format == BinaryRecords) {
+            setError(QStringLiteral("Truncated record at end of stream"));
+            return false;
+        }
+        complete = chunk.input.size();
+    } else if (complete == 0) {
+        setError(QStringLiteral("Record larger than chunk size"));
+        return false;
+    }
+
+    if (!collect())
+        return false;
+
+    const int fillIndex = 1 - m_fillIndex;
+    Chunk &next = m_chunks[fillIndex];
+    next.input.resize(0);
+    next.input.append(chunk.input.constData() + complete, chunk.input.size() - complete);
+    chunk.input.resize(complete);
+
+    m_pendingIndex = m_fillIndex;
+    m_fillIndex = fillIndex;
+    m_pending = QtConcurrent::run([this, &chunk]() { convertChunk(chunk); });
+    return true;
+}
+
+/*!
+ * \internal
+ * Waits for the chunk being converted, if any, and writes it to the output device.
+ */
+bool UdUnitStreamConverter::collect()
+{
+    if (m_pendingIndex < 0)
+        return true;
+    m_pending.waitForFinished();
+    Chunk &chunk = m_chunks[m_pendingIndex];
+    m_pendingIndex = -1;
+    m_recordCount += chunk.recordCount;
+    m_invalidFieldCount += chunk.invalidFieldCount;
+
+    const QByteArray &data = m_format == BinaryRecords ? chunk.input : chunk.output;
+    if (m_output->write(data.constData(), data.size()) != data.size()) {
+        setError(m_output->errorString());
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * \internal
+ * Converts all the records of \a chunk, this is run on a worker thread.
+ */
+void UdUnitStreamConverter::convertChunk(Chunk &chunk)
+{
+    chunk.recordCount = 0;
+    chunk.invalidFieldCount = 0;
+    if (m_format == BinaryRecords)
+        convertBinaryChunk(chunk);
+    else
+        convertTextChunk(chunk);
+}
+
+/*!
+ * \internal
+ * Converts fields in place, one field at a time so that each of them goes
+ * through its converter in a single batch.
+ */
+void UdUnitStreamConverter::convertBinaryChunk(Chunk &chunk)
+{
+    const int count = chunk.input.size() / m_recordSize;
+    char *records = chunk.input.data();
+    chunk.values.resize(count);
+    qreal *values = chunk.values.data();
+    for (const Field &field: m_fields) {
+        char *data = records + field.position;
+        for (int i = 0; i < count; ++i, data += m_recordSize)
+            values[i] = decode(data, field.type, m_byteOrder);
+        field.converter.convert(values, values, count);
+        data = records + field.position;
+        for (int i = 0; i < count; ++i, data += m_recordSize)
+            encode(values[i], data, field.type, m_byteOrder);
+    }
+    chunk.recordCount = count;
+}
+
+/*!
+ * \internal
+ * Converts the chunk in three passes: the configured fields of all its lines
+ * are parsed into the chunk's values, each field then goes through its
+ * converter in a single batch, and the lines are finally written to the
+ * chunk's output buffer with the converted values.
+ */
+void UdUnitStreamConverter::convertTextChunk(Chunk &chunk)
+{
+    const char *begin = chunk.input.constData();
+    const char *end = begin + chunk.input.size();
+
+    // Values of a field are contiguous, one per line
+    const int rows = int(std::count(begin, end, '\n')) + 1;
+    chunk.values.resize(rows * m_fields.size());
+    chunk.parsed.fill(false, rows * m_fields.size());
+    qreal *values = chunk.values.data();
+    bool *parsed = chunk.parsed.data();
+    // With reserved capacity, the scratch buffer isn't freed when emptied
+    QByteArray &scratch = chunk.scratch;
+    if (scratch.capacity() < s_numberCapacity)
+        scratch.reserve(s_numberCapacity);
+
+    int headerLinesLeft = m_headerLinesLeft;
+    int row = 0;
+    for (const char *data = begin; data < end;) {
+        const char *fieldsEnd;
+        const char *next;
+        const char *lineEnd = splitLine(data, end, &fieldsEnd, &next);
+        if (headerLinesLeft > 0 || lineEnd == data) {
+            if (lineEnd != data)
+                --headerLinesLeft;
+            data = next;
+            continue;
+        }
+        for (int column = 0;; ++column) {
+            const char *fieldEnd = findDelimiter(data, fieldsEnd, m_delimiter);
+            const int fieldIndex = m_columnFields.value(column) - 1;
+            if (fieldIndex >= 0) {
+                const int slot = fieldIndex * rows + row;
+                values[slot] = parseNumber(data, fieldEnd, scratch, &parsed[slot]);
+                if (!parsed[slot])
+                    ++chunk.invalidFieldCount;
+            }
+            if (fieldEnd == fieldsEnd)
+                break;
+            data = fieldEnd + 1;
+        }
+        ++row;
+        data = next;
+    }
+
+    for (int i = 0; i < m_fields.size(); ++i)
+        m_fields.at(i).converter.convert(values + i * rows, values + i * rows, row);
+
+    QByteArray &output = chunk.output;
+    output.reserve(m_chunkSize + m_chunkSize / 2);
+    output.resize(0);
+    headerLinesLeft = m_headerLinesLeft;
+    row = 0;
+    for (const char *data = begin; data < end;) {
+        const char *fieldsEnd;
+        const char *next;
+        const char *lineEnd = splitLine(data, end, &fieldsEnd, &next);
+        if (headerLinesLeft > 0 || lineEnd == data) {
+            if (lineEnd != data)
+                --headerLinesLeft;
+            output.append(data, int(next - data));
+            data = next;
+            continue;
+        }
+        for (int column = 0;; ++column) {
+            const char *fieldEnd = findDelimiter(data, fieldsEnd, m_delimiter);
+            const int fieldIndex = m_columnFields.value(column) - 1;
+            if (fieldIndex >= 0 && parsed[fieldIndex * rows + row])
+                output.append(QByteArray::number(values[fieldIndex * rows + row], 'g',
+                                                 m_precision));
+            else
+                output.append(data, int(fieldEnd - data));
+            if (fieldEnd == fieldsEnd)
+                break;
+            output.append(m_delimiter);
+            data = fieldEnd + 1;
+        }
+        output.append(fieldsEnd, int(next - fieldsEnd));
+        ++row;
+        data = next;
+    }
+    m_headerLinesLeft = headerLinesLeft;
+    chunk.recordCount = row;
+}
+
+/*!
+ * \internal
+ */
+void UdUnitStreamConverter::setError(const QString &message)
+{
+    m_errorString = message;
+}
@@ -0,0 +1,124 @@
+#ifndef QUDUNITSTREAMCONVERTER_H
+#define QUDUNITSTREAMCONVERTER_H
+
+#include "qudunit_global.h"
+#include "qudunit.h"
+
+#include <QByteArray>
+#include <QFuture>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+class QIODevice;
+
+class QUDUNITSHARED_EXPORT UdUnitStreamConverter
+{
+public:
+    enum RecordFormat {
+        DelimitedText = 0,
+        BinaryRecords
+    };
+
+    enum FieldType {
+        Float32 = 0,
+        Float64,
+        Int16,
+        Int32
+    };
+
+    enum ByteOrder {
+        LittleEndian = 0,
+        BigEndian
+    };
+
+    explicit UdUnitStreamConverter(RecordFormat format = DelimitedText);
+    ~UdUnitStreamConverter();
+
+    RecordFormat recordFormat() const;
+
+    // Delimited text
+    void setDelimiter(char delimiter);
+    char delimiter() const;
+    void setHeaderLineCount(int count);
+    int headerLineCount() const;
+    void setPrecision(int precision);
+    int precision() const;
+    void addField(int column, const UdUnitConverter &converter);
+
+    // Binary records
+    void setRecordSize(int size);
+    int recordSize() const;
+    void setByteOrder(ByteOrder order);
+    ByteOrder byteOrder() const;
+    void addField(int offset, FieldType type, const UdUnitConverter &converter);
+
+    void setChunkSize(int size);
+    int chunkSize() const;
+
+    // Pull interface
+    bool convert(QIODevice *input, QIODevice *output);
+
+    // Push interface
+    bool start(QIODevice *output);
+    bool write(const char *data, qint64 size);
+    bool write(const QByteArray &data);
+    bool finish();
+
+    qint64 recordCount() const;
+    qint64 invalidFieldCount() const;
+    QString errorString() const;
+
+private:
+    Q_DISABLE_COPY(UdUnitStreamConverter)
+
+    struct Field {
+        Field(int position, FieldType type, const UdUnitConverter &converter):
+            position(position), type(type), converter(converter) {}
+        int position;
+        FieldType type;
+        UdUnitConverter converter;
+    };
+
+    struct Chunk {
+        Chunk(): recordCount(0), invalidFieldCount(0) {}
+        QByteArray input;
+        QByteArray output;
+        QVector<qreal> values;
+        // Whether each text field of values has been parsed
+        QVector<bool> parsed;
+        QByteArray scratch;
+        qint64 recordCount;
+        qint64 invalidFieldCount;
+    };
+
+    int completeLength(const QByteArray &data) const;
+    bool dispatch(bool final);
+    bool collect();
+    void convertChunk(Chunk &chunk);
+    void convertBinaryChunk(Chunk &chunk);
+    void convertTextChunk(Chunk &chunk);
+    void setError(const QString &message);
+
+    RecordFormat m_format;
+    char m_delimiter;
+    int m_headerLineCount;
+    int m_headerLinesLeft;
+    int m_precision;
+    int m_recordSize;
+    ByteOrder m_byteOrder;
+    int m_chunkSize;
+    QList<Field> m_fields;
+    QVector<int> m_columnFields;
+
+    QIODevice *m_output;
+    Chunk m_chunks[2];
+    int m_fillIndex;
+    int m_pendingIndex;
+    QFuture<void> m_pending;
+    qint64 m_recordCount;
+    qint64 m_invalidFieldCount;
+    QString m_errorString;
+};
+
+#endif // QUDUNITSTREAMCONVERTER_H
@@ -0,0 +1,912 @@
+#include "qudunittable_p.h"
+#include "qudunit.h"
+#include "qudcompactunit.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QScopedPointer>
+#include <QVector>
+#include <QXmlStreamReader>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef QUDUNIT_BUILTIN_TABLE
+// Generated by tools/udgentable in the build directory, see src.pro
+extern const unsigned char qudBuiltinUnitTable[];
+extern const qint64 qudBuiltinUnitTableSize;
+#endif
+
+namespace {
+
+// "QUDT" in memory on little-endian hosts
+const quint32 s_magic = 0x54445551;
+const quint32 s_version = 1;
+
+template <typename T>
+const T *sectionData(const char *data, quint32 offset)
+{
+    return reinterpret_cast<const T *>(data + offset);
+}
+
+inline char foldCase(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+}
+
+// Names are case-insensitive, as in udunits2, for ASCII letters only
+bool sameName(const char *lhs, const char *rhs)
+{
+    while (*lhs != '\0' && foldCase(*lhs) == foldCase(*rhs)) {
+        ++lhs;
+        ++rhs;
+    }
+    return foldCase(*lhs) == foldCase(*rhs);
+}
+
+QByteArray foldName(const QByteArray &name)
+{
+    QByteArray result(name);
+    for (int i = 0; i < result.size(); ++i)
+        result[i] = foldCase(result.at(i));
+    return result;
+}
+
+}
+
+/*!
+ * \class UdUnitTable
+ * \ingroup index
+ * \preliminary
+ * \brief The UdUnitTable class is a read-only, precompiled image of a unit
+ * database.
+ *
+ * A unit table holds the units of a database as dimension vectors, scales and
+ * offsets, their names and symbols indexed by minimal perfect hash tables,
+ * and the prefixes of the database. UdUnitSystem::loadTable() creates a
+ * unit-system from a table without reading nor parsing any XML, and looks
+ * names and symbols up in the table in constant time.
+ *
+ * A table is a single block of memory without any pointer, so it can be
+ * compiled into a program, mapped from a file or shared between processes as
+ * is. fromDatabase() builds the table of an XML database, and the
+ * \c udgentable tool generates the C++ source of a table. When the library
+ * is configured with \c{CONFIG+=qudunit_builtin_table}, the table of the
+ * default database is generated while building and compiled into the
+ * library: builtin() then returns it, from a read-only section shared by all
+ * the processes using the library.
+ *
+ * Tables are not portable between hosts of different byte orders.
+ *
+ * \sa UdUnitSystem::loadTable(), UdUnitSystem::loadBuiltinDatabase()
+ */
+
+/*!
+ * Constructs an invalid table.
+ */
+UdUnitTable::UdUnitTable():
+    m_data(nullptr), m_size(0)
+{
+
+}
+
+/*!
+ * Constructs a table from the \a size bytes image pointed to by \a data,
+ * which is used in place, without any copy: it must be aligned on 8 bytes
+ * and remain valid as long as the table and the unit-systems loaded from it
+ * are used.
+ * The table is invalid if \a data doesn't hold a valid image.
+ */
+UdUnitTable::UdUnitTable(const char *data, qint64 size):
+    m_data(nullptr), m_size(0)
+{
+    attach(data, size);
+}
+
+/*!
+ * Constructs a table from \a image, which is implicitly shared.
+ * The table is invalid if \a image isn't a valid image.
+ */
+UdUnitTable::UdUnitTable(const QByteArray &image):
+    m_image(image), m_data(nullptr), m_size(0)
+{
+    attach(m_image.constData(), m_image.size());
+    if (m_data == nullptr)
+        m_image.clear();
+}
+
+/*!
+ * Returns the table compiled into the library, or an invalid table if the
+ * library has been configured without it.
+ */
+UdUnitTable UdUnitTable::builtin()
+{
+#ifdef QUDUNIT_BUILTIN_TABLE
+    return UdUnitTable(reinterpret_cast<const char *>(qudBuiltinUnitTable), qudBuiltinUnitTableSize);
+#else
+    return UdUnitTable();
+#endif
+}
+
+/*!
+ * Returns true if this table holds a valid image, false otherwise.
+ */
+bool UdUnitTable::isValid() const
+{
+    return m_data != nullptr;
+}
+
+/*!
+ * Returns the error which prevented this table from being built or
+ * attached, if any.
+ */
+UdError UdUnitTable::error() const
+{
+    return m_error;
+}
+
+/*!
+ * Returns the UdUnitSystem::fingerprint() of the database this table has
+ * been built from, or 0 if this table is invalid.
+ */
+quint64 UdUnitTable::fingerprint() const
+{
+    return m_data != nullptr ? header()->fingerprint : 0;
+}
+
+/*!
+ * Returns a pointer to the image of this table, or nullptr if this table is
+ * invalid.
+ */
+const char *UdUnitTable::data() const
+{
+    return m_data;
+}
+
+/*!
+ * Returns the size in bytes of the image of this table.
+ */
+qint64 UdUnitTable::size() const
+{
+    return m_size;
+}
+
+/*!
+ * Returns the image of this table. The image is copied unless this table
+ * owns it.
+ */
+QByteArray UdUnitTable::image() const
+{
+    if (!m_image.isEmpty() || m_data == nullptr)
+        return m_image;
+    return QByteArray(m_data, int(m_size));
+}
+
+/*!
+ * Returns the number of units in this table.
+ */
+int UdUnitTable::unitCount() const
+{
+    return m_data != nullptr ? int(header()->units.count) : 0;
+}
+
+/*!
+ * Returns the number of names in this table, plural forms and aliases
+ * included.
+ */
+int UdUnitTable::nameCount() const
+{
+    return m_data != nullptr ? int(header()->names.count) : 0;
+}
+
+/*!
+ * Returns the number of symbols in this table, aliases included.
+ */
+int UdUnitTable::symbolCount() const
+{
+    return m_data != nullptr ? int(header()->symbols.count) : 0;
+}
+
+/*!
+ * Returns the number of prefix names and symbols in this table.
+ */
+int UdUnitTable::prefixCount() const
+{
+    return m_data != nullptr ? int(header()->prefixes.count) : 0;
+}
+
+/*!
+ * Returns the index of the unit \a name maps to, or -1 if there is none.
+ * \a name is a null-terminated UTF-8 string, compared case-insensitively.
+ * Prefixed names are not looked up.
+ */
+int UdUnitTable::unitIndexByName(const char *name) const
+{
+    return find(name, true);
+}
+
+/*!
+ * Returns the index of the unit \a symbol maps to, or -1 if there is none.
+ * \a symbol is a null-terminated UTF-8 string.
+ * Prefixed symbols are not looked up.
+ */
+int UdUnitTable::unitIndexBySymbol(const char *symbol) const
+{
+    return find(symbol, false);
+}
+
+/*!
+ * \internal
+ * Makes this table refer to the \a size bytes pointed to by \a data, if they
+ * hold a valid image.
+ */
+void UdUnitTable::attach(const char *data, qint64 size)
+{
+    m_data = data;
+    m_size = size;
+    if (!validate()) {
+        m_data = nullptr;
+        m_size = 0;
+        m_error = UdError(UdError::ParseError);
+    }
+}
+
+/*!
+ * \internal
+ * Checks that all the sections, indexes and string offsets of the image are
+ * within bounds, so that lookups don't have to.
+ */
+bool UdUnitTable::validate() const
+{
+    if (m_data == nullptr || m_size < qint64(sizeof(Header)) || quintptr(m_data) % 8 != 0)
+        return false;
+    const Header *h = header();
+    if (h->magic != s_magic || h->version != s_version || h->size > quint64(m_size))
+        return false;
+
+    const quint64 size = h->size;
+    auto fits = [size](const Section &section, size_t recordSize) {
+        return section.offset % 8 == 0
+                && quint64(section.offset) + quint64(section.count) * recordSize <= size;
+    };
+    if (!fits(h->bases, sizeof(Base)) || !fits(h->units, sizeof(Unit))
+            || !fits(h->factors, sizeof(Factor)) || !fits(h->prefixes, sizeof(Prefix))
+            || !fits(h->names, sizeof(Identifier)) || !fits(h->nameDisplacements, sizeof(qint32))
+            || !fits(h->symbols, sizeof(Identifier)) || !fits(h->symbolDisplacements, sizeof(qint32))
+            || !fits(h->strings, 1))
+        return false;
+    if (h->nameDisplacements.count != h->names.count
+            || h->symbolDisplacements.count != h->symbols.count)
+        return false;
+
+    const quint32 stringSize = h->strings.count;
+    const char *strings = m_data + h->strings.offset;
+    if (stringSize == 0 || strings[0] != '\0' || strings[stringSize - 1] != '\0')
+        return false;
+
+    const Base *bases = this->bases();
+    for (quint32 i = 0; i < h->bases.count; ++i) {
+        if (bases[i].identifier >= stringSize)
+            return false;
+    }
+    const Unit *units = this->units();
+    for (quint32 i = 0; i < h->units.count; ++i) {
+        if (quint64(units[i].firstFactor) + units[i].factorCount > h->factors.count
+                || units[i].definition >= stringSize)
+            return false;
+    }
+    const Factor *factors = this->factors();
+    for (quint32 i = 0; i < h->factors.count; ++i) {
+        if (factors[i].base >= h->bases.count)
+            return false;
+    }
+    const Prefix *prefixes = this->prefixes();
+    for (quint32 i = 0; i < h->prefixes.count; ++i) {
+        if (prefixes[i].identifier >= stringSize)
+            return false;
+    }
+
+    const Section *indexes[][2] = {
+        { &h->names, &h->nameDisplacements },
+        { &h->symbols, &h->symbolDisplacements }
+    };
+    for (const auto &index: indexes) {
+        const quint32 count = index[0]->count;
+        const Identifier *identifiers = sectionData<Identifier>(m_data, index[0]->offset);
+        const qint32 *displacements = sectionData<qint32>(m_data, index[1]->offset);
+        for (quint32 i = 0; i < count; ++i) {
+            if (identifiers[i].text >= stringSize || identifiers[i].unit >= h->units.count)
+                return false;
+            if (displacements[i] < 0 && quint32(-(displacements[i] + 1)) >= count)
+                return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ * \internal
+ */
+const UdUnitTable::Header *UdUnitTable::header() const
+{
+    return reinterpret_cast<const Header *>(m_data);
+}
+
+/*!
+ * \internal
+ */
+const UdUnitTable::Base *UdUnitTable::bases() const
+{
+    return sectionData<Base>(m_data, header()->bases.offset);
+}
+
+/*!
+ * \internal
+ */
+const UdUnitTable::Unit *UdUnitTable::units() const
+{
+    return sectionData<Unit>(m_data, header()->units.offset);
+}
+
+/*!
+ * \internal
+ */
+const UdUnitTable::Factor *UdUnitTable::factors() const
+{
+    return sectionData<Factor>(m_data, header()->factors.offset);
+}
+
+/*!
+ * \internal
+ */
+const UdUnitTable::Prefix *UdUnitTable::prefixes() const
+{
+    return sectionData<Prefix>(m_data, header()->prefixes.offset);
+}
+
+/*!
+ * \internal
+ */
+const UdUnitTable::Identifier *UdUnitTable::names() const
+{
+    return sectionData<Identifier>(m_data, header()->names.offset);
+}
+
+/*!
+ * \internal
+ */
+const UdUnitTable::Identifier *UdUnitTable::symbols() const
+{
+    return sectionData<Identifier>(m_data, header()->symbols.offset);
+}
+
+/*!
+ * \internal
+ * Returns the string at \a offset in the string section.
+ */
+const char *UdUnitTable::string(quint32 offset) const
+{
+    return m_data + header()->strings.offset + offset;
+}
+
+/*!
+ * \internal
+ * Looks \a text up in the name or symbol index: the bucket of \a text gives
+ * either the slot of its only key, or the seed of the hash giving the slots
+ * of all its keys.
+ */
+int UdUnitTable::find(const char *text, bool isName) const
+{
+    if (m_data == nullptr || text == nullptr)
+        return -1;
+    const Header *h = header();
+    const quint32 count = isName ? h->names.count : h->symbols.count;
+    if (count == 0)
+        return -1;
+    const qint32 *displacements = sectionData<qint32>(m_data, isName ? h->nameDisplacements.offset
+                                                                     : h->symbolDisplacements.offset);
+    const qint32 displacement = displacements[hash(text, 0, isName) % count];
+    const quint32 slot = displacement < 0 ? quint32(-(displacement + 1))
+                                          : hash(text, quint32(displacement), isName) % count;
+    const Identifier &identifier = (isName ? names() : symbols())[slot];
+    const char *key = string(identifier.text);
+    if (isName ? !sameName(key, text) : std::strcmp(key, text) != 0)
+        return -1;
+    return int(identifier.unit);
+}
+
+/*!
+ * \internal
+ * Seeded 32-bit FNV-1a of \a text, followed by a finalizer so that the low
+ * bits are usable as is. Names are hashed case-insensitively.
+ */
+quint32 UdUnitTable::hash(const char *text, quint32 seed, bool isName)
+{
+    quint32 hash = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (; *text != '\0'; ++text) {
+        hash ^= quint8(isName ? foldCase(*text) : *text);
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/*!
+ * \internal
+ * Builds the image of a unit table from an XML database. The identifiers
+ * and prefixes are read from the XML files, the units are obtained from the
+ * database loaded by \UU, so that they are exactly the ones \UU defines.
+ */
+struct UdUnitTableBuilder
+{
+    struct XmlIdentifier
+    {
+        QByteArray text;
+        quint32 flags;
+    };
+
+    struct XmlUnit
+    {
+        QVector<XmlIdentifier> identifiers;
+    };
+
+    struct XmlPrefix
+    {
+        double value;
+        QByteArray text;
+        bool isSymbol;
+    };
+
+    struct Key
+    {
+        QByteArray text;
+        UdUnitTable::Identifier identifier;
+    };
+
+    UdError readFile(const QString &path);
+    void readUnit(QXmlStreamReader &xml);
+    void readName(QXmlStreamReader &xml, XmlUnit &unit, bool isPrimary);
+    void readPrefix(QXmlStreamReader &xml);
+    UdUnitTable build(const QString &pathname);
+    quint32 baseIndex(const QString &identifier);
+    quint32 addString(const QByteArray &text);
+    void addKey(QVector<Key> &keys, QHash<QByteArray, int> &indexes, const QByteArray &text,
+                quint32 unit, quint32 flags, bool isName);
+    static bool perfectHash(QVector<Key> &keys, QVector<qint32> &displacements, bool isName);
+    template <typename T>
+    static UdUnitTable::Section appendSection(QByteArray &image, const T *records, int count);
+    static QByteArray formPlural(const QByteArray &singular);
+
+    const UdUnitSystem *system;
+    QVector<XmlUnit> xmlUnits;
+    QVector<XmlPrefix> xmlPrefixes;
+    QVector<UdUnitTable::Base> bases;
+    QHash<QString, quint32> baseIndexes;
+    QByteArray strings;
+    QHash<QByteArray, quint32> stringOffsets;
+};
+
+/*!
+ * \internal
+ * Reads the units and prefixes of the XML file at \a path, and of the files
+ * it imports.
+ */
+UdError UdUnitTableBuilder::readFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return UdError(UdError::OpenArgumentError);
+    QXmlStreamReader xml(&file);
+    if (!xml.readNextStartElement() || xml.name() != QLatin1String("unit-system"))
+        return UdError(UdError::ParseError);
+    while (xml.readNextStartElement()) {
+        if (xml.name() == QLatin1String("import")) {
+            const QString imported = xml.readElementText().trimmed();
+            const UdError error = readFile(QFileInfo(path).dir().filePath(imported));
+            if (error.isError())
+                return error;
+        } else if (xml.name() == QLatin1String("unit")) {
+            readUnit(xml);
+        } else if (xml.name() == QLatin1String("prefix")) {
+            readPrefix(xml);
+        } else {
+            xml.skipCurrentElement();
+        }
+    }
+    return xml.hasError() ? UdError(UdError::ParseError) : UdError();
+}
+
+/*!
+ * \internal
+ * Reads the identifiers of a <unit> element. The first name and the first
+ * symbol are the ones the unit is formatted with, aliases are not.
+ */
+void UdUnitTableBuilder::readUnit(QXmlStreamReader &xml)
+{
+    XmlUnit unit;
+    bool hasName = false;
+    bool hasSymbol = false;
+    while (xml.readNextStartElement()) {
+        if (xml.name() == QLatin1String("name")) {
+            readName(xml, unit, !hasName);
+            hasName = true;
+        } else if (xml.name() == QLatin1String("symbol")) {
+            const XmlIdentifier symbol = {
+                xml.readElementText().trimmed().toUtf8(),
+                quint32(UdUnitTable::SymbolFlag | (hasSymbol ? 0 : UdUnitTable::PrimaryFlag))
+            };
+            unit.identifiers.append(symbol);
+            hasSymbol = true;
+        } else if (xml.name() == QLatin1String("aliases")) {
+            while (xml.readNextStartElement()) {
+                if (xml.name() == QLatin1String("name")) {
+                    readName(xml, unit, false);
+                } else if (xml.name() == QLatin1String("symbol")) {
+                    const XmlIdentifier symbol = {
+                        xml.readElementText().trimmed().toUtf8(), quint32(UdUnitTable::SymbolFlag)
+                    };
+                    unit.identifiers.append(symbol);
+                } else {
+                    xml.skipCurrentElement();
+                }
+            }
+        } else {
+            xml.skipCurrentElement();
+        }
+    }
+    if (!unit.identifiers.isEmpty())
+        xmlUnits.append(unit);
+}
+
+/*!
+ * \internal
+ * Reads a <name> element, with its plural form, explicit or not.
+ */
+void UdUnitTableBuilder::readName(QXmlStreamReader &xml, XmlUnit &unit, bool isPrimary)
+{
+    QByteArray singular;
+    QByteArray plural;
+    bool hasPlural = true;
+    while (xml.readNextStartElement()) {
+        if (xml.name() == QLatin1String("singular")) {
+            singular = xml.readElementText().trimmed().toUtf8();
+        } else if (xml.name() == QLatin1String("plural")) {
+            plural = xml.readElementText().trimmed().toUtf8();
+        } else {
+            if (xml.name() == QLatin1String("noplural"))
+                hasPlural = false;
+            xml.skipCurrentElement();
+        }
+    }
+    if (singular.isEmpty())
+        return;
+    const XmlIdentifier name = { singular, quint32(isPrimary ? UdUnitTable::PrimaryFlag : 0) };
+    unit.identifiers.append(name);
+    if (hasPlural) {
+        const XmlIdentifier pluralName = { plural.isEmpty() ? formPlural(singular) : plural, 0 };
+        unit.identifiers.append(pluralName);
+    }
+}
+
+/*!
+ * \internal
+ * Reads a <prefix> element.
+ */
+void UdUnitTableBuilder::readPrefix(QXmlStreamReader &xml)
+{
+    double value = 0.0;
+    QVector<XmlPrefix> identifiers;
+    while (xml.readNextStartElement()) {
+        if (xml.name() == QLatin1String("value")) {
+            value = xml.readElementText().trimmed().toDouble();
+        } else if (xml.name() == QLatin1String("name") || xml.name() == QLatin1String("symbol")) {
+            const XmlPrefix prefix = { 0.0, QByteArray(), xml.name() == QLatin1String("symbol") };
+            identifiers.append(prefix);
+            identifiers.last().text = xml.readElementText().trimmed().toUtf8();
+        } else {
+            xml.skipCurrentElement();
+        }
+    }
+    for (XmlPrefix &prefix: identifiers) {
+        prefix.value = value;
+        if (value != 0.0 && !prefix.text.isEmpty())
+            xmlPrefixes.append(prefix);
+    }
+}
+
+/*!
+ * \internal
+ * Returns the plural form of \a singular, formed as \UU does when the
+ * database doesn't specify it.
+ */
+QByteArray UdUnitTableBuilder::formPlural(const QByteArray &singular)
+{
+    if (singular.endsWith('s') || singular.endsWith('x') || singular.endsWith('z')
+            || singular.endsWith("ch") || singular.endsWith("sh"))
+        return singular + "es";
+    if (singular.endsWith('y') && singular.size() > 1
+            && !QByteArray("aeiou").contains(singular.at(singular.size() - 2)))
+        return singular.left(singular.size() - 1) + "ies";
+    return singular + 's';
+}
+
+/*!
+ * \internal
+ * Returns the index of the base unit with the given \a identifier, adding it
+ * if needed.
+ */
+quint32 UdUnitTableBuilder::baseIndex(const QString &identifier)
+{
+    const QHash<QString, quint32>::const_iterator found = baseIndexes.constFind(identifier);
+    if (found != baseIndexes.constEnd())
+        return found.value();
+    const UdUnit bySymbol = system->unitBySymbol(identifier);
+    const UdUnit unit = bySymbol.isValid() ? bySymbol : system->unitByName(identifier);
+    UdUnitTable::Base base = { addString(identifier.toUtf8()), 0 };
+    if (bySymbol.isValid())
+        base.flags |= UdUnitTable::SymbolFlag;
+    if (UdCompactUnit(unit).isDimensionless())
+        base.flags |= UdUnitTable::DimensionlessFlag;
+    const quint32 index = quint32(bases.size());
+    bases.append(base);
+    baseIndexes.insert(identifier, index);
+    return index;
+}
+
+/*!
+ * \internal
+ * Returns the offset of \a text in the string section, adding it if needed.
+ */
+quint32 UdUnitTableBuilder::addString(const QByteArray &text)
+{
+    if (text.isEmpty())
+        return 0;
+    const QHash<QByteArray, quint32>::const_iterator found = stringOffsets.constFind(text);
+    if (found != stringOffsets.constEnd())
+        return found.value();
+    const quint32 offset = quint32(strings.size());
+    strings.append(text);
+    strings.append('\0');
+    stringOffsets.insert(text, offset);
+    return offset;
+}
+
+/*!
+ * \internal
+ * Adds the identifier \a text of \a unit to \a keys, unless an identifier
+ * equal to it, case-insensitively for names, has already been added.
+ */
+void UdUnitTableBuilder::addKey(QVector<Key> &keys, QHash<QByteArray, int> &indexes,
+                                const QByteArray &text, quint32 unit, quint32 flags, bool isName)
+{
+    const QByteArray folded = isName ? foldName(text) : text;
+    if (indexes.contains(folded))
+        return;
+    indexes.insert(folded, keys.size());
+    const Key key = { text, { addString(text), unit, flags } };
+    keys.append(key);
+}
+
+/*!
+ * \internal
+ * Orders \a keys into the slots of a minimal perfect hash table ("hash,
+ * displace and compress"): keys are spread into as many buckets as there are
+ * keys, then the largest buckets are placed first by looking for a hash seed
+ * giving free slots to all their keys, and single key buckets take the
+ * remaining free slots directly. Returns false if no seed could be found.
+ */
+bool UdUnitTableBuilder::perfectHash(QVector<Key> &keys, QVector<qint32> &displacements,
+                                     bool isName)
+{
+    const int count = keys.size();
+    displacements.fill(0, count);
+    if (count == 0)
+        return true;
+
+    QVector<QVector<int> > buckets(count);
+    for (int i = 0; i < count; ++i)
+        buckets[UdUnitTable::hash(keys.at(i).text.constData(), 0, isName) % quint32(count)].append(i);
+    QVector<int> order(count);
+    for (int i = 0; i < count; ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&buckets](int lhs, int rhs) {
+        return buckets.at(lhs).size() > buckets.at(rhs).size();
+    });
+
+    QVector<int> slotKeys(count, -1);
+    QVector<quint32> candidates;
+    int next = 0;
+    for (int bucket: order) {
+        const QVector<int> &members = buckets.at(bucket);
+        if (members.size() > 1) {
+            quint32 seed = 1;
+            for (; seed < (1u << 24); ++seed) {
+                candidates.clear();
+                bool free = true;
+                for (int key: members) {
+                    const quint32 slot = UdUnitTable::hash(keys.at(key).text.constData(), seed, isName)
+                            % quint32(count);
+                    if (slotKeys.at(int(slot)) != -1 || candidates.contains(slot)) {
+                        free = false;
+                        break;
+                    }
+                    candidates.append(slot);
+                }
+                if (free)
+                    break;
+            }
+            if (seed == (1u << 24))
+                return false;
+            for (int i = 0; i < members.size(); ++i)
+                slotKeys[int(candidates.at(i))] = members.at(i);
+            displacements[bucket] = qint32(seed);
+        } else if (members.size() == 1) {
+            while (slotKeys.at(next) != -1)
+                ++next;
+            slotKeys[next] = members.first();
+            displacements[bucket] = -next - 1;
+        }
+    }
+
+    QVector<Key> ordered(count);
+    for (int slot = 0; slot < count; ++slot)
+        ordered[slot] = keys.at(slotKeys.at(slot));
+    keys = ordered;
+    return true;
+}
+
+/*!
+ * \internal
+ * Appends the \a count \a records to \a image, aligned on 8 bytes.
+ */
+template <typename T>
+UdUnitTable::Section UdUnitTableBuilder::appendSection(QByteArray &image, const T *records, int count)
+{
+    while (image.size() % 8 != 0)
+        image.append('\0');
+    const UdUnitTable::Section section = { quint32(image.size()), quint32(count) };
+    image.append(reinterpret_cast<const char *>(records), int(count * sizeof(T)));
+    return section;
+}
+
+/*!
+ * \internal
+ */
+UdUnitTable UdUnitTableBuilder::build(const QString &pathname)
+{
+    UdUnitTable result;
+    QScopedPointer<UdUnitSystem> loaded(UdUnitSystem::loadDatabase(pathname));
+    if (!loaded->isValid()) {
+        result.m_error = loaded->error();
+        return result;
+    }
+    system = loaded.data();
+
+    const QByteArray requested = pathname.toUtf8();
+    ut_status status = UT_SUCCESS;
+    const char *path = ut_get_path_xml(requested.isEmpty() ? nullptr : requested.constData(), &status);
+    const UdError error = readFile(QString::fromUtf8(path));
+    if (error.isError()) {
+        result.m_error = error;
+        return result;
+    }
+
+    strings = QByteArray(1, '\0');
+    QVector<UdUnitTable::Unit> units;
+    QVector<UdUnitTable::Factor> factors;
+    QVector<Key> names;
+    QVector<Key> symbols;
+    QHash<QByteArray, int> nameIndexes;
+    QHash<QByteArray, int> symbolIndexes;
+    for (const XmlUnit &xmlUnit: xmlUnits) {
+        UdUnit unit;
+        for (const XmlIdentifier &identifier: xmlUnit.identifiers) {
+            unit = (identifier.flags & UdUnitTable::SymbolFlag) ? system->unitBySymbol(identifier.text)
+                                                                : system->unitByName(identifier.text);
+            if (unit.isValid())
+                break;
+        }
+        if (!unit.isValid())
+            continue;
+
+        UdUnitTable::Unit record = { 1.0, 0.0, quint32(factors.size()), 0, 0, 0 };
+        const UdCompactUnit compact(unit);
+        if (compact.isValid()) {
+            record.scale = compact.scale();
+            record.offset = compact.offset();
+            record.factorCount = quint32(compact.baseUnitCount());
+            for (int i = 0; i < compact.baseUnitCount(); ++i) {
+                const UdUnitTable::Factor factor = {
+                    baseIndex(compact.baseUnitIdentifier(i)), compact.basePower(i)
+                };
+                factors.append(factor);
+            }
+        } else {
+            record.definition = addString(system->canonicalForm(unit).toLatin1());
+            if (record.definition == 0)
+                continue;
+        }
+        const quint32 index = quint32(units.size());
+        units.append(record);
+
+        // Only the identifiers \UU maps to this very unit, eg. not guessed
+        // plural forms it doesn't know
+        for (const XmlIdentifier &identifier: xmlUnit.identifiers) {
+            const bool isSymbol = identifier.flags & UdUnitTable::SymbolFlag;
+            const UdUnit mapped = isSymbol ? system->unitBySymbol(identifier.text)
+                                           : system->unitByName(identifier.text);
+            if (!mapped.isValid() || mapped != unit)
+                continue;
+            const quint32 flags = identifier.flags & UdUnitTable::PrimaryFlag;
+            if (isSymbol)
+                addKey(symbols, symbolIndexes, identifier.text, index, flags, false);
+            else
+                addKey(names, nameIndexes, identifier.text, index, flags, true);
+        }
+    }
+
+    QVector<UdUnitTable::Prefix> prefixes;
+    for (const XmlPrefix &xmlPrefix: xmlPrefixes) {
+        const UdUnitTable::Prefix prefix = {
+            xmlPrefix.value, addString(xmlPrefix.text),
+            quint32(xmlPrefix.isSymbol ? UdUnitTable::SymbolFlag : 0)
+        };
+        prefixes.append(prefix);
+    }
+
+    QVector<qint32> nameDisplacements;
+    QVector<qint32> symbolDisplacements;
+    if (!perfectHash(names, nameDisplacements, true)
+            || !perfectHash(symbols, symbolDisplacements, false)) {
+        result.m_error = UdError(UdError::ExistingIdentifierError);
+        return result;
+    }
+    QVector<UdUnitTable::Identifier> nameRecords;
+    for (const Key &key: names)
+        nameRecords.append(key.identifier);
+    QVector<UdUnitTable::Identifier> symbolRecords;
+    for (const Key &key: symbols)
+        symbolRecords.append(key.identifier);
+
+    UdUnitTable::Header header;
+    std::memset(&header, 0, sizeof(header));
+    QByteArray image(sizeof(header), '\0');
+    header.magic = s_magic;
+    header.version = s_version;
+    header.fingerprint = system->fingerprint();
+    header.bases = appendSection(image, bases.constData(), bases.size());
+    header.units = appendSection(image, units.constData(), units.size());
+    header.factors = appendSection(image, factors.constData(), factors.size());
+    header.prefixes = appendSection(image, prefixes.constData(), prefixes.size());
+    header.names = appendSection(image, nameRecords.constData(), nameRecords.size());
+    header.nameDisplacements = appendSection(image, nameDisplacements.constData(),
+                                             nameDisplacements.size());
+    header.symbols = appendSection(image, symbolRecords.constData(), symbolRecords.size());
+    header.symbolDisplacements = appendSection(image, symbolDisplacements.constData(),
+                                               symbolDisplacements.size());
+    header.strings = appendSection(image, strings.constData(), strings.size());
+    header.size = quint64(image.size());
+    std::memcpy(image.data(), &header, sizeof(header));
+    return UdUnitTable(image);
+}
+
+/*!
+ * Builds the table of the XML database specified by \a pathname, or of the
+ * default database if \a pathname is empty, see
+ * UdUnitSystem::loadDatabase().
+ *
+ * The units are the ones \UU loads from the database, the identifiers and
+ * prefixes are read from its XML files. If the database can't be loaded nor
+ * read, an invalid table is returned, and error() tells why.
+ */
+UdUnitTable UdUnitTable::fromDatabase(const QString &pathname)
+{
+    UdUnitTableBuilder builder;
+    return builder.build(pathname);
+}
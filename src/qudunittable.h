@@ -0,0 +1,75 @@
+#ifndef QUDUNITTABLE_H
+#define QUDUNITTABLE_H
+
+#include "qudunit_global.h"
+#include "quderror.h"
+
+#include <QByteArray>
+#include <QString>
+
+class QUDUNITSHARED_EXPORT UdUnitTable
+{
+public:
+    UdUnitTable();
+    UdUnitTable(const char *data, qint64 size);
+    explicit UdUnitTable(const QByteArray &image);
+
+    static UdUnitTable builtin();
+    static UdUnitTable fromDatabase(const QString &pathname = QString());
+
+    bool isValid() const;
+    UdError error() const;
+    quint64 fingerprint() const;
+
+    const char *data() const;
+    qint64 size() const;
+    QByteArray image() const;
+
+    int unitCount() const;
+    int nameCount() const;
+    int symbolCount() const;
+    int prefixCount() const;
+
+    int unitIndexByName(const char *name) const;
+    int unitIndexBySymbol(const char *symbol) const;
+
+private:
+    friend class UdUnitSystem;
+    friend struct UdUnitTableBuilder;
+
+    struct Section;
+    struct Header;
+    struct Base;
+    struct Unit;
+    struct Factor;
+    struct Prefix;
+    struct Identifier;
+
+    enum {
+        SymbolFlag = 0x1,
+        DimensionlessFlag = 0x2,
+        PrimaryFlag = 0x4
+    };
+
+    void attach(const char *data, qint64 size);
+    bool validate() const;
+    const Header *header() const;
+    const Base *bases() const;
+    const Unit *units() const;
+    const Factor *factors() const;
+    const Prefix *prefixes() const;
+    const Identifier *names() const;
+    const Identifier *symbols() const;
+    const char *string(quint32 offset) const;
+    int find(const char *text, bool isName) const;
+
+    static quint32 hash(const char *text, quint32 seed, bool isName);
+
+    // Owned image, if any; m_data points into it or to external memory
+    QByteArray m_image;
+    const char *m_data;
+    qint64 m_size;
+    UdError m_error;
+};
+
+#endif // QUDUNITTABLE_H
@@ -0,0 +1,86 @@
+#ifndef QUDUNITTABLE_P_H
+#define QUDUNITTABLE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the qudunits API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include "qudunittable.h"
+
+// Layout of a unit table image. An image is a single block of memory, made
+// of a header followed by sections. Sections refer to each other by index
+// and to strings by offset, never by address, so that an image can be
+// compiled in, mapped from a file or shared between processes as is.
+// Sections are aligned on 8 bytes, integers are in the native byte order.
+
+struct UdUnitTable::Section
+{
+    quint32 offset; // from the start of the image
+    quint32 count;  // of records
+};
+
+struct UdUnitTable::Header
+{
+    quint32 magic;       // UdUnitTable magic number, also tells the byte order
+    quint32 version;
+    quint64 fingerprint; // UdUnitSystem::fingerprint() of the database
+    quint64 size;        // of the whole image
+    Section bases;       // Base records
+    Section units;       // Unit records
+    Section factors;     // Factor records, referred to by units
+    Section prefixes;    // Prefix records
+    Section names;       // Identifier records, in perfect hash order
+    Section nameDisplacements;   // qint32, one per name
+    Section symbols;     // Identifier records, in perfect hash order
+    Section symbolDisplacements; // qint32, one per symbol
+    Section strings;     // Null-terminated UTF-8 strings, starting with ""
+};
+
+// A base unit, from which units are derived
+struct UdUnitTable::Base
+{
+    quint32 identifier; // string offset
+    quint32 flags;      // SymbolFlag, DimensionlessFlag
+};
+
+// A unit: value in base units = scale * (value + offset), where the base
+// units are the product of the factors. Units which can't be expressed that
+// way have a definition, parsed instead.
+struct UdUnitTable::Unit
+{
+    double scale;
+    double offset;
+    quint32 firstFactor;
+    quint32 factorCount;
+    quint32 definition; // string offset, 0 if none
+    quint32 reserved;
+};
+
+struct UdUnitTable::Factor
+{
+    quint32 base;
+    qint32 power;
+};
+
+struct UdUnitTable::Prefix
+{
+    double value;
+    quint32 identifier; // string offset
+    quint32 flags;      // SymbolFlag
+};
+
+// A name or a symbol mapped to a unit. Primary identifiers are also used to
+// format the unit.
+struct UdUnitTable::Identifier
+{
+    quint32 text; // string offset
+    quint32 unit;
+    quint32 flags; // PrimaryFlag
+};
+
+#endif // QUDUNITTABLE_P_H
@@ -0,0 +1,355 @@
+#include "qudunittranslator.h"
+#include "qudinstrumentation_p.h"
+
+/*!
+ * \class UdUnitTranslator
+ * \ingroup index
+ * \preliminary
+ * \brief The UdUnitTranslator class translates units from a unit-system to another.
+ *
+ * Units of different unit-systems neither compare equal nor convert to each
+ * other. A translator rebuilds a unit of its source unit-system in its target
+ * unit-system: the unit is decomposed into the base units it is made of, each
+ * base unit is looked up in the target unit-system by its symbol, or by its
+ * name if it has no symbol, and the unit is built again from the translated base
+ * units with the same powers, scale factor, offset, time origin or logarithm
+ * base. Unlike formatting the unit and parsing it again in the target
+ * unit-system, no precision is lost and no parsing is involved.
+ *
+ * This works as long as the base units of the source unit-system are defined
+ * in the target unit-system under the same identifiers, which is the case of
+ * unit-systems loaded from databases extending the same set of base units:
+ * \code
+ * QScopedPointer<UdUnitSystem> common(UdUnitSystem::loadDatabase());
+ * QScopedPointer<UdUnitSystem> customer(UdUnitSystem::loadDatabase(customerDatabase));
+ * UdUnitTranslator translator(customer.data(), common.data());
+ * UdUnitConverter converter = translator.converter(customer->unitFromString(column),
+ *                                                  common->unitBySymbol("m/s"));
+ * \endcode
+ *
+ * Translations are cached by the translator, keyed on the structure of the
+ * source unit rather than on its textual representation, so that translating
+ * the same unit again costs a lookup in the cache and a copy of the unit.
+ *
+ * The unit-systems must outlive the translator. Like unit-systems, a
+ * translator must not be used concurrently from several threads.
+ *
+ * \sa UdUnitSystem
+ */
+
+namespace {
+
+template <typename T>
+void appendRaw(QByteArray &key, const T &value)
+{
+    key.append(reinterpret_cast<const char *>(&value), int(sizeof(value)));
+}
+
+// The identifiers of a base unit are owned by its unit-system, their
+// addresses identify the base unit for the lifetime of the unit-system.
+const char *identifierOf(const ut_unit *unit)
+{
+    const char *identifier = ut_get_symbol(unit, UT_UTF8);
+    if (identifier == nullptr)
+        identifier = ut_get_name(unit, UT_UTF8);
+    return identifier;
+}
+
+ut_unit *replace(ut_unit *unit, ut_unit *result)
+{
+    ut_free(unit);
+    return result;
+}
+
+}
+
+/*!
+ * \internal
+ * Computes the cache key of a unit and translates it.
+ */
+struct UdUnitTranslatorVisitor
+{
+    struct Translation
+    {
+        const UdUnitTranslator *translator;
+        ut_unit *result;
+    };
+
+    static ut_status keyBasic(const ut_unit *unit, void *arg)
+    {
+        QByteArray *key = static_cast<QByteArray *>(arg);
+        const char *identifier = identifierOf(unit);
+        if (identifier == nullptr)
+            return UT_VISIT_ERROR;
+        key->append('b');
+        appendRaw(*key, identifier);
+        return UT_SUCCESS;
+    }
+
+    static ut_status keyProduct(const ut_unit *unit, int count, const ut_unit *const *basicUnits,
+                                const int *powers, void *arg)
+    {
+        Q_UNUSED(unit);
+        QByteArray *key = static_cast<QByteArray *>(arg);
+        key->append('p');
+        for (int i = 0; i < count; ++i) {
+            const char *identifier = identifierOf(basicUnits[i]);
+            if (identifier == nullptr)
+                return UT_VISIT_ERROR;
+            appendRaw(*key, identifier);
+            appendRaw(*key, powers[i]);
+        }
+        return UT_SUCCESS;
+    }
+
+    static ut_status keyGalilean(const ut_unit *unit, double scale, const ut_unit *underlyingUnit,
+                                 double origin, void *arg)
+    {
+        Q_UNUSED(unit);
+        QByteArray *key = static_cast<QByteArray *>(arg);
+        key->append('g');
+        appendRaw(*key, scale);
+        appendRaw(*key, origin);
+        return ut_accept_visitor(underlyingUnit, &keyVisitor, arg);
+    }
+
+    static ut_status keyTimestamp(const ut_unit *unit, const ut_unit *timeUnit,
+                                  double origin, void *arg)
+    {
+        Q_UNUSED(unit);
+        QByteArray *key = static_cast<QByteArray *>(arg);
+        key->append('t');
+        appendRaw(*key, origin);
+        return ut_accept_visitor(timeUnit, &keyVisitor, arg);
+    }
+
+    static ut_status keyLogarithmic(const ut_unit *unit, double base,
+                                    const ut_unit *reference, void *arg)
+    {
+        Q_UNUSED(unit);
+        QByteArray *key = static_cast<QByteArray *>(arg);
+        key->append('l');
+        appendRaw(*key, base);
+        return ut_accept_visitor(reference, &keyVisitor, arg);
+    }
+
+    static ut_status translateBasic(const ut_unit *unit, void *arg)
+    {
+        Translation *translation = static_cast<Translation *>(arg);
+        translation->result = translation->translator->translateBasic(unit);
+        return translation->result != nullptr ? UT_SUCCESS : UT_VISIT_ERROR;
+    }
+
+    static ut_status translateProduct(const ut_unit *unit, int count, const ut_unit *const *basicUnits,
+                                      const int *powers, void *arg)
+    {
+        Q_UNUSED(unit);
+        Translation *translation = static_cast<Translation *>(arg);
+        ut_unit *result = ut_get_dimensionless_unit_one(translation->translator->m_targetSystem);
+        for (int i = 0; i < count && result != nullptr; ++i) {
+            ut_unit *base = translation->translator->translateBasic(basicUnits[i]);
+            if (base == nullptr) {
+                ut_free(result);
+                return UT_VISIT_ERROR;
+            }
+            if (powers[i] != 1)
+                base = replace(base, ut_raise(base, powers[i]));
+            result = replace(result, ut_multiply(result, base));
+            ut_free(base);
+        }
+        translation->result = result;
+        return result != nullptr ? UT_SUCCESS : UT_VISIT_ERROR;
+    }
+
+    static ut_status translateGalilean(const ut_unit *unit, double scale, const ut_unit *underlyingUnit,
+                                       double origin, void *arg)
+    {
+        Q_UNUSED(unit);
+        Translation *translation = static_cast<Translation *>(arg);
+        if (ut_accept_visitor(underlyingUnit, &translateVisitor, arg) != UT_SUCCESS)
+            return UT_VISIT_ERROR;
+        ut_unit *result = translation->result;
+        result = replace(result, ut_scale(scale, result));
+        if (result != nullptr)
+            result = replace(result, ut_offset(result, origin));
+        translation->result = result;
+        return result != nullptr ? UT_SUCCESS : UT_VISIT_ERROR;
+    }
+
+    static ut_status translateTimestamp(const ut_unit *unit, const ut_unit *timeUnit,
+                                        double origin, void *arg)
+    {
+        Q_UNUSED(unit);
+        Translation *translation = static_cast<Translation *>(arg);
+        if (ut_accept_visitor(timeUnit, &translateVisitor, arg) != UT_SUCCESS)
+            return UT_VISIT_ERROR;
+        translation->result = replace(translation->result,
+                                      ut_offset_by_time(translation->result, origin));
+        return translation->result != nullptr ? UT_SUCCESS : UT_VISIT_ERROR;
+    }
+
+    static ut_status translateLogarithmic(const ut_unit *unit, double base,
+                                          const ut_unit *reference, void *arg)
+    {
+        Q_UNUSED(unit);
+        Translation *translation = static_cast<Translation *>(arg);
+        if (ut_accept_visitor(reference, &translateVisitor, arg) != UT_SUCCESS)
+            return UT_VISIT_ERROR;
+        translation->result = replace(translation->result, ut_log(base, translation->result));
+        return translation->result != nullptr ? UT_SUCCESS : UT_VISIT_ERROR;
+    }
+
+    static ut_visitor keyVisitor;
+    static ut_visitor translateVisitor;
+};
+
+ut_visitor UdUnitTranslatorVisitor::keyVisitor = {
+    &UdUnitTranslatorVisitor::keyBasic,
+    &UdUnitTranslatorVisitor::keyProduct,
+    &UdUnitTranslatorVisitor::keyGalilean,
+    &UdUnitTranslatorVisitor::keyTimestamp,
+    &UdUnitTranslatorVisitor::keyLogarithmic
+};
+
+ut_visitor UdUnitTranslatorVisitor::translateVisitor = {
+    &UdUnitTranslatorVisitor::translateBasic,
+    &UdUnitTranslatorVisitor::translateProduct,
+    &UdUnitTranslatorVisitor::translateGalilean,
+    &UdUnitTranslatorVisitor::translateTimestamp,
+    &UdUnitTranslatorVisitor::translateLogarithmic
+};
+
+/*!
+ * Constructs a translator of units from the \a source unit-system to the
+ * \a target unit-system.
+ */
+UdUnitTranslator::UdUnitTranslator(const UdUnitSystem *source, const UdUnitSystem *target):
+    m_source(source), m_target(target),
+    m_sourceSystem(source != nullptr ? source->m_system : nullptr),
+    m_targetSystem(target != nullptr ? target->m_system : nullptr)
+{
+
+}
+
+/*!
+ * Destroys the translator and its cache.
+ */
+UdUnitTranslator::~UdUnitTranslator()
+{
+
+}
+
+/*!
+ * Returns true if both unit-systems are valid, false otherwise.
+ */
+bool UdUnitTranslator::isValid() const
+{
+    return m_sourceSystem != nullptr && m_targetSystem != nullptr;
+}
+
+/*!
+ * Returns the unit-system units are translated from.
+ */
+const UdUnitSystem *UdUnitTranslator::sourceSystem() const
+{
+    return m_source;
+}
+
+/*!
+ * Returns the unit-system units are translated to.
+ */
+const UdUnitSystem *UdUnitTranslator::targetSystem() const
+{
+    return m_target;
+}
+
+/*!
+ * Returns the unit of the target unit-system equivalent to \a unit, a unit
+ * of the source unit-system. A unit of the target unit-system is returned as
+ * is.
+ *
+ * An invalid unit is returned if \a unit is invalid or belongs to another
+ * unit-system (UdError::BadArgumentError), or if one of its base units has no
+ * equivalent in the target unit-system (UdError::UnknownIdentifierError).
+ */
+UdUnit UdUnitTranslator::translate(const UdUnit &unit) const
+{
+    if (!isValid() || !unit.isValid())
+        return UdUnit(nullptr, UT_BAD_ARG);
+    const ut_system *system = ut_get_system(unit.m_unit);
+    if (system == m_targetSystem)
+        return unit;
+    if (system != m_sourceSystem)
+        return UdUnit(nullptr, UT_BAD_ARG);
+
+    QByteArray key;
+    key.reserve(64);
+    if (ut_accept_visitor(unit.m_unit, &UdUnitTranslatorVisitor::keyVisitor, &key) != UT_SUCCESS)
+        return UdUnit(nullptr, UT_UNKNOWN);
+    const QHash<QByteArray, UdUnit>::const_iterator cached = m_cache.constFind(key);
+    if (cached != m_cache.constEnd()) {
+        QUD_INSTRUMENT_COUNT(CacheHits, 1);
+        return cached.value();
+    }
+    QUD_INSTRUMENT_COUNT(CacheMisses, 1);
+
+    ut_set_status(UT_SUCCESS);
+    UdUnitTranslatorVisitor::Translation translation = { this, nullptr };
+    if (ut_accept_visitor(unit.m_unit, &UdUnitTranslatorVisitor::translateVisitor,
+                          &translation) != UT_SUCCESS) {
+        ut_free(translation.result);
+        const ut_status status = ut_get_status();
+        return UdUnit(nullptr, status != UT_SUCCESS && status != UT_VISIT_ERROR ? status : UT_UNKNOWN);
+    }
+    const UdUnit result(translation.result, UT_SUCCESS);
+    m_cache.insert(key, result);
+    return result;
+}
+
+/*!
+ * Returns a converter from \a from, a unit of the source unit-system, to
+ * \a to, a unit of the target unit-system. The fromUnit() of the converter is
+ * the translation of \a from.
+ * \sa translate()
+ */
+UdUnitConverter UdUnitTranslator::converter(const UdUnit &from, const UdUnit &to) const
+{
+    return UdUnitConverter(translate(from), to);
+}
+
+/*!
+ * Returns the number of translations held in the cache.
+ */
+int UdUnitTranslator::cacheSize() const
+{
+    return m_cache.size();
+}
+
+/*!
+ * Removes all the translations from the cache.
+ */
+void UdUnitTranslator::clearCache()
+{
+    m_cache.clear();
+}
+
+/*!
+ * \internal
+ * Returns the unit of the target unit-system having the same symbol, or name
+ * if it has no symbol, as the basic \a unit, or nullptr if there's none.
+ */
+ut_unit *UdUnitTranslator::translateBasic(const ut_unit *unit) const
+{
+    ut_unit *result = nullptr;
+    const char *symbol = ut_get_symbol(unit, UT_UTF8);
+    if (symbol != nullptr)
+        result = ut_get_unit_by_symbol(m_targetSystem, symbol);
+    if (result == nullptr) {
+        const char *name = ut_get_name(unit, UT_UTF8);
+        if (name != nullptr)
+            result = ut_get_unit_by_name(m_targetSystem, name);
+    }
+    if (result == nullptr)
+        ut_set_status(UT_UNKNOWN);
+    return result;
+}
@@ -0,0 +1,41 @@
+#ifndef QUDUNITTRANSLATOR_H
+#define QUDUNITTRANSLATOR_H
+
+#include "qudunit_global.h"
+#include "qudunit.h"
+
+#include <QByteArray>
+#include <QHash>
+
+class QUDUNITSHARED_EXPORT UdUnitTranslator
+{
+public:
+    UdUnitTranslator(const UdUnitSystem *source, const UdUnitSystem *target);
+    ~UdUnitTranslator();
+
+    bool isValid() const;
+    const UdUnitSystem *sourceSystem() const;
+    const UdUnitSystem *targetSystem() const;
+
+    UdUnit translate(const UdUnit &unit) const;
+    UdUnitConverter converter(const UdUnit &from, const UdUnit &to) const;
+
+    int cacheSize() const;
+    void clearCache();
+
+private:
+    Q_DISABLE_COPY(UdUnitTranslator)
+
+    friend struct UdUnitTranslatorVisitor;
+
+    ut_unit *translateBasic(const ut_unit *unit) const;
+
+    const UdUnitSystem *m_source;
+    const UdUnitSystem *m_target;
+    const ut_system *m_sourceSystem;
+    ut_system *m_targetSystem;
+    // Translated units, keyed on the structure of the source units
+    mutable QHash<QByteArray, UdUnit> m_cache;
+};
+
+#endif // QUDUNITTRANSLATOR_H
@@ -5,6 +5,7 @@
 #-------------------------------------------------
 
 QT       -= gui
+QT       += concurrent
 CONFIG +=  c++11
 TARGET = qudunit
 TEMPLATE = lib
@@ -13,10 +14,24 @@ LIBS += -ludunits2
 
 DEFINES += QUDUNIT_LIBRARY
 
-SOURCES += qudunit.cpp
+# Build with "qmake CONFIG+=qudunit_instrumentation" to enable UdInstrumentation
+qudunit_instrumentation: DEFINES += QUDUNIT_INSTRUMENTATION
 
-HEADERS += qudunit.h\
-        qudunit_global.h
+# Build with "qmake CONFIG+=qudunit_builtin_table" to compile the default unit
+# database into the library, see UdUnitTable::builtin(). Its source is
+# generated in the build directory by tools/udgentable, which is built first.
+qudunit_builtin_table {
+    DEFINES += QUDUNIT_BUILTIN_TABLE
+    UDGENTABLE = $$OUT_PWD/../tools/udgentable/udgentable
+    builtin_table.target = qudunittable_builtin.cpp
+    builtin_table.commands = $$UDGENTABLE $$OUT_PWD/qudunittable_builtin.cpp
+    builtin_table.depends = $$UDGENTABLE
+    QMAKE_EXTRA_TARGETS += builtin_table
+    GENERATED_SOURCES += qudunittable_builtin.cpp
+    QMAKE_CLEAN += qudunittable_builtin.cpp
+}
+
+include(qudunit.pri)
 
 unix {
     target.path = /usr/lib
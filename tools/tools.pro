@@ -0,0 +1,29 @@
+#-------------------------------------------------
+#
+# Command line conversion tool
+#
+#-------------------------------------------------
+
+QT       -= gui
+
+TARGET = udconvert
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+
+SOURCES += \
+    udconvert.cpp
+
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../src/release/ -lqudunit
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../src/debug/ -lqudunit
+else:unix: LIBS += -L$$OUT_PWD/../src/ -lqudunit -ludunits2
+
+INCLUDEPATH += $$PWD/../src
+DEPENDPATH += $$PWD/../src
+
+unix {
+    target.path = /usr/bin
+    INSTALLS += target
+}
@@ -0,0 +1,111 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QTextStream>
+
+#include "qudunit.h"
+#include "qudunitfileconverter.h"
+
+#include <cstdio>
+
+static bool parseSampleType(const QString &text, UdUnitFileConverter::SampleType *type)
+{
+    if (text == QLatin1String("f32") || text == QLatin1String("float32"))
+        *type = UdUnitFileConverter::Float32;
+    else if (text == QLatin1String("f64") || text == QLatin1String("float64"))
+        *type = UdUnitFileConverter::Float64;
+    else
+        return false;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("udconvert");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Converts raw little-endian floating point arrays between units.");
+    parser.addHelpOption();
+    QCommandLineOption inputTypeOption(QStringList() << "i" << "input-type",
+                                       "Input sample type: f32 or f64 (default).", "type", "f64");
+    QCommandLineOption outputTypeOption(QStringList() << "o" << "output-type",
+                                        "Output sample type: f32 or f64 (default: input type).", "type");
+    QCommandLineOption inPlaceOption(QStringList() << "p" << "in-place",
+                                     "Convert the input file in place.");
+    QCommandLineOption chunkOption(QStringList() << "c" << "chunk-size",
+                                   "Number of samples per parallel task.", "samples");
+    QCommandLineOption databaseOption(QStringList() << "d" << "database",
+                                      "Path to the XML unit database.", "path");
+    QCommandLineOption quietOption(QStringList() << "q" << "quiet",
+                                   "Don't report throughput.");
+    parser.addOption(inputTypeOption);
+    parser.addOption(outputTypeOption);
+    parser.addOption(inPlaceOption);
+    parser.addOption(chunkOption);
+    parser.addOption(databaseOption);
+    parser.addOption(quietOption);
+    parser.addPositionalArgument("from", "Unit of the input samples, eg. K.");
+    parser.addPositionalArgument("to", "Unit of the output samples, eg. degC.");
+    parser.addPositionalArgument("input", "Input file.");
+    parser.addPositionalArgument("output", "Output file, unless converting in place.", "[output]");
+    parser.process(app);
+
+    QTextStream err(stderr);
+    const QStringList arguments = parser.positionalArguments();
+    const bool inPlace = parser.isSet(inPlaceOption);
+    if (arguments.size() != (inPlace ? 3 : 4))
+        parser.showHelp(1);
+
+    UdUnitFileConverter::SampleType inputType;
+    UdUnitFileConverter::SampleType outputType;
+    if (!parseSampleType(parser.value(inputTypeOption), &inputType)) {
+        err << "Invalid input type: " << parser.value(inputTypeOption) << '\n';
+        return 1;
+    }
+    outputType = inputType;
+    if (parser.isSet(outputTypeOption) && !parseSampleType(parser.value(outputTypeOption), &outputType)) {
+        err << "Invalid output type: " << parser.value(outputTypeOption) << '\n';
+        return 1;
+    }
+
+    ut_set_error_message_handler(ut_ignore);
+    QScopedPointer<UdUnitSystem> system(UdUnitSystem::loadDatabase(parser.value(databaseOption)));
+    if (!system->isValid()) {
+        err << "Cannot load unit database\n";
+        return 1;
+    }
+    const UdUnit from = system->unitFromString(arguments.at(0));
+    const UdUnit to = system->unitFromString(arguments.at(1));
+    if (!from.isValid() || !to.isValid()) {
+        err << "Invalid unit: " << (from.isValid() ? arguments.at(1) : arguments.at(0)) << '\n';
+        return 1;
+    }
+    UdUnitConverter unitConverter(from, to);
+    if (!unitConverter.isValid()) {
+        err << "Cannot convert from " << arguments.at(0) << " to " << arguments.at(1) << '\n';
+        return 1;
+    }
+
+    UdUnitFileConverter converter(unitConverter);
+    converter.setInputType(inputType);
+    converter.setOutputType(outputType);
+    if (parser.isSet(chunkOption))
+        converter.setChunkSize(parser.value(chunkOption).toLongLong());
+    const bool result = inPlace ? converter.convertInPlace(arguments.at(2))
+                                : converter.convert(arguments.at(2), arguments.at(3));
+    if (!result) {
+        err << converter.errorString() << '\n';
+        return 1;
+    }
+
+    if (!parser.isSet(quietOption)) {
+        QTextStream out(stdout);
+        out << "Converted " << converter.sampleCount() << " samples ("
+            << converter.byteCount() / (1024.0 * 1024.0) << " MiB read and written) in "
+            << converter.elapsed() / 1e6 << " ms: "
+            << converter.throughput() / (1024.0 * 1024.0) << " MiB/s\n";
+    }
+    return 0;
+}
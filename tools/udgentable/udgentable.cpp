@@ -0,0 +1,80 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+#include "qudunittable.h"
+
+#include <cstdio>
+
+// Writes the image of \a table as the C++ definition of the builtin table,
+// see UdUnitTable::builtin(). The image is 8 bytes aligned so that it can be
+// used in place.
+static QByteArray toSource(const UdUnitTable &table, const QString &database)
+{
+    const QByteArray image = table.image();
+    QByteArray source;
+    source += "// Generated by udgentable from ";
+    source += database.isEmpty() ? QByteArray("the default unit database") : database.toUtf8();
+    source += ", do not edit.\n\n";
+    source += "#include <QtGlobal>\n\n";
+    source += "alignas(8) extern const unsigned char qudBuiltinUnitTable[] = {";
+    for (int i = 0; i < image.size(); ++i) {
+        source += (i % 16 == 0) ? "\n    " : " ";
+        source += "0x";
+        source += QByteArray::number(uchar(image.at(i)), 16).rightJustified(2, '0');
+        source += ',';
+    }
+    source += "\n};\n\n";
+    source += "extern const qint64 qudBuiltinUnitTableSize = ";
+    source += QByteArray::number(image.size());
+    source += ";\n";
+    return source;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("udgentable");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Generates the precompiled table of a unit database.");
+    parser.addHelpOption();
+    QCommandLineOption databaseOption(QStringList() << "d" << "database",
+                                      "Path to the XML unit database (default: udunits2 default).",
+                                      "path");
+    QCommandLineOption binaryOption(QStringList() << "b" << "binary",
+                                    "Write the raw table image instead of C++ source.");
+    parser.addOption(databaseOption);
+    parser.addOption(binaryOption);
+    parser.addPositionalArgument("output", "Output file.");
+    parser.process(app);
+
+    QTextStream err(stderr);
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.size() != 1)
+        parser.showHelp(1);
+
+    const QString database = parser.value(databaseOption);
+    const UdUnitTable table = UdUnitTable::fromDatabase(database);
+    if (!table.isValid()) {
+        err << "Cannot build unit table: " << table.error().message() << '\n';
+        return 1;
+    }
+
+    QFile output(arguments.at(0));
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        err << "Cannot open " << output.fileName() << '\n';
+        return 1;
+    }
+    const QByteArray data = parser.isSet(binaryOption) ? table.image() : toSource(table, database);
+    if (output.write(data) != data.size()) {
+        err << "Cannot write " << output.fileName() << '\n';
+        return 1;
+    }
+    err << table.unitCount() << " units, " << table.nameCount() << " names, "
+        << table.symbolCount() << " symbols, " << table.prefixCount() << " prefixes, "
+        << table.size() << " bytes\n";
+    return 0;
+}
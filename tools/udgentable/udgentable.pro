@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# Unit table generator, see UdUnitTable
+#
+#-------------------------------------------------
+
+QT       -= gui
+QT       += concurrent
+
+TARGET = udgentable
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+# The library sources are compiled in, so that the table can be generated
+# before the library is built with it
+DEFINES += QUDUNIT_LIBRARY
+include(../../src/qudunit.pri)
+
+SOURCES += \
+    udgentable.cpp
+
+LIBS += -ludunits2